@@ -0,0 +1,245 @@
+#ifndef AUTO_EXPOSURE_H
+#define AUTO_EXPOSURE_H
+
+#include <glad/glad.h>
+
+#include <glm/glm.hpp>
+
+#include <learnopengl/render_graph.h>
+#include <learnopengl/shader.h>
+
+#include <algorithm>
+#include <cmath>
+#include <string>
+#include <vector>
+using namespace std;
+
+// the scene's log luminance is reduced to AUTO_EXPOSURE_SIZE x AUTO_EXPOSURE_SIZE texels for the readback,
+// a power of two
+const unsigned int AUTO_EXPOSURE_SIZE = 64;
+// readbacks in flight, a frame's luminance arrives one or two frames later
+const unsigned int AUTO_EXPOSURE_READBACKS = 3;
+
+struct AutoExposureSettings {
+    bool enabled = true;
+    // stops added to the metered exposure (Q/E), the whole exposure when metering is off
+    float compensation = 0.0f;
+    // share of the darkest and brightest texels left out of the average, so the night sky and the lights
+    // themselves don't pull the exposure
+    float lowPercentile = 0.1f;
+    float highPercentile = 0.95f;
+    // how fast the exposure follows, in 1/s: a brighter scene is adapted to faster than a darker one
+    float speedBrighter = 3.0f;
+    float speedDarker = 1.0f;
+    float minExposure = 0.05f;
+    float maxExposure = 20.0f;
+};
+
+// Meters the HDR scene like a camera: graph passes render the log2 luminance of the scene into a power of two
+// texture fine enough to take in every scene texel, halve it by 2x2 averages down to AUTO_EXPOSURE_SIZE and copy
+// that into a pixel pack buffer, fenced. Averaging everything keeps small lights from flickering the exposure
+// the way point samples would. Update maps the buffers whose fences have signaled,
+// never waiting for the GPU, averages the texels between the percentiles and eases the exposure towards
+// key / average, with the key depending on the average (Krawczyk et al. 2005) so a night stays dark.
+class AutoExposure
+{
+public:
+    AutoExposure() : luminanceShader("resources/shaders/fullscreen.vs", "resources/shaders/luminance.fs"),
+                     downsampleShader("resources/shaders/fullscreen.vs", "resources/shaders/luminance_downsample.fs")
+    {
+        glGenVertexArrays(1, &vao);
+        luminanceShader.use();
+        luminanceShader.setInt("scene", 0);
+        downsampleShader.use();
+        downsampleShader.setInt("source", 0);
+        for (Slot &slot : slots)
+        {
+            glGenBuffers(1, &slot.buffer);
+            glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.buffer);
+            glBufferData(GL_PIXEL_PACK_BUFFER, AUTO_EXPOSURE_SIZE * AUTO_EXPOSURE_SIZE * sizeof(float), nullptr, GL_STREAM_READ);
+        }
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    }
+
+    AutoExposure(const AutoExposure &) = delete;
+    AutoExposure &operator=(const AutoExposure &) = delete;
+
+    ~AutoExposure()
+    {
+        Release();
+    }
+
+    // adds the passes metering scene. they have no consumer in the graph, the readback is their side effect.
+    void AddPasses(RenderGraph &graph, RenderResource scene)
+    {
+        // still in flight: this frame isn't metered rather than waiting for an older one
+        if (slots[next].fence)
+            return;
+
+        // each texel of the first level covers at most 4x4 scene texels, all of which its four bilinear taps take in
+        unsigned int size = AUTO_EXPOSURE_SIZE;
+        while (size * 4 < std::max(graph.Width(scene), graph.Height(scene)))
+            size *= 2;
+        RenderTextureDesc desc;
+        desc.format = GL_R32F;
+        desc.width = desc.height = size;
+        desc.dynamicResolution = false;
+        RenderResource level = graph.CreateTexture("luminance " + std::to_string(size), desc);
+        RenderPassBuilder luminance = graph.AddPass("Luminance", [this, scene, size](RenderGraph &g) {
+            luminanceShader.use();
+            glm::vec4 region = g.Region(scene);
+            luminanceShader.setVec4("sceneRegion", region);
+            luminanceShader.setVec2("footprint", glm::vec2(region.x, region.y) / (float) size);
+            draw(g.Texture(scene));
+            if (size == AUTO_EXPOSURE_SIZE)
+                readBack();
+        });
+        luminance.Read(scene).Write(level);
+        if (size == AUTO_EXPOSURE_SIZE)
+            luminance.SideEffect();
+
+        // a bilinear tap at the centre of a texel of the half size target is the average of its 2x2 source texels
+        while (size > AUTO_EXPOSURE_SIZE)
+        {
+            size /= 2;
+            desc.width = desc.height = size;
+            RenderResource source = level;
+            level = graph.CreateTexture("luminance " + std::to_string(size), desc);
+            RenderPassBuilder down = graph.AddPass("Luminance down " + std::to_string(size), [this, source, size](RenderGraph &g) {
+                downsampleShader.use();
+                draw(g.Texture(source));
+                if (size == AUTO_EXPOSURE_SIZE)
+                    readBack();
+            });
+            down.Read(source).Write(level);
+            if (size == AUTO_EXPOSURE_SIZE)
+                down.SideEffect();
+        }
+    }
+
+    // takes in the readbacks that are done and moves the exposure deltaTime seconds towards their target
+    void Update(float deltaTime, const AutoExposureSettings &settings)
+    {
+        // oldest first, the newest finished one wins
+        for (unsigned int i = 0; i < AUTO_EXPOSURE_READBACKS; i++)
+        {
+            Slot &slot = slots[(next + i) % AUTO_EXPOSURE_READBACKS];
+            if (!slot.fence)
+                continue;
+            GLenum status = glClientWaitSync(slot.fence, 0, 0);
+            if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED)
+                break;
+            glDeleteSync(slot.fence);
+            slot.fence = 0;
+            meter(slot, settings);
+        }
+
+        float compensation = std::pow(2.0f, settings.compensation);
+        if (!settings.enabled || averageLuminance <= 0.0f)
+        {
+            exposure = compensation;
+            return;
+        }
+        float key = 1.03f - 2.0f / (2.0f + std::log10(averageLuminance + 1.0f));
+        float target = glm::clamp(key / averageLuminance * compensation, settings.minExposure, settings.maxExposure);
+        // in stops, so going up and down a stop take the same time
+        float speed = target < exposure ? settings.speedBrighter : settings.speedDarker;
+        float stops = std::log2(target / exposure);
+        exposure *= std::pow(2.0f, stops * (1.0f - std::exp(-deltaTime * speed)));
+    }
+
+    float Exposure() const
+    {
+        return exposure;
+    }
+
+    // metered luminance of the scene, 0 until the first readback arrives
+    float AverageLuminance() const
+    {
+        return averageLuminance;
+    }
+
+    // deletes the buffers and fences, has to happen while the context is still alive
+    void Release()
+    {
+        for (Slot &slot : slots)
+        {
+            if (slot.fence)
+                glDeleteSync(slot.fence);
+            if (slot.buffer)
+                glDeleteBuffers(1, &slot.buffer);
+            slot = Slot();
+        }
+        if (vao)
+            glDeleteVertexArrays(1, &vao);
+        vao = 0;
+    }
+
+private:
+    struct Slot {
+        GLuint buffer = 0;
+        GLsync fence = 0;
+    };
+
+    Shader luminanceShader;
+    Shader downsampleShader;
+    // no attributes, fullscreen.vs makes the triangle from gl_VertexID
+    unsigned int vao = 0;
+    Slot slots[AUTO_EXPOSURE_READBACKS];
+    unsigned int next = 0;
+    vector<float> texels;
+    float averageLuminance = 0.0f;
+    float exposure = 1.0f;
+
+    void draw(unsigned int source)
+    {
+        GLboolean depthTest = glIsEnabled(GL_DEPTH_TEST);
+        glDisable(GL_DEPTH_TEST);
+        glActiveTexture(GL_TEXTURE0);
+        glBindTexture(GL_TEXTURE_2D, source);
+        glBindVertexArray(vao);
+        glDrawArrays(GL_TRIANGLES, 0, 3);
+        glBindVertexArray(0);
+        if (depthTest)
+            glEnable(GL_DEPTH_TEST);
+    }
+
+    // copies the bound AUTO_EXPOSURE_SIZE target into the next buffer, the GL returns before the copy is done
+    void readBack()
+    {
+        Slot &slot = slots[next];
+        next = (next + 1) % AUTO_EXPOSURE_READBACKS;
+        glReadBuffer(GL_COLOR_ATTACHMENT0);
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.buffer);
+        glReadPixels(0, 0, AUTO_EXPOSURE_SIZE, AUTO_EXPOSURE_SIZE, GL_RED, GL_FLOAT, (void *) 0);
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+        slot.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    }
+
+    // average of the log luminances between the percentiles
+    void meter(const Slot &slot, const AutoExposureSettings &settings)
+    {
+        const size_t count = AUTO_EXPOSURE_SIZE * AUTO_EXPOSURE_SIZE;
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.buffer);
+        const float *mapped = static_cast<const float *>(glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, count * sizeof(float), GL_MAP_READ_BIT));
+        if (mapped)
+        {
+            texels.assign(mapped, mapped + count);
+            glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+        }
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+        if (!mapped)
+            return;
+
+        size_t low = (size_t) (glm::clamp(settings.lowPercentile, 0.0f, 1.0f) * (count - 1));
+        size_t high = std::max((size_t) (glm::clamp(settings.highPercentile, 0.0f, 1.0f) * (count - 1)), low);
+        std::nth_element(texels.begin(), texels.begin() + low, texels.end());
+        std::nth_element(texels.begin() + low, texels.begin() + high, texels.end());
+        double sum = 0.0;
+        for (size_t i = low; i <= high; i++)
+            sum += texels[i];
+        averageLuminance = std::exp2((float) (sum / (high - low + 1)));
+    }
+};
+
+#endif
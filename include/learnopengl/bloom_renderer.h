@@ -0,0 +1,147 @@
+#ifndef BLOOM_RENDERER_H
+#define BLOOM_RENDERER_H
+
+#include <glad/glad.h>
+
+#include <glm/glm.hpp>
+
+#include <learnopengl/render_graph.h>
+#include <learnopengl/shader.h>
+
+#include <algorithm>
+#include <string>
+#include <vector>
+using namespace std;
+
+const unsigned int BLOOM_MAX_LEVELS = 8;
+
+struct BloomSettings {
+    // halvings of the chain, the glow gets twice as wide with every level
+    int levels = 6;
+    // texels the upsampling tent reaches
+    float radius = 1.0f;
+    // luminance where the bright pass starts keeping light, and the width of the soft transition below it
+    float threshold = 1.0f;
+    float knee = 0.5f;
+    // scale of the glow added onto the scene
+    float intensity = 0.2f;
+};
+
+// Bloom over a chain of progressively halved targets: the HDR scene is downsampled level by level with a
+// 13 tap filter, the first (half resolution) level also being the bright pass, then every level is upsampled
+// with a 3x3 tent and added onto the level above it. The first level ends up holding the glow of all levels,
+// each level widening it by a factor of two. Every step is a pass of the render graph and the levels are
+// transient textures of the graph, so when nothing reads the result no bloom pass runs.
+class BloomRenderer
+{
+public:
+    BloomRenderer()
+        : downsampleShader("resources/shaders/fullscreen.vs", "resources/shaders/bloom_downsample.fs"),
+          upsampleShader("resources/shaders/fullscreen.vs", "resources/shaders/bloom_upsample.fs")
+    {
+        glGenVertexArrays(1, &vao);
+        downsampleShader.use();
+        downsampleShader.setInt("source", 0);
+        upsampleShader.use();
+        upsampleShader.setInt("source", 0);
+    }
+
+    BloomRenderer(const BloomRenderer &) = delete;
+    BloomRenderer &operator=(const BloomRenderer &) = delete;
+
+    ~BloomRenderer()
+    {
+        Release();
+    }
+
+    // adds the passes blooming the light of scene over the threshold, returns the texture with the glow (half
+    // the frame size). levels stop before getting smaller than 2x2. with a render scale below 1 every level
+    // only covers the rendered part of the scene.
+    RenderResource AddPasses(RenderGraph &graph, RenderResource scene, const BloomSettings &settings)
+    {
+        unsigned int maxLevels = (unsigned int) std::max(1, std::min(settings.levels, (int) BLOOM_MAX_LEVELS));
+        unsigned int width = graph.Width(scene), height = graph.Height(scene);
+        vector<RenderResource> chain;
+        RenderTextureDesc desc;
+        // no alpha and half the bytes of RGBA16F, plenty for a blur
+        desc.format = GL_R11F_G11F_B10F;
+        desc.scale = 1.0f;
+        while (chain.empty() || (chain.size() < maxLevels && width / 2 >= 2 && height / 2 >= 2))
+        {
+            width /= 2;
+            height /= 2;
+            desc.scale *= 0.5f;
+            chain.push_back(graph.CreateTexture("bloom " + std::to_string(chain.size()), desc));
+        }
+
+        // down: scene -> level 0 -> level 1 ...
+        float knee = std::max(settings.knee, 1e-4f);
+        glm::vec4 thresholdCurve(settings.threshold, settings.threshold - knee, 2.0f * knee, 0.25f / knee);
+        for (size_t level = 0; level < chain.size(); level++)
+        {
+            RenderResource source = level == 0 ? scene : chain[level - 1];
+            graph.AddPass("Bloom down " + std::to_string(level), [this, source, level, thresholdCurve](RenderGraph &g) {
+                downsampleShader.use();
+                downsampleShader.setVec2("sourceTexelSize", glm::vec2(1.0f / g.Width(source), 1.0f / g.Height(source)));
+                downsampleShader.setVec4("sourceRegion", g.Region(source));
+                // the first level averages in luminance weighted groups, so single bright pixels don't flicker,
+                // and keeps only what is over the threshold
+                downsampleShader.setBool("prefilter", level == 0);
+                downsampleShader.setVec4("thresholdCurve", thresholdCurve);
+                draw(g.Texture(source), false);
+            }).Read(source).Write(chain[level]);
+        }
+
+        // up: each level blurred onto the one above, added to what the downsampling left there
+        float radius = settings.radius;
+        for (size_t level = chain.size() - 1; level > 0; level--)
+        {
+            RenderResource source = chain[level];
+            graph.AddPass("Bloom up " + std::to_string(level), [this, source, radius](RenderGraph &g) {
+                upsampleShader.use();
+                upsampleShader.setFloat("radius", radius);
+                upsampleShader.setVec2("sourceTexelSize", glm::vec2(1.0f / g.Width(source), 1.0f / g.Height(source)));
+                upsampleShader.setVec4("sourceRegion", g.Region(source));
+                draw(g.Texture(source), true);
+            }).Read(source).Write(chain[level - 1]);
+        }
+        return chain[0];
+    }
+
+    // deletes the VAO, has to happen while the context is still alive
+    void Release()
+    {
+        if (vao)
+            glDeleteVertexArrays(1, &vao);
+        vao = 0;
+    }
+
+private:
+    Shader downsampleShader;
+    Shader upsampleShader;
+    // no attributes, fullscreen.vs makes the triangle from gl_VertexID
+    unsigned int vao = 0;
+
+    // fullscreen triangle sampling source into the bound target, added onto it when additive
+    void draw(unsigned int source, bool additive)
+    {
+        GLboolean depthTest = glIsEnabled(GL_DEPTH_TEST);
+        glDisable(GL_DEPTH_TEST);
+        if (additive)
+        {
+            glEnable(GL_BLEND);
+            glBlendFunc(GL_ONE, GL_ONE);
+        }
+        glActiveTexture(GL_TEXTURE0);
+        glBindTexture(GL_TEXTURE_2D, source);
+        glBindVertexArray(vao);
+        glDrawArrays(GL_TRIANGLES, 0, 3);
+        glBindVertexArray(0);
+        if (additive)
+            glDisable(GL_BLEND);
+        if (depthTest)
+            glEnable(GL_DEPTH_TEST);
+    }
+};
+
+#endif
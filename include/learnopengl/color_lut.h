@@ -0,0 +1,179 @@
+#ifndef COLOR_LUT_H
+#define COLOR_LUT_H
+
+#include <glad/glad.h>
+
+#include <glm/glm.hpp>
+
+#include <learnopengl/thread_pool.h>
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+using namespace std;
+
+// entries per axis of the lookup table
+const unsigned int COLOR_LUT_SIZE = 32;
+// exposed colors are looked up by log2(x + COLOR_LUT_EPSILON), which is 0 for black, up to COLOR_LUT_MAX.
+// the small epsilon keeps the entries near black close enough for the steep start of the display gamma, the
+// tone curve is within 0.0004 of white past COLOR_LUT_MAX
+const float COLOR_LUT_EPSILON = 1.0f / 16384.0f;
+const float COLOR_LUT_MAX = 8.0f;
+
+// everything between the exposed HDR color and the display: tone curve, grading and display gamma.
+// the defaults give the plain 1 - exp(-x) curve with gamma 2.2.
+struct ColorGradingSettings {
+    // white balance, -1 (blue) .. 1 (orange), and green (-1) .. magenta (1)
+    float temperature = 0.0f;
+    float tint = 0.0f;
+    // around middle grey, and around the luminance of the color
+    float contrast = 1.0f;
+    float saturation = 1.0f;
+    // shadows, midtones and highlights per channel
+    glm::vec3 lift = glm::vec3(0.0f);
+    glm::vec3 gamma = glm::vec3(1.0f);
+    glm::vec3 gain = glm::vec3(1.0f);
+    float displayGamma = 2.2f;
+
+    bool operator==(const ColorGradingSettings &other) const
+    {
+        return temperature == other.temperature && tint == other.tint && contrast == other.contrast &&
+               saturation == other.saturation && lift == other.lift && gamma == other.gamma && gain == other.gain &&
+               displayGamma == other.displayGamma;
+    }
+
+    bool operator!=(const ColorGradingSettings &other) const
+    {
+        return !(*this == other);
+    }
+};
+
+// The color pipeline baked into a COLOR_LUT_SIZE^3 RGBA16F 3D texture, so the composite does one lookup per
+// pixel whatever the grading. The table is indexed by the shaper log2(x + COLOR_LUT_EPSILON) of the exposed color
+// rather than the color itself, HDR colors span far more than a linear 0..1 table could resolve. Baking splits
+// the blue slices over the pool, never waiting behind loads queued on it, and only happens when the settings
+// changed.
+class ColorLut
+{
+public:
+    ColorLut()
+    {
+        glGenTextures(1, &texture);
+        glBindTexture(GL_TEXTURE_3D, texture);
+        glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+        glBindTexture(GL_TEXTURE_3D, 0);
+    }
+
+    ColorLut(const ColorLut &) = delete;
+    ColorLut &operator=(const ColorLut &) = delete;
+
+    ~ColorLut()
+    {
+        Release();
+    }
+
+    // bakes and uploads the table if the settings differ from the last bake, returns whether it did
+    bool Update(const ColorGradingSettings &settings, ThreadPool &pool)
+    {
+        if (baked && settings == bakedSettings)
+            return false;
+        bakedSettings = settings;
+        baked = true;
+        table.resize(COLOR_LUT_SIZE * COLOR_LUT_SIZE * COLOR_LUT_SIZE * 4);
+
+        pool.ParallelFor(COLOR_LUT_SIZE, [this](unsigned int first, unsigned int last) { bakeSlices(first, last); });
+
+        glBindTexture(GL_TEXTURE_3D, texture);
+        glTexImage3D(GL_TEXTURE_3D, 0, GL_RGBA16F, COLOR_LUT_SIZE, COLOR_LUT_SIZE, COLOR_LUT_SIZE, 0, GL_RGBA, GL_FLOAT, table.data());
+        glBindTexture(GL_TEXTURE_3D, 0);
+        return true;
+    }
+
+    unsigned int Texture() const
+    {
+        return texture;
+    }
+
+    // epsilon, scale and bias of the shaper: coordinate = log2(x + epsilon) * scale + bias, 0 for black
+    static glm::vec3 ShaperParameters()
+    {
+        float scale = 1.0f / (std::log2(COLOR_LUT_MAX + COLOR_LUT_EPSILON) - std::log2(COLOR_LUT_EPSILON));
+        return glm::vec3(COLOR_LUT_EPSILON, scale, -std::log2(COLOR_LUT_EPSILON) * scale);
+    }
+
+    // the whole pipeline for one exposed color, what an entry of the table holds
+    static glm::vec3 Grade(glm::vec3 color, const ColorGradingSettings &settings)
+    {
+        // tone curve
+        color = glm::vec3(1.0f) - glm::vec3(std::exp(-color.x), std::exp(-color.y), std::exp(-color.z));
+
+        // white balance as a gain per channel
+        color = color * glm::vec3(1.0f + 0.2f * settings.temperature + 0.1f * settings.tint,
+                                   1.0f - 0.2f * settings.tint,
+                                   1.0f - 0.2f * settings.temperature + 0.1f * settings.tint);
+
+        const glm::vec3 lumaWeights(0.2126f, 0.7152f, 0.0722f);
+        float luma = glm::dot(color, lumaWeights);
+        color = glm::vec3(luma) + (color - glm::vec3(luma)) * settings.saturation;
+
+        // contrast in log space around middle grey
+        const float middleGrey = 0.18f;
+        for (int c = 0; c < 3; c++)
+        {
+            float value = std::max(color[c], 0.0f);
+            color[c] = value > 0.0f ? middleGrey * std::pow(value / middleGrey, settings.contrast) : 0.0f;
+        }
+
+        // lift / gamma / gain, then the display encoding
+        for (int c = 0; c < 3; c++)
+        {
+            float value = color[c] * settings.gain[c] + settings.lift[c] * (1.0f - color[c]);
+            value = std::pow(glm::clamp(value, 0.0f, 1.0f), 1.0f / std::max(settings.gamma[c], 0.01f));
+            color[c] = std::pow(value, 1.0f / settings.displayGamma);
+        }
+        return color;
+    }
+
+    // deletes the texture, has to happen while the context is still alive
+    void Release()
+    {
+        if (texture)
+            glDeleteTextures(1, &texture);
+        texture = 0;
+    }
+
+private:
+    unsigned int texture = 0;
+    vector<float> table;
+    ColorGradingSettings bakedSettings;
+    bool baked = false;
+
+    // inverse of the shaper, the exposed color an entry stands for
+    static float entryValue(unsigned int index)
+    {
+        glm::vec3 shaper = ShaperParameters();
+        float coordinate = (float) index / (COLOR_LUT_SIZE - 1);
+        return std::exp2((coordinate - shaper.z) / shaper.y) - shaper.x;
+    }
+
+    void bakeSlices(unsigned int first, unsigned int last)
+    {
+        for (unsigned int b = first; b < last; b++)
+            for (unsigned int g = 0; g < COLOR_LUT_SIZE; g++)
+                for (unsigned int r = 0; r < COLOR_LUT_SIZE; r++)
+                {
+                    glm::vec3 color = Grade(glm::vec3(entryValue(r), entryValue(g), entryValue(b)), bakedSettings);
+                    float *entry = &table[((b * COLOR_LUT_SIZE + g) * COLOR_LUT_SIZE + r) * 4];
+                    entry[0] = color.x;
+                    entry[1] = color.y;
+                    entry[2] = color.z;
+                    entry[3] = 1.0f;
+                }
+    }
+};
+
+#endif
@@ -0,0 +1,123 @@
+#ifndef DYNAMIC_RESOLUTION_H
+#define DYNAMIC_RESOLUTION_H
+
+#include <glad/glad.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+using namespace std;
+
+// frames the GPU may be behind before a timer is read, reading a newer one would wait for the GPU
+const unsigned int DYNAMIC_RESOLUTION_QUERIES = 4;
+
+// Picks the render scale from the GPU time of the frame: BeginFrame and EndFrame wrap what the scale applies to
+// in a GL_TIME_ELAPSED query, results are read a few frames later, when they're available, without waiting.
+// The cost of a frame is taken to grow with the pixel count, the square of the scale, so the scale that would
+// hit the target is the current one times sqrt(target / time). It is approached gradually, faster down than up,
+// and left alone while the time is close to the target.
+class DynamicResolution
+{
+public:
+    // GPU time the frame should take in milliseconds, and the range of the scale
+    float TargetMs = 16.0f;
+    float MinScale = 0.5f;
+    float MaxScale = 1.0f;
+    bool Enabled = true;
+
+    DynamicResolution()
+    {
+        glGenQueries(DYNAMIC_RESOLUTION_QUERIES, queries);
+    }
+
+    DynamicResolution(const DynamicResolution &) = delete;
+    DynamicResolution &operator=(const DynamicResolution &) = delete;
+
+    ~DynamicResolution()
+    {
+        Release();
+    }
+
+    void BeginFrame()
+    {
+        // the GPU hasn't finished the frame that used this query yet, this frame goes unmeasured
+        timing = !pending[current];
+        if (timing)
+            glBeginQuery(GL_TIME_ELAPSED, queries[current]);
+    }
+
+    void EndFrame()
+    {
+        if (timing)
+        {
+            glEndQuery(GL_TIME_ELAPSED);
+            pending[current] = true;
+            current = (current + 1) % DYNAMIC_RESOLUTION_QUERIES;
+        }
+        readResults();
+    }
+
+    // share of the width and height to render
+    float Scale() const
+    {
+        return Enabled ? scale : MaxScale;
+    }
+
+    // smoothed GPU time of the measured frames, in milliseconds
+    float GpuMs() const
+    {
+        return gpuMs;
+    }
+
+    // deletes the queries, has to happen while the context is still alive
+    void Release()
+    {
+        if (queries[0])
+            glDeleteQueries(DYNAMIC_RESOLUTION_QUERIES, queries);
+        std::fill(queries, queries + DYNAMIC_RESOLUTION_QUERIES, 0u);
+    }
+
+private:
+    unsigned int queries[DYNAMIC_RESOLUTION_QUERIES] = {};
+    bool pending[DYNAMIC_RESOLUTION_QUERIES] = {};
+    unsigned int current = 0;
+    bool timing = false;
+    float scale = 1.0f;
+    float gpuMs = 0.0f;
+
+    // oldest first, stops at the first one the GPU hasn't finished
+    void readResults()
+    {
+        for (unsigned int i = 0; i < DYNAMIC_RESOLUTION_QUERIES; i++)
+        {
+            unsigned int query = (current + i) % DYNAMIC_RESOLUTION_QUERIES;
+            if (!pending[query])
+                continue;
+            GLint available = 0;
+            glGetQueryObjectiv(queries[query], GL_QUERY_RESULT_AVAILABLE, &available);
+            if (!available)
+                break;
+            GLuint64 nanoseconds = 0;
+            glGetQueryObjectui64v(queries[query], GL_QUERY_RESULT, &nanoseconds);
+            pending[query] = false;
+            update(nanoseconds / 1e6f);
+        }
+    }
+
+    void update(float ms)
+    {
+        gpuMs = gpuMs > 0.0f ? gpuMs + (ms - gpuMs) * 0.1f : ms;
+        if (!Enabled)
+            return;
+        float ratio = TargetMs / std::max(gpuMs, 0.01f);
+        // within 5% of the target: stay, so the scale doesn't wander around it
+        if (ratio > 0.95f && ratio < 1.05f)
+            return;
+        float wanted = scale * std::sqrt(ratio);
+        // over budget it drops quickly, under budget it creeps back up
+        float step = std::min(std::max(wanted - scale, -0.05f), 0.01f);
+        scale = std::min(std::max(scale + step, MinScale), MaxScale);
+    }
+};
+
+#endif
@@ -0,0 +1,64 @@
+#ifndef FRUSTUM_H
+#define FRUSTUM_H
+
+#include <glm/glm.hpp>
+
+// the six planes of a view frustum, normals pointing inwards, normalized so plane . (p, 1) is the signed distance
+struct Frustum {
+    enum Frustum_Plane { PLANE_LEFT, PLANE_RIGHT, PLANE_BOTTOM, PLANE_TOP, PLANE_NEAR, PLANE_FAR };
+    glm::vec4 planes[6];
+
+    // extracts the planes from a projection * view matrix (Gribb & Hartmann), a world space frustum for it
+    static Frustum FromMatrix(const glm::mat4 &viewProjection)
+    {
+        // glm matrices are column major, m[c][r]
+        glm::vec4 rows[4];
+        for (int r = 0; r < 4; r++)
+            rows[r] = glm::vec4(viewProjection[0][r], viewProjection[1][r], viewProjection[2][r], viewProjection[3][r]);
+
+        Frustum frustum;
+        frustum.planes[PLANE_LEFT]   = rows[3] + rows[0];
+        frustum.planes[PLANE_RIGHT]  = rows[3] - rows[0];
+        frustum.planes[PLANE_BOTTOM] = rows[3] + rows[1];
+        frustum.planes[PLANE_TOP]    = rows[3] - rows[1];
+        frustum.planes[PLANE_NEAR]   = rows[3] + rows[2];
+        frustum.planes[PLANE_FAR]    = rows[3] - rows[2];
+        for (glm::vec4 &plane : frustum.planes)
+            plane /= glm::length(glm::vec3(plane));
+        return frustum;
+    }
+
+    // a frustum everything is inside of
+    static Frustum Everything()
+    {
+        Frustum frustum;
+        for (glm::vec4 &plane : frustum.planes)
+            plane = glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
+        return frustum;
+    }
+
+    bool IntersectsSphere(const glm::vec3 &center, float radius) const
+    {
+        for (const glm::vec4 &plane : planes)
+        {
+            if (glm::dot(glm::vec3(plane), center) + plane.w < -radius)
+                return false;
+        }
+        return true;
+    }
+
+    // conservative: boxes near the frustum corners can pass without being visible
+    bool IntersectsBox(const glm::vec3 &low, const glm::vec3 &high) const
+    {
+        for (const glm::vec4 &plane : planes)
+        {
+            // the corner furthest along the plane normal
+            glm::vec3 corner(plane.x >= 0.0f ? high.x : low.x, plane.y >= 0.0f ? high.y : low.y, plane.z >= 0.0f ? high.z : low.z);
+            if (glm::dot(glm::vec3(plane), corner) + plane.w < 0.0f)
+                return false;
+        }
+        return true;
+    }
+};
+
+#endif
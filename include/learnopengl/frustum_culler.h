@@ -0,0 +1,152 @@
+#ifndef FRUSTUM_CULLER_H
+#define FRUSTUM_CULLER_H
+
+#include <glm/glm.hpp>
+
+#include <learnopengl/frustum.h>
+
+#include <cmath>
+#include <vector>
+using namespace std;
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#include <xmmintrin.h>
+#define FRUSTUM_CULLER_SSE
+#endif
+
+// Tests batches of world space bounding boxes against a frustum, four boxes per SSE instruction
+// (one box at a time where SSE isn't available). Boxes are queued with Add, Cull writes the indices
+// of the visible ones. The visible/culled counters add up over all Cull calls until ResetStats.
+// A frame queues the boxes of all its models before a single Cull, so the batches stay full.
+class FrustumCuller
+{
+public:
+    void SetFrustum(const Frustum &newFrustum)
+    {
+        frustum = newFrustum;
+    }
+
+    const Frustum &GetFrustum() const
+    {
+        return frustum;
+    }
+
+    // forgets the queued boxes
+    void Clear()
+    {
+        centerX.clear();
+        centerY.clear();
+        centerZ.clear();
+        extentX.clear();
+        extentY.clear();
+        extentZ.clear();
+    }
+
+    // number of queued boxes, the index the next Add returns
+    unsigned int Count() const
+    {
+        return (unsigned int) centerX.size();
+    }
+
+    // queues a model space box, transformed by matrix, returns its index
+    unsigned int Add(const glm::vec3 &low, const glm::vec3 &high, const glm::mat4 &matrix)
+    {
+        // the world box around the transformed box: the center is transformed, the extent is projected
+        // onto the world axes through the absolute values of the rotation and scale part (Arvo)
+        glm::vec3 center = glm::vec3(matrix * glm::vec4((low + high) * 0.5f, 1.0f));
+        glm::vec3 extent = (high - low) * 0.5f;
+        glm::vec3 worldExtent(0.0f);
+        for (int axis = 0; axis < 3; axis++)
+        {
+            for (int column = 0; column < 3; column++)
+                worldExtent[axis] += fabs(matrix[column][axis]) * extent[column];
+        }
+
+        centerX.push_back(center.x);
+        centerY.push_back(center.y);
+        centerZ.push_back(center.z);
+        extentX.push_back(worldExtent.x);
+        extentY.push_back(worldExtent.y);
+        extentZ.push_back(worldExtent.z);
+        return (unsigned int) centerX.size() - 1;
+    }
+
+    // fills visible with the indices of the queued boxes intersecting the frustum, in the order they were added
+    void Cull(vector<unsigned int> &visible)
+    {
+        visible.clear();
+        size_t count = centerX.size();
+#ifdef FRUSTUM_CULLER_SSE
+        // the last batch reads past the boxes, pad the arrays to whole batches
+        size_t padded = (count + 3) & ~(size_t) 3;
+        for (vector<float> *values : {&centerX, &centerY, &centerZ, &extentX, &extentY, &extentZ})
+            values->resize(padded, 0.0f);
+
+        for (size_t i = 0; i < count; i += 4)
+        {
+            __m128 x = _mm_loadu_ps(&centerX[i]), y = _mm_loadu_ps(&centerY[i]), z = _mm_loadu_ps(&centerZ[i]);
+            __m128 ex = _mm_loadu_ps(&extentX[i]), ey = _mm_loadu_ps(&extentY[i]), ez = _mm_loadu_ps(&extentZ[i]);
+            __m128 inside = _mm_cmpeq_ps(x, x);
+            for (const glm::vec4 &plane : frustum.planes)
+            {
+                // signed distance of the center against how far the box reaches towards the plane
+                __m128 distance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(x, _mm_set1_ps(plane.x)), _mm_mul_ps(y, _mm_set1_ps(plane.y))),
+                                             _mm_add_ps(_mm_mul_ps(z, _mm_set1_ps(plane.z)), _mm_set1_ps(plane.w)));
+                __m128 reach = _mm_add_ps(_mm_add_ps(_mm_mul_ps(ex, _mm_set1_ps(fabs(plane.x))), _mm_mul_ps(ey, _mm_set1_ps(fabs(plane.y)))),
+                                          _mm_mul_ps(ez, _mm_set1_ps(fabs(plane.z))));
+                inside = _mm_and_ps(inside, _mm_cmpge_ps(_mm_add_ps(distance, reach), _mm_setzero_ps()));
+            }
+            int mask = _mm_movemask_ps(inside);
+            for (size_t lane = 0; lane < 4 && i + lane < count; lane++)
+            {
+                if (mask & (1 << lane))
+                    visible.push_back((unsigned int) (i + lane));
+            }
+        }
+
+        for (vector<float> *values : {&centerX, &centerY, &centerZ, &extentX, &extentY, &extentZ})
+            values->resize(count);
+#else
+        for (size_t i = 0; i < count; i++)
+        {
+            bool inside = true;
+            for (const glm::vec4 &plane : frustum.planes)
+            {
+                float distance = plane.x * centerX[i] + plane.y * centerY[i] + plane.z * centerZ[i] + plane.w;
+                float reach = fabs(plane.x) * extentX[i] + fabs(plane.y) * extentY[i] + fabs(plane.z) * extentZ[i];
+                inside = inside && distance + reach >= 0.0f;
+            }
+            if (inside)
+                visible.push_back((unsigned int) i);
+        }
+#endif
+        visibleCount += (unsigned int) visible.size();
+        culledCount += (unsigned int) (count - visible.size());
+    }
+
+    // counters since the last ResetStats, usually one frame
+    unsigned int Visible() const
+    {
+        return visibleCount;
+    }
+
+    unsigned int Culled() const
+    {
+        return culledCount;
+    }
+
+    void ResetStats()
+    {
+        visibleCount = culledCount = 0;
+    }
+
+private:
+    Frustum frustum = Frustum::Everything();
+    // structure of arrays, so four boxes load into one register per component
+    vector<float> centerX, centerY, centerZ;
+    vector<float> extentX, extentY, extentZ;
+    unsigned int visibleCount = 0;
+    unsigned int culledCount = 0;
+};
+
+#endif
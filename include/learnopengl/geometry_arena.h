@@ -0,0 +1,460 @@
+#ifndef GEOMETRY_ARENA_H
+#define GEOMETRY_ARENA_H
+
+#include <glad/glad.h>
+
+#include <learnopengl/vertex_format.h>
+
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <map>
+#include <vector>
+using namespace std;
+
+// starting size of an arena's buffers, they double whenever they run full
+const size_t GEOMETRY_ARENA_INITIAL_VERTICES = 64 * 1024;
+const size_t GEOMETRY_ARENA_INITIAL_INDEX_BYTES = 256 * 1024;
+// index ranges are aligned for 32 bit indices, so 16 and 32 bit meshes can share the buffer
+const size_t GEOMETRY_ARENA_INDEX_ALIGNMENT = 4;
+
+// first fit allocator over a linear range, free ranges are kept sorted and coalesced
+class RangeAllocator
+{
+public:
+    static const size_t INVALID = ~(size_t) 0;
+
+    explicit RangeAllocator(size_t capacity = 0)
+    {
+        Reset(0, capacity);
+    }
+
+    // returns the offset of the allocated range, INVALID if no free range is large enough
+    size_t Allocate(size_t size, size_t alignment = 1)
+    {
+        for (map<size_t, size_t>::iterator range = free.begin(); range != free.end(); ++range)
+        {
+            size_t offset = (range->first + alignment - 1) / alignment * alignment;
+            size_t padding = offset - range->first;
+            if (range->second < padding + size)
+                continue;
+
+            size_t start = range->first, length = range->second;
+            free.erase(range);
+            if (padding > 0)
+                free[start] = padding;
+            if (length > padding + size)
+                free[offset + size] = length - padding - size;
+            freeSize -= size;
+            return offset;
+        }
+        return INVALID;
+    }
+
+    void Free(size_t offset, size_t size)
+    {
+        if (size == 0)
+            return;
+        freeSize += size;
+        map<size_t, size_t>::iterator range = free.emplace(offset, size).first;
+        // merge with the following and then the preceding range
+        map<size_t, size_t>::iterator next = std::next(range);
+        if (next != free.end() && range->first + range->second == next->first)
+        {
+            range->second += next->second;
+            free.erase(next);
+        }
+        if (range != free.begin())
+        {
+            map<size_t, size_t>::iterator previous = std::prev(range);
+            if (previous->first + previous->second == range->first)
+            {
+                previous->second += range->second;
+                free.erase(range);
+            }
+        }
+    }
+
+    // makes the space between the old and the new capacity available
+    void Grow(size_t newCapacity)
+    {
+        size_t oldCapacity = capacity;
+        capacity = newCapacity;
+        Free(oldCapacity, newCapacity - oldCapacity);
+    }
+
+    // everything below used is taken, the rest is free
+    void Reset(size_t used, size_t newCapacity)
+    {
+        free.clear();
+        capacity = newCapacity;
+        freeSize = 0;
+        Free(used, newCapacity - used);
+    }
+
+    size_t Capacity() const
+    {
+        return capacity;
+    }
+
+    size_t FreeSize() const
+    {
+        return freeSize;
+    }
+
+    size_t FreeRanges() const
+    {
+        return free.size();
+    }
+
+private:
+    map<size_t, size_t> free; // offset -> size
+    size_t capacity = 0;
+    size_t freeSize = 0;
+};
+
+// One vertex buffer, index buffer and VAO shared by all meshes of a vertex format.
+// The positions are also kept in a second, tightly packed vertex buffer with its own VAO (PositionVAO) for passes
+// that only need depth; both VAOs use the same index buffer, so base vertices and index offsets are the same.
+// Meshes get a handle to their allocation instead of offsets, so the arena can move the data around
+// (when it grows or defragments) and meshes still find it. A mesh is drawn with glDrawElementsBaseVertex
+// at its BaseVertex and IndexOffset while the arena's VAO is bound.
+// Allocations are made on the thread owning the GL context; freeing doesn't touch the GL, so it's fine after
+// the context is gone.
+class GeometryArena
+{
+public:
+    static const unsigned int INVALID_HANDLE = ~0u;
+
+    static GeometryArena &ForFormat(Vertex_Format format)
+    {
+        static GeometryArena full(VERTEX_FULL), packed(VERTEX_PACKED), packedTangent(VERTEX_PACKED_QTANGENT);
+        if (format == VERTEX_PACKED)
+            return packed;
+        else if (format == VERTEX_PACKED_QTANGENT)
+            return packedTangent;
+        return full;
+    }
+
+    static GLsizei Stride(Vertex_Format format)
+    {
+        if (format == VERTEX_PACKED)
+            return sizeof(PackedVertex);
+        else if (format == VERTEX_PACKED_QTANGENT)
+            return sizeof(PackedTangentVertex);
+        return sizeof(Vertex);
+    }
+
+    // size of a vertex in the position stream: the position member every format starts with
+    static GLsizei PositionStride(Vertex_Format format)
+    {
+        if (format == VERTEX_FULL)
+            return sizeof(glm::vec3);
+        return sizeof(PackedVertex::Position);
+    }
+
+    // copies the vertices (already in the arena's format) and indices into the arena, returns the allocation handle
+    unsigned int Allocate(const void *vertexData, size_t vertexCount, const void *indexData, size_t indexBytes)
+    {
+        if (!vao)
+            create();
+
+        size_t firstVertex = reserve(vertexSpace, vertexCount, 1);
+        size_t indexOffset = reserve(indexSpace, indexBytes, GEOMETRY_ARENA_INDEX_ALIGNMENT);
+
+        vector<unsigned char> positions(vertexCount * positionStride);
+        const unsigned char *vertexBytes = static_cast<const unsigned char *>(vertexData);
+        for (size_t i = 0; i < vertexCount; i++)
+            memcpy(&positions[i * positionStride], vertexBytes + i * stride, positionStride);
+
+        glBindBuffer(GL_COPY_WRITE_BUFFER, vbo);
+        glBufferSubData(GL_COPY_WRITE_BUFFER, firstVertex * stride, vertexCount * stride, vertexData);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, positionVbo);
+        glBufferSubData(GL_COPY_WRITE_BUFFER, firstVertex * positionStride, vertexCount * positionStride, positions.data());
+        glBindBuffer(GL_COPY_WRITE_BUFFER, ibo);
+        glBufferSubData(GL_COPY_WRITE_BUFFER, indexOffset, indexBytes, indexData);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+        unsigned int handle;
+        if (!freeHandles.empty())
+        {
+            handle = freeHandles.back();
+            freeHandles.pop_back();
+        }
+        else
+        {
+            handle = (unsigned int) allocations.size();
+            allocations.emplace_back();
+        }
+        allocations[handle] = Allocation{firstVertex, vertexCount, indexOffset, indexBytes, true};
+        return handle;
+    }
+
+    void Free(unsigned int handle)
+    {
+        if (handle >= allocations.size() || !allocations[handle].live)
+            return;
+        Allocation &allocation = allocations[handle];
+        vertexSpace.Free(allocation.firstVertex, allocation.vertexCount);
+        indexSpace.Free(allocation.indexOffset, allocation.indexBytes);
+        allocation.live = false;
+        freeHandles.push_back(handle);
+    }
+
+    GLint BaseVertex(unsigned int handle) const
+    {
+        return (GLint) allocations[handle].firstVertex;
+    }
+
+    // byte offset of the allocation's indices, as glDrawElements* expects it
+    const void *IndexOffset(unsigned int handle) const
+    {
+        return (const void *) allocations[handle].indexOffset;
+    }
+
+    unsigned int VAO() const
+    {
+        return vao;
+    }
+
+    // VAO with only the positions (attribute 0) and the same indices
+    unsigned int PositionVAO() const
+    {
+        return positionVao;
+    }
+
+    void Bind() const
+    {
+        glBindVertexArray(vao);
+    }
+
+    // packs all allocations to the front of the buffers, so the free space is one range again
+    void Defragment()
+    {
+        if (!vao)
+            return;
+        compact(vertexSpace);
+        compact(indexSpace);
+    }
+
+    // vertices and index bytes in use, for debugging output
+    size_t UsedVertices() const
+    {
+        return vertexSpace.Capacity() - vertexSpace.FreeSize();
+    }
+
+    size_t UsedIndexBytes() const
+    {
+        return indexSpace.Capacity() - indexSpace.FreeSize();
+    }
+
+private:
+    struct Allocation {
+        size_t firstVertex;
+        size_t vertexCount;
+        size_t indexOffset;
+        size_t indexBytes;
+        bool live;
+    };
+
+    Vertex_Format format;
+    GLsizei stride;
+    GLsizei positionStride;
+    unsigned int vao = 0, vbo = 0, ibo = 0;
+    unsigned int positionVao = 0, positionVbo = 0;
+    RangeAllocator vertexSpace, indexSpace;
+    vector<Allocation> allocations;
+    vector<unsigned int> freeHandles;
+
+    explicit GeometryArena(Vertex_Format format) : format(format), stride(Stride(format)), positionStride(PositionStride(format))
+    {
+    }
+
+    GeometryArena(const GeometryArena &) = delete;
+    GeometryArena &operator=(const GeometryArena &) = delete;
+
+    void create()
+    {
+        glGenVertexArrays(1, &vao);
+        glGenVertexArrays(1, &positionVao);
+        vertexSpace.Reset(0, GEOMETRY_ARENA_INITIAL_VERTICES);
+        indexSpace.Reset(0, GEOMETRY_ARENA_INITIAL_INDEX_BYTES);
+        replaceBuffers(createBuffer(vertexSpace.Capacity() * stride), createBuffer(vertexSpace.Capacity() * positionStride),
+                       createBuffer(indexSpace.Capacity()));
+    }
+
+    static unsigned int createBuffer(size_t size)
+    {
+        unsigned int buffer;
+        glGenBuffers(1, &buffer);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+        glBufferData(GL_COPY_WRITE_BUFFER, size, nullptr, GL_STATIC_DRAW);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+        return buffer;
+    }
+
+    // moves the live allocations of one space to the front of its buffers, in their current order
+    void compact(RangeAllocator &space)
+    {
+        bool vertices = &space == &vertexSpace;
+        size_t alignment = vertices ? 1 : GEOMETRY_ARENA_INDEX_ALIGNMENT;
+
+        vector<Allocation*> live;
+        for (Allocation &allocation : allocations)
+        {
+            if (allocation.live)
+                live.push_back(&allocation);
+        }
+        sort(live.begin(), live.end(), [vertices](const Allocation *a, const Allocation *b) {
+            return vertices ? a->firstVertex < b->firstVertex : a->indexOffset < b->indexOffset;
+        });
+
+        // where every allocation goes, in units of the space
+        vector<size_t> from, to, sizes;
+        size_t end = 0;
+        for (Allocation *allocation : live)
+        {
+            from.push_back(vertices ? allocation->firstVertex : allocation->indexOffset);
+            sizes.push_back(vertices ? allocation->vertexCount : allocation->indexBytes);
+            to.push_back(end);
+            end = (end + sizes.back() + alignment - 1) / alignment * alignment;
+        }
+
+        if (vertices)
+            replaceBuffers(compactBuffer(vbo, stride, space.Capacity(), from, to, sizes),
+                           compactBuffer(positionVbo, positionStride, space.Capacity(), from, to, sizes), ibo);
+        else
+            replaceBuffers(vbo, positionVbo, compactBuffer(ibo, 1, space.Capacity(), from, to, sizes));
+
+        for (size_t i = 0; i < live.size(); i++)
+            (vertices ? live[i]->firstVertex : live[i]->indexOffset) = to[i];
+        space.Reset(end, space.Capacity());
+    }
+
+    // copies the ranges of a buffer to their new offsets in a new buffer, copies within one buffer must not overlap
+    static unsigned int compactBuffer(unsigned int source, size_t unit, size_t capacity, const vector<size_t> &from,
+                                      const vector<size_t> &to, const vector<size_t> &sizes)
+    {
+        unsigned int buffer = createBuffer(capacity * unit);
+        glBindBuffer(GL_COPY_READ_BUFFER, source);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+        for (size_t i = 0; i < from.size(); i++)
+            glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, from[i] * unit, to[i] * unit, sizes[i] * unit);
+        glBindBuffer(GL_COPY_READ_BUFFER, 0);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+        return buffer;
+    }
+
+    // new buffer of newSize bytes starting with the first oldSize bytes of source
+    static unsigned int growBuffer(unsigned int source, size_t oldSize, size_t newSize)
+    {
+        unsigned int buffer = createBuffer(newSize);
+        glBindBuffer(GL_COPY_READ_BUFFER, source);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+        glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, oldSize);
+        glBindBuffer(GL_COPY_READ_BUFFER, 0);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+        return buffer;
+    }
+
+    // finds room for size units, compacting the arena if the free space is only fragmented and growing it if it's too small
+    size_t reserve(RangeAllocator &space, size_t size, size_t alignment)
+    {
+        size_t offset = space.Allocate(size, alignment);
+        if (offset != RangeAllocator::INVALID)
+            return offset;
+
+        if (space.FreeSize() >= size + alignment)
+        {
+            compact(space);
+            offset = space.Allocate(size, alignment);
+            if (offset != RangeAllocator::INVALID)
+                return offset;
+        }
+
+        size_t oldCapacity = space.Capacity();
+        size_t newCapacity = max(oldCapacity * 2, oldCapacity + size + alignment);
+        if (&space == &vertexSpace)
+            replaceBuffers(growBuffer(vbo, oldCapacity * stride, newCapacity * stride),
+                           growBuffer(positionVbo, oldCapacity * positionStride, newCapacity * positionStride), ibo);
+        else
+            replaceBuffers(vbo, positionVbo, growBuffer(ibo, oldCapacity, newCapacity));
+        space.Grow(newCapacity);
+        return space.Allocate(size, alignment);
+    }
+
+    // points the VAOs at new buffers and deletes the ones they replace
+    void replaceBuffers(unsigned int newVbo, unsigned int newPositionVbo, unsigned int newIbo)
+    {
+        glBindVertexArray(vao);
+        glBindBuffer(GL_ARRAY_BUFFER, newVbo);
+        setupAttributes();
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, newIbo);
+
+        glBindVertexArray(positionVao);
+        glBindBuffer(GL_ARRAY_BUFFER, newPositionVbo);
+        glEnableVertexAttribArray(0);
+        if (format == VERTEX_FULL)
+            glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, positionStride, (void*)0);
+        else
+            glVertexAttribPointer(0, 4, GL_UNSIGNED_SHORT, GL_TRUE, positionStride, (void*)0);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, newIbo);
+        glBindVertexArray(0);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+        if (vbo && vbo != newVbo)
+            glDeleteBuffers(1, &vbo);
+        if (positionVbo && positionVbo != newPositionVbo)
+            glDeleteBuffers(1, &positionVbo);
+        if (ibo && ibo != newIbo)
+            glDeleteBuffers(1, &ibo);
+        vbo = newVbo;
+        positionVbo = newPositionVbo;
+        ibo = newIbo;
+    }
+
+    // vertex attribute pointers of the format, for the buffer bound to GL_ARRAY_BUFFER
+    void setupAttributes()
+    {
+        if (format == VERTEX_FULL)
+        {
+            // vertex Positions
+            glEnableVertexAttribArray(0);
+            glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)0);
+            // vertex normals
+            glEnableVertexAttribArray(1);
+            glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Normal));
+            // vertex texture coords
+            glEnableVertexAttribArray(2);
+            glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, TexCoords));
+            // vertex tangent
+            glEnableVertexAttribArray(3);
+            glVertexAttribPointer(3, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Tangent));
+            // vertex bitangent
+            glEnableVertexAttribArray(4);
+            glVertexAttribPointer(4, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Bitangent));
+        }
+        // the packed formats only have the attributes the lighting shader reads: position, normal (or the whole
+        // tangent frame) and texture coords
+        else if (format == VERTEX_PACKED)
+        {
+            glEnableVertexAttribArray(0);
+            glVertexAttribPointer(0, 4, GL_UNSIGNED_SHORT, GL_TRUE, sizeof(PackedVertex), (void*)offsetof(PackedVertex, Position));
+            glEnableVertexAttribArray(1);
+            glVertexAttribPointer(1, 2, GL_SHORT, GL_TRUE, sizeof(PackedVertex), (void*)offsetof(PackedVertex, Normal));
+            glEnableVertexAttribArray(2);
+            glVertexAttribPointer(2, 2, GL_HALF_FLOAT, GL_FALSE, sizeof(PackedVertex), (void*)offsetof(PackedVertex, TexCoords));
+        }
+        else
+        {
+            glEnableVertexAttribArray(0);
+            glVertexAttribPointer(0, 4, GL_UNSIGNED_SHORT, GL_TRUE, sizeof(PackedTangentVertex), (void*)offsetof(PackedTangentVertex, Position));
+            glEnableVertexAttribArray(2);
+            glVertexAttribPointer(2, 2, GL_HALF_FLOAT, GL_FALSE, sizeof(PackedTangentVertex), (void*)offsetof(PackedTangentVertex, TexCoords));
+            glEnableVertexAttribArray(3);
+            glVertexAttribPointer(3, 4, GL_SHORT, GL_TRUE, sizeof(PackedTangentVertex), (void*)offsetof(PackedTangentVertex, TangentFrame));
+        }
+    }
+};
+
+#endif
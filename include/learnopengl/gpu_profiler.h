@@ -0,0 +1,264 @@
+#ifndef GPU_PROFILER_H
+#define GPU_PROFILER_H
+
+#include <glad/glad.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <deque>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+using namespace std;
+
+// frames the GPU may be behind before the timestamps of one are read back
+const unsigned int GPU_PROFILER_FRAMES = 4;
+// measured frames kept for the trace export
+const unsigned int GPU_PROFILER_HISTORY = 120;
+
+// one scope of the last measured frame; scopes are in the order they began, depth 0 is the frame itself
+struct GpuTiming {
+    string name;
+    unsigned int depth = 0;
+    float ms = 0.0f;
+    // smoothed over the frames, what the panel shows
+    float averageMs = 0.0f;
+};
+
+// Times nested scopes of a frame on the GPU. Each BeginScope and EndScope writes a GL_TIMESTAMP query, unlike
+// GL_TIME_ELAPSED they nest and can run inside the frame's elapsed time query of DynamicResolution. A frame's
+// queries are read back GPU_PROFILER_FRAMES - 1 frames later, when they're available, never waiting for the GPU;
+// if they still aren't, the frame that would reuse them goes unmeasured.
+class GpuProfiler
+{
+public:
+    GpuProfiler() = default;
+
+    GpuProfiler(const GpuProfiler &) = delete;
+    GpuProfiler &operator=(const GpuProfiler &) = delete;
+
+    ~GpuProfiler()
+    {
+        Release();
+    }
+
+    // starts a frame and its root scope
+    void BeginFrame(const string &name = "Frame")
+    {
+        Frame &frame = frames[current];
+        recording = !frame.pending;
+        if (!recording)
+            return;
+        frame.scopes.clear();
+        frame.used = 0;
+        open.clear();
+        BeginScope(name);
+    }
+
+    void EndFrame()
+    {
+        if (recording)
+        {
+            while (!open.empty())
+                EndScope();
+            frames[current].pending = true;
+            current = (current + 1) % GPU_PROFILER_FRAMES;
+            recording = false;
+        }
+        readResults();
+    }
+
+    // scopes have to end in the reverse order they began, and within the frame
+    void BeginScope(const string &name)
+    {
+        if (!recording)
+            return;
+        Frame &frame = frames[current];
+        Scope scope;
+        scope.name = name;
+        scope.depth = (unsigned int) open.size();
+        scope.begin = timestamp(frame);
+        open.push_back((unsigned int) frame.scopes.size());
+        frame.scopes.push_back(scope);
+    }
+
+    void EndScope()
+    {
+        if (!recording || open.empty())
+            return;
+        Frame &frame = frames[current];
+        frame.scopes[open.back()].end = timestamp(frame);
+        open.pop_back();
+    }
+
+    // scopes of the newest measured frame
+    const vector<GpuTiming> &Timings() const
+    {
+        return timings;
+    }
+
+    // writes the kept frames in the Chrome trace event format, for chrome://tracing or Perfetto
+    bool WriteChromeTrace(const string &path) const
+    {
+        ofstream file(path);
+        if (!file)
+        {
+            cout << "ERROR::GPU_PROFILER::FAILED_TO_WRITE_TRACE: " << path << endl;
+            return false;
+        }
+        GLuint64 origin = history.empty() ? 0 : history.front().front().begin;
+        file << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+        file << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":1,\"args\":{\"name\":\"GPU\"}}";
+        file << fixed << setprecision(3);
+        for (const vector<TraceEvent> &frame : history)
+            for (const TraceEvent &event : frame)
+            {
+                file << ",\n{\"name\":\"" << escape(event.name) << "\",\"cat\":\"gpu\",\"ph\":\"X\",\"pid\":1,\"tid\":1"
+                     << ",\"ts\":" << (event.begin - origin) / 1000.0 << ",\"dur\":" << (event.end - event.begin) / 1000.0 << "}";
+            }
+        file << "]}\n";
+        return (bool) file;
+    }
+
+    // deletes the queries, has to happen while the context is still alive
+    void Release()
+    {
+        for (Frame &frame : frames)
+        {
+            if (!frame.queries.empty())
+                glDeleteQueries((GLsizei) frame.queries.size(), frame.queries.data());
+            frame = Frame();
+        }
+    }
+
+private:
+    struct Scope {
+        string name;
+        unsigned int depth = 0;
+        // indices of the frame's timestamp queries
+        unsigned int begin = 0, end = 0;
+    };
+
+    struct Frame {
+        // grows to the most timestamps a frame has taken, reused after that
+        vector<GLuint> queries;
+        unsigned int used = 0;
+        vector<Scope> scopes;
+        bool pending = false;
+    };
+
+    // a scope in GPU nanoseconds
+    struct TraceEvent {
+        string name;
+        GLuint64 begin = 0, end = 0;
+    };
+
+    Frame frames[GPU_PROFILER_FRAMES];
+    unsigned int current = 0;
+    bool recording = false;
+    // scopes of the current frame that haven't ended
+    vector<unsigned int> open;
+    vector<GLuint64> results;
+    vector<GpuTiming> timings;
+    unordered_map<string, float> averages;
+    deque<vector<TraceEvent>> history;
+
+    unsigned int timestamp(Frame &frame)
+    {
+        if (frame.used == frame.queries.size())
+        {
+            GLuint query = 0;
+            glGenQueries(1, &query);
+            frame.queries.push_back(query);
+        }
+        glQueryCounter(frame.queries[frame.used], GL_TIMESTAMP);
+        return frame.used++;
+    }
+
+    // oldest first, stops at the first frame the GPU hasn't finished
+    void readResults()
+    {
+        for (unsigned int i = 0; i < GPU_PROFILER_FRAMES; i++)
+        {
+            Frame &frame = frames[(current + i) % GPU_PROFILER_FRAMES];
+            if (!frame.pending)
+                continue;
+            // the last timestamp being there means the ones before it are too
+            GLint available = 0;
+            glGetQueryObjectiv(frame.queries[frame.used - 1], GL_QUERY_RESULT_AVAILABLE, &available);
+            if (!available)
+                break;
+            results.resize(frame.used);
+            for (unsigned int q = 0; q < frame.used; q++)
+                glGetQueryObjectui64v(frame.queries[q], GL_QUERY_RESULT, &results[q]);
+            frame.pending = false;
+            resolve(frame);
+        }
+    }
+
+    void resolve(const Frame &frame)
+    {
+        if (history.size() == GPU_PROFILER_HISTORY)
+            history.pop_front();
+        history.emplace_back();
+        timings.clear();
+        for (const Scope &scope : frame.scopes)
+        {
+            TraceEvent event;
+            event.name = scope.name;
+            event.begin = results[scope.begin];
+            event.end = std::max(results[scope.end], event.begin);
+            history.back().push_back(event);
+
+            GpuTiming timing;
+            timing.name = scope.name;
+            timing.depth = scope.depth;
+            timing.ms = (event.end - event.begin) / 1e6f;
+            // a scope seen for the first time starts from its own time
+            auto average = averages.find(scope.name);
+            if (average == averages.end())
+                average = averages.emplace(scope.name, timing.ms).first;
+            average->second += (timing.ms - average->second) * 0.1f;
+            timing.averageMs = average->second;
+            timings.push_back(timing);
+        }
+    }
+
+    static string escape(const string &text)
+    {
+        string escaped;
+        for (char c : text)
+        {
+            if (c == '"' || c == '\\')
+                escaped += '\\';
+            escaped += c;
+        }
+        return escaped;
+    }
+};
+
+// times the enclosing block as a scope of the profiler
+class GpuProfileScope
+{
+public:
+    GpuProfileScope(GpuProfiler &profiler, const string &name) : profiler(profiler)
+    {
+        profiler.BeginScope(name);
+    }
+
+    GpuProfileScope(const GpuProfileScope &) = delete;
+    GpuProfileScope &operator=(const GpuProfileScope &) = delete;
+
+    ~GpuProfileScope()
+    {
+        profiler.EndScope();
+    }
+
+private:
+    GpuProfiler &profiler;
+};
+
+#endif
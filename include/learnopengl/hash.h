@@ -0,0 +1,53 @@
+#ifndef HASH_H
+#define HASH_H
+
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include <fstream>
+#include <vector>
+
+// 64-bit FNV-1a; used to key on-disk caches by file content.
+const uint64_t FNV_OFFSET_BASIS = 14695981039346656037ULL;
+const uint64_t FNV_PRIME = 1099511628211ULL;
+
+inline uint64_t HashBytes(const void *data, size_t size, uint64_t hash = FNV_OFFSET_BASIS)
+{
+    const unsigned char *bytes = static_cast<const unsigned char *>(data);
+    for (size_t i = 0; i < size; i++)
+    {
+        hash ^= bytes[i];
+        hash *= FNV_PRIME;
+    }
+    return hash;
+}
+
+// same hash of a string, usable at compile time (uniform names are hashed where they're written)
+constexpr uint64_t HashString(const char *text, size_t size, uint64_t hash = FNV_OFFSET_BASIS)
+{
+    for (size_t i = 0; i < size; i++)
+    {
+        hash ^= (unsigned char) text[i];
+        hash *= FNV_PRIME;
+    }
+    return hash;
+}
+
+// hashes the whole content of a file, returns false if it can't be read
+inline bool HashFile(const std::string &path, uint64_t &hash)
+{
+    std::ifstream file(path, std::ios::binary);
+    if (!file)
+        return false;
+
+    hash = FNV_OFFSET_BASIS;
+    std::vector<char> buffer(1 << 16);
+    while (file)
+    {
+        file.read(buffer.data(), buffer.size());
+        hash = HashBytes(buffer.data(), (size_t) file.gcount(), hash);
+    }
+    return true;
+}
+
+#endif
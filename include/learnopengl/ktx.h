@@ -0,0 +1,288 @@
+#ifndef KTX_H
+#define KTX_H
+
+#include <glad/glad.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <string>
+#include <vector>
+using namespace std;
+
+// block compressed formats outside of GL 3.3 core, checked for at runtime
+#ifndef GL_COMPRESSED_RGB_S3TC_DXT1_EXT
+#define GL_COMPRESSED_RGB_S3TC_DXT1_EXT 0x83F0
+#endif
+#ifndef GL_COMPRESSED_RGBA_BPTC_UNORM
+#define GL_COMPRESSED_RGBA_BPTC_UNORM 0x8E8C
+#endif
+
+const unsigned char KTX_IDENTIFIER[12] = {0xAB, 0x4B, 0x54, 0x58, 0x20, 0x31, 0x31, 0xBB, 0x0D, 0x0A, 0x1A, 0x0A};
+const uint32_t KTX_ENDIANNESS = 0x04030201;
+
+// metadata keys written by the texture cooker
+const char KTX_KEY_SOURCE_HASH[] = "rg.sourceHash";
+const char KTX_KEY_SWIZZLE[] = "rg.swizzle";
+
+struct KtxHeader {
+    unsigned char identifier[12];
+    uint32_t endianness;
+    uint32_t glType;
+    uint32_t glTypeSize;
+    uint32_t glFormat;
+    uint32_t glInternalFormat;
+    uint32_t glBaseInternalFormat;
+    uint32_t pixelWidth;
+    uint32_t pixelHeight;
+    uint32_t pixelDepth;
+    uint32_t numberOfArrayElements;
+    uint32_t numberOfFaces;
+    uint32_t numberOfMipmapLevels;
+    uint32_t bytesOfKeyValueData;
+};
+
+// a single face, block compressed 2D texture with its full mip chain (KTX 1.1 container)
+struct KtxFile {
+    GLenum internalFormat = 0;
+    GLenum baseFormat = 0;
+    uint32_t width = 0;
+    uint32_t height = 0;
+    vector<vector<unsigned char>> levels;
+    map<string, string> metadata;
+
+    size_t Size() const
+    {
+        size_t size = 0;
+        for (const vector<unsigned char> &level : levels)
+            size += level.size();
+        return size;
+    }
+};
+
+// cooked files live next to their source image
+inline string CookedTexturePath(const string &sourcePath)
+{
+    return sourcePath + ".ktx";
+}
+
+inline bool WriteKtx(const string &path, const KtxFile &ktx)
+{
+    FILE *file = fopen(path.c_str(), "wb");
+    if (!file)
+        return false;
+
+    vector<unsigned char> keyValues;
+    for (const map<string, string>::value_type &entry : ktx.metadata)
+    {
+        uint32_t size = (uint32_t) (entry.first.size() + 1 + entry.second.size() + 1);
+        const unsigned char *sizeBytes = reinterpret_cast<const unsigned char *>(&size);
+        keyValues.insert(keyValues.end(), sizeBytes, sizeBytes + sizeof(size));
+        keyValues.insert(keyValues.end(), entry.first.begin(), entry.first.end());
+        keyValues.push_back(0);
+        keyValues.insert(keyValues.end(), entry.second.begin(), entry.second.end());
+        keyValues.push_back(0);
+        keyValues.resize((keyValues.size() + 3) & ~(size_t) 3, 0);
+    }
+
+    KtxHeader header;
+    memcpy(header.identifier, KTX_IDENTIFIER, sizeof(KTX_IDENTIFIER));
+    header.endianness = KTX_ENDIANNESS;
+    header.glType = 0;
+    header.glTypeSize = 1;
+    header.glFormat = 0;
+    header.glInternalFormat = ktx.internalFormat;
+    header.glBaseInternalFormat = ktx.baseFormat;
+    header.pixelWidth = ktx.width;
+    header.pixelHeight = ktx.height;
+    header.pixelDepth = 0;
+    header.numberOfArrayElements = 0;
+    header.numberOfFaces = 1;
+    header.numberOfMipmapLevels = (uint32_t) ktx.levels.size();
+    header.bytesOfKeyValueData = (uint32_t) keyValues.size();
+
+    bool ok = fwrite(&header, sizeof(header), 1, file) == 1;
+    if (!keyValues.empty())
+        ok = ok && fwrite(keyValues.data(), keyValues.size(), 1, file) == 1;
+    for (const vector<unsigned char> &level : ktx.levels)
+    {
+        // compressed blocks are 8 or 16 bytes, so levels never need padding
+        uint32_t imageSize = (uint32_t) level.size();
+        ok = ok && fwrite(&imageSize, sizeof(imageSize), 1, file) == 1;
+        ok = ok && fwrite(level.data(), level.size(), 1, file) == 1;
+    }
+    return fclose(file) == 0 && ok;
+}
+
+inline bool ReadKtx(const string &path, KtxFile &ktx)
+{
+    FILE *file = fopen(path.c_str(), "rb");
+    if (!file)
+        return false;
+
+    KtxHeader header;
+    bool ok = fread(&header, sizeof(header), 1, file) == 1
+              && memcmp(header.identifier, KTX_IDENTIFIER, sizeof(KTX_IDENTIFIER)) == 0
+              && header.endianness == KTX_ENDIANNESS
+              && header.glType == 0 && header.numberOfFaces == 1 && header.pixelDepth == 0
+              && header.numberOfMipmapLevels > 0;
+    if (ok)
+    {
+        vector<unsigned char> keyValues(header.bytesOfKeyValueData);
+        ok = keyValues.empty() || fread(keyValues.data(), keyValues.size(), 1, file) == 1;
+        size_t offset = 0;
+        while (ok && offset + sizeof(uint32_t) <= keyValues.size())
+        {
+            uint32_t size;
+            memcpy(&size, &keyValues[offset], sizeof(size));
+            offset += sizeof(size);
+            if (size > keyValues.size() - offset)
+                break;
+            const char *pair = reinterpret_cast<const char *>(&keyValues[offset]);
+            size_t keyLength = strnlen(pair, size);
+            if (keyLength < size)
+                ktx.metadata[string(pair, keyLength)] = string(pair + keyLength + 1, strnlen(pair + keyLength + 1, size - keyLength - 1));
+            offset += (size + 3) & ~(uint32_t) 3;
+        }
+
+        ktx.internalFormat = header.glInternalFormat;
+        ktx.baseFormat = header.glBaseInternalFormat;
+        ktx.width = header.pixelWidth;
+        ktx.height = header.pixelHeight;
+        ktx.levels.resize(header.numberOfMipmapLevels);
+        for (vector<unsigned char> &level : ktx.levels)
+        {
+            uint32_t imageSize;
+            ok = ok && fread(&imageSize, sizeof(imageSize), 1, file) == 1 && imageSize < (1u << 30);
+            if (!ok)
+                break;
+            level.resize(imageSize);
+            ok = fread(level.data(), imageSize, 1, file) == 1;
+        }
+    }
+    fclose(file);
+    return ok;
+}
+
+inline bool HasGLExtension(const char *name)
+{
+    GLint count = 0;
+    glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+    for (GLint i = 0; i < count; i++)
+    {
+        if (strcmp(reinterpret_cast<const char *>(glGetStringi(GL_EXTENSIONS, i)), name) == 0)
+            return true;
+    }
+    return false;
+}
+
+// which of the compressed formats outside of GL 3.3 core the GL can sample
+struct CompressedFormatSupport {
+    bool s3tc = false;
+    bool bptc = false;
+};
+
+// walks the extension list once; the first call has to be on the thread owning the GL context
+inline const CompressedFormatSupport &GetCompressedFormatSupport()
+{
+    static const CompressedFormatSupport support = []() {
+        CompressedFormatSupport formats;
+        GLint major = 0, minor = 0;
+        glGetIntegerv(GL_MAJOR_VERSION, &major);
+        glGetIntegerv(GL_MINOR_VERSION, &minor);
+        formats.s3tc = HasGLExtension("GL_EXT_texture_compression_s3tc");
+        formats.bptc = major > 4 || (major == 4 && minor >= 2) || HasGLExtension("GL_ARB_texture_compression_bptc");
+        return formats;
+    }();
+    return support;
+}
+
+// true if the GL can sample the given compressed format
+inline bool CompressedFormatSupported(GLenum internalFormat)
+{
+    switch (internalFormat)
+    {
+        case GL_COMPRESSED_RED_RGTC1:
+        case GL_COMPRESSED_RG_RGTC2:
+            return true; // core since 3.0
+        case GL_COMPRESSED_RGB_S3TC_DXT1_EXT:
+            return GetCompressedFormatSupport().s3tc;
+        case GL_COMPRESSED_RGBA_BPTC_UNORM:
+            return GetCompressedFormatSupport().bptc;
+    }
+    return false;
+}
+
+// reads the cooked version of an image, if there is one made from the same source content that the GL supports
+inline bool ReadCookedTexture(const string &sourcePath, uint64_t sourceHash, KtxFile &ktx)
+{
+    if (!ReadKtx(CookedTexturePath(sourcePath), ktx))
+        return false;
+    map<string, string>::const_iterator hash = ktx.metadata.find(KTX_KEY_SOURCE_HASH);
+    return hash != ktx.metadata.end()
+           && strtoull(hash->second.c_str(), nullptr, 16) == sourceHash
+           && CompressedFormatSupported(ktx.internalFormat);
+}
+
+// uploads the prebuilt mip chain with glCompressedTexImage2D, no glGenerateMipmap needed.
+// clampTransparent uses GL_CLAMP_TO_EDGE for textures with alpha.
+inline unsigned int CreateCompressedTexture2D(const KtxFile &ktx, bool clampTransparent = false)
+{
+    unsigned int textureID;
+    glGenTextures(1, &textureID);
+    glBindTexture(GL_TEXTURE_2D, textureID);
+
+    for (unsigned int level = 0; level < ktx.levels.size(); level++)
+    {
+        GLsizei width = max(1u, ktx.width >> level);
+        GLsizei height = max(1u, ktx.height >> level);
+        glCompressedTexImage2D(GL_TEXTURE_2D, level, ktx.internalFormat, width, height, 0, (GLsizei) ktx.levels[level].size(), ktx.levels[level].data());
+    }
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, (GLint) ktx.levels.size() - 1);
+
+    // grayscale images cooked to a single channel still read as gray
+    map<string, string>::const_iterator swizzle = ktx.metadata.find(KTX_KEY_SWIZZLE);
+    if (swizzle != ktx.metadata.end() && swizzle->second == "rrr1")
+    {
+        GLint mask[4] = {GL_RED, GL_RED, GL_RED, GL_ONE};
+        glTexParameteriv(GL_TEXTURE_2D, GL_TEXTURE_SWIZZLE_RGBA, mask);
+    }
+
+    GLint wrap = clampTransparent && ktx.baseFormat == GL_RGBA ? GL_CLAMP_TO_EDGE : GL_REPEAT;
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, wrap);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, wrap);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    return textureID;
+}
+
+// cube map from six cooked faces in +X, -X, +Y, -Y, +Z, -Z order, all of the same format and size
+inline unsigned int CreateCompressedCubemap(const vector<KtxFile> &faces)
+{
+    unsigned int textureID;
+    glGenTextures(1, &textureID);
+    glBindTexture(GL_TEXTURE_CUBE_MAP, textureID);
+
+    for (unsigned int i = 0; i < faces.size(); i++)
+    {
+        for (unsigned int level = 0; level < faces[i].levels.size(); level++)
+        {
+            GLsizei width = max(1u, faces[i].width >> level);
+            GLsizei height = max(1u, faces[i].height >> level);
+            glCompressedTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, level, faces[i].internalFormat, width, height, 0,
+                                   (GLsizei) faces[i].levels[level].size(), faces[i].levels[level].data());
+        }
+    }
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAX_LEVEL, faces.empty() ? 0 : (GLint) faces[0].levels.size() - 1);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+    return textureID;
+}
+
+#endif
@@ -0,0 +1,380 @@
+#ifndef LIGHT_CLUSTERS_H
+#define LIGHT_CLUSTERS_H
+
+#include <glad/glad.h>
+
+#include <glm/glm.hpp>
+
+#include <learnopengl/material.h>
+#include <learnopengl/shader.h>
+#include <learnopengl/thread_pool.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+using namespace std;
+
+// froxel grid: screen tiles in x and y, slices growing exponentially with the view depth in z.
+// model_lighting.fs has the same constants.
+const unsigned int CLUSTER_GRID_X = 16;
+const unsigned int CLUSTER_GRID_Y = 9;
+const unsigned int CLUSTER_GRID_Z = 24;
+const unsigned int CLUSTER_COUNT = CLUSTER_GRID_X * CLUSTER_GRID_Y * CLUSTER_GRID_Z;
+// lights past this many in one cluster are dropped from it, bounds the cost of a fragment
+const unsigned int CLUSTER_MAX_LIGHTS = 128;
+// light indices are 16 bit
+const unsigned int CLUSTER_LIGHT_LIMIT = 65535;
+
+// texture units of the cluster buffers, right after the units materials use
+enum Cluster_Texture_Unit {
+    CLUSTER_GRID_UNIT = MATERIAL_TEXTURE_UNIT_COUNT,
+    CLUSTER_INDEX_UNIT,
+    CLUSTER_LIGHT_UNIT
+};
+
+// point or spot light with a finite range, its contribution fades to zero at the range.
+// point lights take every direction: cosInner -1 and cosOuter -2 make the cone factor 1.
+struct ClusteredLight {
+    glm::vec3 position;
+    float range;
+    glm::vec3 color;
+    float cosInner;
+    glm::vec3 direction;
+    float cosOuter;
+};
+
+inline ClusteredLight MakePointLight(const glm::vec3 &position, float range, const glm::vec3 &color)
+{
+    return ClusteredLight{position, range, color, -1.0f, glm::vec3(0.0f, -1.0f, 0.0f), -2.0f};
+}
+
+// angles in radians, from the axis to the edge of the full and the faded cone
+inline ClusteredLight MakeSpotLight(const glm::vec3 &position, const glm::vec3 &direction, float range, const glm::vec3 &color,
+                                    float innerAngle, float outerAngle)
+{
+    return ClusteredLight{position, range, color, cos(innerAngle), glm::normalize(direction), cos(outerAngle)};
+}
+
+// how the last Update binned the lights
+struct LightClusterStats {
+    unsigned int lights = 0;
+    unsigned int indices = 0;
+    unsigned int maxPerCluster = 0;
+    unsigned int occupiedClusters = 0;
+    unsigned int overflows = 0;
+};
+
+// points the cluster samplers of a program at the cluster texture units, the program has to be in use
+inline void SetClusterSamplers(Shader &shader)
+{
+    shader.setInt("clusterGrid", CLUSTER_GRID_UNIT);
+    shader.setInt("clusterLightIndices", CLUSTER_INDEX_UNIT);
+    shader.setInt("clusterLights", CLUSTER_LIGHT_UNIT);
+}
+
+// Clustered forward lighting: every frame the lights are binned on the CPU into the froxels their range
+// touches and three texture buffers go to the GPU:
+//   clusterGrid          RG32UI, per cluster the offset and the count of its lights in clusterLightIndices
+//   clusterLightIndices  R16UI, the light lists of all clusters back to back
+//   clusterLights        RGBA32F, three texels per light: position and range, color and cosInner, direction and cosOuter
+// A fragment finds its cluster from gl_FragCoord and its view depth and only shades the lights listed there.
+class LightClusters
+{
+public:
+    LightClusters()
+    {
+        glGenBuffers(3, buffers);
+        glGenTextures(3, textures);
+        const GLenum formats[3] = {GL_RG32UI, GL_R16UI, GL_RGBA32F};
+        for (int i = 0; i < 3; i++)
+        {
+            glBindBuffer(GL_TEXTURE_BUFFER, buffers[i]);
+            glBufferData(GL_TEXTURE_BUFFER, 16, nullptr, GL_STREAM_DRAW);
+            glBindTexture(GL_TEXTURE_BUFFER, textures[i]);
+            glTexBuffer(GL_TEXTURE_BUFFER, formats[i], buffers[i]);
+        }
+        glBindTexture(GL_TEXTURE_BUFFER, 0);
+        glBindBuffer(GL_TEXTURE_BUFFER, 0);
+    }
+
+    LightClusters(const LightClusters &) = delete;
+    LightClusters &operator=(const LightClusters &) = delete;
+
+    ~LightClusters()
+    {
+        Release();
+    }
+
+    // bins the lights for the camera and uploads the cluster buffers. projection has to be a glm::perspective
+    // with the given near and far planes, the viewport is width x height pixels. the binning is split by depth
+    // slices over the pool, the calling thread runs whatever the workers haven't started.
+    void Update(const vector<ClusteredLight> &lights, const glm::mat4 &view, const glm::mat4 &projection, float zNear, float zFar,
+                unsigned int width, unsigned int height, ThreadPool &pool)
+    {
+        setGrid(projection, zNear, zFar, width, height);
+        prepareLights(lights, view);
+
+        pool.ParallelFor(CLUSTER_GRID_Z, [this](unsigned int first, unsigned int last) { binSlices(first, last); });
+
+        compact();
+        upload(lights);
+    }
+
+    // binds the buffers to their texture units
+    void Bind() const
+    {
+        for (int i = 0; i < 3; i++)
+        {
+            glActiveTexture(GL_TEXTURE0 + CLUSTER_GRID_UNIT + i);
+            glBindTexture(GL_TEXTURE_BUFFER, textures[i]);
+        }
+        glActiveTexture(GL_TEXTURE0);
+    }
+
+    // what FrameUniforms::clusterParameters holds: x * log(depth) + y is the slice, zw the tile size in pixels
+    glm::vec4 ShaderParameters() const
+    {
+        return glm::vec4(sliceScale, sliceBias, tileWidth, tileHeight);
+    }
+
+    const LightClusterStats &Stats() const
+    {
+        return stats;
+    }
+
+    // deletes the buffers and textures, has to happen while the context is still alive
+    void Release()
+    {
+        if (buffers[0])
+        {
+            glDeleteTextures(3, textures);
+            glDeleteBuffers(3, buffers);
+        }
+        buffers[0] = buffers[1] = buffers[2] = 0;
+        textures[0] = textures[1] = textures[2] = 0;
+    }
+
+private:
+    // light in view space with the depth slices its sphere overlaps
+    struct ViewLight {
+        glm::vec3 center;
+        float radius;
+        int firstSlice;
+        int lastSlice;
+    };
+
+    struct Bounds {
+        glm::vec3 low;
+        glm::vec3 high;
+    };
+
+    unsigned int buffers[3] = {0, 0, 0};
+    unsigned int textures[3] = {0, 0, 0};
+
+    // grid the cluster bounds were built for
+    // x and y scale of the projection, the rest of a glm::perspective follows from near and far
+    glm::vec2 gridScale = glm::vec2(0.0f);
+    unsigned int gridWidth = 0, gridHeight = 0;
+    float nearPlane = 0.1f, farPlane = 1000.0f;
+    float sliceScale = 0.0f, sliceBias = 0.0f;
+    float tileWidth = 1.0f, tileHeight = 1.0f;
+    // view space boxes of the clusters and the depths the slices start at (one more for the far end)
+    vector<Bounds> clusterBounds;
+    vector<float> sliceDepths;
+
+    vector<ViewLight> viewLights;
+    // CLUSTER_MAX_LIGHTS slots per cluster, every cluster is written by the job owning its slice only
+    vector<uint16_t> slots;
+    vector<unsigned int> counts;
+    // what goes to the GPU
+    vector<uint32_t> grid;
+    vector<uint16_t> indices;
+    vector<glm::vec4> lightTexels;
+    LightClusterStats stats;
+
+    // index of a cluster, x fastest, like the fragment shader computes it
+    static unsigned int clusterIndex(unsigned int x, unsigned int y, unsigned int z)
+    {
+        return (z * CLUSTER_GRID_Y + y) * CLUSTER_GRID_X + x;
+    }
+
+    // rebuilds the cluster boxes when the projection or the viewport changed
+    void setGrid(const glm::mat4 &projection, float zNear, float zFar, unsigned int width, unsigned int height)
+    {
+        glm::vec2 scale(projection[0][0], projection[1][1]);
+        if (scale == gridScale && width == gridWidth && height == gridHeight && zNear == nearPlane && zFar == farPlane)
+            return;
+        gridScale = scale;
+        gridWidth = width;
+        gridHeight = height;
+        nearPlane = zNear;
+        farPlane = zFar;
+
+        // slice k covers depths near * (far / near)^(k / Z) up to near * (far / near)^((k + 1) / Z)
+        float logRatio = log(zFar / zNear);
+        sliceScale = CLUSTER_GRID_Z / logRatio;
+        sliceBias = -log(zNear) * sliceScale;
+        tileWidth = (float) ((width + CLUSTER_GRID_X - 1) / CLUSTER_GRID_X);
+        tileHeight = (float) ((height + CLUSTER_GRID_Y - 1) / CLUSTER_GRID_Y);
+
+        sliceDepths.resize(CLUSTER_GRID_Z + 1);
+        for (unsigned int z = 0; z <= CLUSTER_GRID_Z; z++)
+            sliceDepths[z] = zNear * pow(zFar / zNear, (float) z / CLUSTER_GRID_Z);
+
+        clusterBounds.resize(CLUSTER_COUNT);
+        for (unsigned int z = 0; z < CLUSTER_GRID_Z; z++)
+            for (unsigned int y = 0; y < CLUSTER_GRID_Y; y++)
+                for (unsigned int x = 0; x < CLUSTER_GRID_X; x++)
+                {
+                    // tile edges in NDC, the last tile may reach past the viewport
+                    float ndc[4] = {tileNdc(x, tileWidth, width), tileNdc(x + 1, tileWidth, width),
+                                    tileNdc(y, tileHeight, height), tileNdc(y + 1, tileHeight, height)};
+                    Bounds &bounds = clusterBounds[clusterIndex(x, y, z)];
+                    bounds.low = glm::vec3(1e30f);
+                    bounds.high = glm::vec3(-1e30f);
+                    for (int corner = 0; corner < 8; corner++)
+                    {
+                        float depth = sliceDepths[z + (corner >> 2)];
+                        glm::vec3 point(ndc[corner & 1] * depth / scale.x, ndc[2 + ((corner >> 1) & 1)] * depth / scale.y, -depth);
+                        bounds.low = glm::min(bounds.low, point);
+                        bounds.high = glm::max(bounds.high, point);
+                    }
+                }
+    }
+
+    static float tileNdc(unsigned int tile, float tileSize, unsigned int size)
+    {
+        return tile * tileSize / size * 2.0f - 1.0f;
+    }
+
+    int slice(float depth) const
+    {
+        return std::max(0, std::min((int) CLUSTER_GRID_Z - 1, (int) floor(log(std::max(depth, nearPlane)) * sliceScale + sliceBias)));
+    }
+
+    // moves the lights to view space and drops the ones entirely outside the depth range
+    void prepareLights(const vector<ClusteredLight> &lights, const glm::mat4 &view)
+    {
+        viewLights.clear();
+        size_t count = std::min(lights.size(), (size_t) CLUSTER_LIGHT_LIMIT);
+        for (size_t i = 0; i < count; i++)
+        {
+            ViewLight light;
+            light.center = glm::vec3(view * glm::vec4(lights[i].position, 1.0f));
+            light.radius = lights[i].range;
+            float depth = -light.center.z;
+            // an empty slice range for lights entirely outside the depth range
+            light.firstSlice = 1;
+            light.lastSlice = 0;
+            if (depth + light.radius >= nearPlane && depth - light.radius <= farPlane)
+            {
+                light.firstSlice = slice(depth - light.radius);
+                light.lastSlice = slice(depth + light.radius);
+            }
+            viewLights.push_back(light);
+        }
+        slots.resize(CLUSTER_COUNT * CLUSTER_MAX_LIGHTS);
+        counts.assign(CLUSTER_COUNT, 0);
+        stats = LightClusterStats();
+        stats.lights = (unsigned int) count;
+    }
+
+    // tile range [first, last] an interval of view space x (or y) covers between two depths
+    static void tileRange(float low, float high, float nearDepth, float farDepth, float scale, unsigned int tiles, float tileSize,
+                          unsigned int size, int &first, int &last)
+    {
+        // x / depth is monotonic in both, so the extremes are at the corners
+        float ndcLow = std::min(low / nearDepth, low / farDepth) * scale;
+        float ndcHigh = std::max(high / nearDepth, high / farDepth) * scale;
+        float pixelsPerNdc = size * 0.5f;
+        first = std::max(0, (int) floor((ndcLow + 1.0f) * pixelsPerNdc / tileSize));
+        last = std::min((int) tiles - 1, (int) floor((ndcHigh + 1.0f) * pixelsPerNdc / tileSize));
+    }
+
+    // adds every light to the clusters of slices [firstSlice, lastSlice) whose box its sphere touches
+    void binSlices(unsigned int firstSlice, unsigned int lastSlice)
+    {
+        for (unsigned int i = 0; i < viewLights.size(); i++)
+        {
+            const ViewLight &light = viewLights[i];
+            int zFirst = std::max(light.firstSlice, (int) firstSlice);
+            int zLast = std::min(light.lastSlice, (int) lastSlice - 1);
+            for (int z = zFirst; z <= zLast; z++)
+            {
+                // part of the sphere's depth range inside the slice
+                float nearDepth = std::max(sliceDepths[z], -light.center.z - light.radius);
+                float farDepth = std::min(sliceDepths[z + 1], -light.center.z + light.radius);
+                int xFirst, xLast, yFirst, yLast;
+                tileRange(light.center.x - light.radius, light.center.x + light.radius, nearDepth, farDepth, gridScale.x,
+                          CLUSTER_GRID_X, tileWidth, gridWidth, xFirst, xLast);
+                tileRange(light.center.y - light.radius, light.center.y + light.radius, nearDepth, farDepth, gridScale.y,
+                          CLUSTER_GRID_Y, tileHeight, gridHeight, yFirst, yLast);
+                for (int y = yFirst; y <= yLast; y++)
+                    for (int x = xFirst; x <= xLast; x++)
+                    {
+                        unsigned int cluster = clusterIndex(x, y, z);
+                        const Bounds &bounds = clusterBounds[cluster];
+                        glm::vec3 closest = glm::clamp(light.center, bounds.low, bounds.high);
+                        glm::vec3 offset = closest - light.center;
+                        if (glm::dot(offset, offset) > light.radius * light.radius)
+                            continue;
+                        unsigned int &count = counts[cluster];
+                        if (count < CLUSTER_MAX_LIGHTS)
+                            slots[cluster * CLUSTER_MAX_LIGHTS + count] = (uint16_t) i;
+                        count++;
+                    }
+            }
+        }
+    }
+
+    // packs the per cluster slots into one list
+    void compact()
+    {
+        grid.resize(CLUSTER_COUNT * 2);
+        indices.clear();
+        for (unsigned int cluster = 0; cluster < CLUSTER_COUNT; cluster++)
+        {
+            unsigned int count = counts[cluster];
+            if (count > CLUSTER_MAX_LIGHTS)
+            {
+                stats.overflows++;
+                count = CLUSTER_MAX_LIGHTS;
+            }
+            if (count)
+                stats.occupiedClusters++;
+            stats.maxPerCluster = std::max(stats.maxPerCluster, counts[cluster]);
+            grid[cluster * 2] = (uint32_t) indices.size();
+            grid[cluster * 2 + 1] = count;
+            const uint16_t *first = &slots[cluster * CLUSTER_MAX_LIGHTS];
+            indices.insert(indices.end(), first, first + count);
+        }
+        stats.indices = (unsigned int) indices.size();
+    }
+
+    // orphans and refills the buffers, so the upload never waits for the previous frame's draws
+    void upload(const vector<ClusteredLight> &lights)
+    {
+        lightTexels.resize(stats.lights * 3);
+        for (unsigned int i = 0; i < stats.lights; i++)
+        {
+            const ClusteredLight &light = lights[i];
+            lightTexels[i * 3] = glm::vec4(light.position, light.range);
+            lightTexels[i * 3 + 1] = glm::vec4(light.color, light.cosInner);
+            lightTexels[i * 3 + 2] = glm::vec4(light.direction, light.cosOuter);
+        }
+        fill(buffers[0], grid.data(), grid.size() * sizeof(uint32_t));
+        fill(buffers[1], indices.data(), indices.size() * sizeof(uint16_t));
+        fill(buffers[2], lightTexels.data(), lightTexels.size() * sizeof(glm::vec4));
+    }
+
+    static void fill(unsigned int buffer, const void *data, size_t size)
+    {
+        glBindBuffer(GL_TEXTURE_BUFFER, buffer);
+        // an empty texture buffer isn't allowed, keep at least one texel
+        glBufferData(GL_TEXTURE_BUFFER, std::max(size, (size_t) 16), size ? data : nullptr, GL_STREAM_DRAW);
+        glBindBuffer(GL_TEXTURE_BUFFER, 0);
+    }
+};
+
+#endif
@@ -0,0 +1,144 @@
+#ifndef MATERIAL_H
+#define MATERIAL_H
+
+#include <glad/glad.h>
+
+#include <learnopengl/hash.h>
+#include <learnopengl/shader.h>
+
+#include <string>
+#include <vector>
+using namespace std;
+
+struct Texture {
+    unsigned int id;
+    string type;
+    string path;
+};
+
+// texture types the lighting shaders know. the sampler <prefix><type><N> always reads texture unit
+// type index * MATERIAL_SLOTS_PER_TYPE + N - 1, so units don't depend on the order a material lists its textures in.
+const char *const MATERIAL_TEXTURE_TYPES[] = {"texture_diffuse", "texture_specular", "texture_normal", "texture_height"};
+const unsigned int MATERIAL_TEXTURE_TYPE_COUNT = 4;
+const unsigned int MATERIAL_SLOTS_PER_TYPE = 3;
+// units 0 .. MATERIAL_TEXTURE_UNIT_COUNT - 1 belong to materials, GL 3.3 only guarantees 16 per shader stage
+const unsigned int MATERIAL_TEXTURE_UNIT_COUNT = MATERIAL_TEXTURE_TYPE_COUNT * MATERIAL_SLOTS_PER_TYPE;
+const float MATERIAL_DEFAULT_SHININESS = 32.0f;
+
+// What a mesh needs bound to be drawn, resolved once at load: texture, unit and sampler name for every
+// texture, plus the material parameters. A sampler always reads the same unit, so the samplers are set when the
+// material first meets a program and Bind only binds the textures and the parameters.
+class Material
+{
+public:
+    explicit Material(const vector<Texture> &textures, const string &samplerPrefix = "") : sources(textures)
+    {
+        SetSamplerPrefix(samplerPrefix);
+    }
+
+    // prefix of the sampler names in the shader, e.g. "material."
+    void SetSamplerPrefix(const string &prefix)
+    {
+        samplerPrefix = prefix;
+        buildBindings();
+    }
+
+    void SetShininess(float value)
+    {
+        shininess = value;
+        updateHash();
+    }
+
+    float Shininess() const
+    {
+        return shininess;
+    }
+
+    // equal for materials that bind the same state, so draws with either can skip binding
+    uint64_t Hash() const
+    {
+        return hash;
+    }
+
+    const vector<Texture> &Textures() const
+    {
+        return sources;
+    }
+
+    // binds the textures to their units and sets the parameters of the program in use
+    void Bind(Shader &shader) const
+    {
+        if (shader.ID != resolvedProgram)
+            resolve(shader);
+        for (const Binding &binding : bindings)
+        {
+            glActiveTexture(GL_TEXTURE0 + binding.unit);
+            glBindTexture(GL_TEXTURE_2D, binding.texture);
+        }
+        glActiveTexture(GL_TEXTURE0);
+        glUniform1f(shininessLocation, shininess);
+    }
+
+private:
+    struct Binding {
+        unsigned int texture;
+        GLint unit;
+        UniformName sampler;
+    };
+
+    vector<Texture> sources;
+    string samplerPrefix;
+    vector<Binding> bindings;
+    float shininess = MATERIAL_DEFAULT_SHININESS;
+    uint64_t hash = FNV_OFFSET_BASIS;
+
+    // program last bound with, its samplers are set and the parameter location is looked up
+    mutable unsigned int resolvedProgram = 0;
+    mutable GLint shininessLocation = -1;
+
+    // numbers the textures of every type from 1 in the order the material lists them, textures of unknown types
+    // or beyond the slots of their type are left out
+    void buildBindings()
+    {
+        bindings.clear();
+        unsigned int counts[MATERIAL_TEXTURE_TYPE_COUNT] = {};
+        for (const Texture &texture : sources)
+        {
+            for (unsigned int type = 0; type < MATERIAL_TEXTURE_TYPE_COUNT; type++)
+            {
+                if (texture.type != MATERIAL_TEXTURE_TYPES[type] || counts[type] == MATERIAL_SLOTS_PER_TYPE)
+                    continue;
+                unsigned int number = ++counts[type];
+                Binding binding{texture.id, (GLint) (type * MATERIAL_SLOTS_PER_TYPE + number - 1),
+                                UniformName(samplerPrefix + texture.type + std::to_string(number))};
+                bindings.push_back(binding);
+                break;
+            }
+        }
+        resolvedProgram = 0;
+        updateHash();
+    }
+
+    void updateHash()
+    {
+        hash = FNV_OFFSET_BASIS;
+        for (const Binding &binding : bindings)
+        {
+            hash = HashBytes(&binding.texture, sizeof(binding.texture), hash);
+            hash = HashBytes(&binding.sampler.hash, sizeof(binding.sampler.hash), hash);
+        }
+        hash = HashBytes(&shininess, sizeof(shininess), hash);
+    }
+
+    // the program has to be in use. other materials set the same units for the samplers they share, so the
+    // samplers stay right when they switch between programs
+    void resolve(const Shader &shader) const
+    {
+        for (const Binding &binding : bindings)
+            glUniform1i(shader.GetUniformLocation(binding.sampler), binding.unit);
+        shininessLocation = shader.GetUniformLocation(UniformName(samplerPrefix + "shininess"));
+        resolvedProgram = shader.ID;
+    }
+};
+
+#endif
@@ -6,31 +6,79 @@
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 
+#include <learnopengl/geometry_arena.h>
+#include <learnopengl/hash.h>
+#include <learnopengl/material.h>
 #include <learnopengl/shader.h>
+#include <learnopengl/vertex_format.h>
 
+#include <algorithm>
+#include <memory>
 #include <string>
 #include <vector>
+#include <utility>
 using namespace std;
 
-struct Vertex {
-    // position
-    glm::vec3 Position;
-    // normal
-    glm::vec3 Normal;
-    // texCoords
-    glm::vec2 TexCoords;
-    // tangent
-    glm::vec3 Tangent;
-    // bitangent
-    glm::vec3 Bitangent;
+// texture as referenced by a material, before it is loaded
+struct TextureRef {
+    string type;
+    string path;
 };
 
+// one level of detail: a range of the mesh's indices, and the largest distance (in model units) of its vertices
+// to the planes of the full mesh's triangles they replaced
+struct MeshLod {
+    unsigned int firstIndex;
+    unsigned int indexCount;
+    float error;
+};
 
+// CPU side mesh data, as produced by the importer or read back from the geometry cache.
+// indices hold the index lists of all LODs back to back, finest first.
+struct MeshData {
+    vector<Vertex>       vertices;
+    vector<unsigned int> indices;
+    vector<TextureRef>   textures;
+    vector<MeshLod>      lods;
+    // bounding box and sphere in model space
+    glm::vec3            boundsMin = glm::vec3(0.0f);
+    glm::vec3            boundsMax = glm::vec3(0.0f);
+    glm::vec3            boundsCenter = glm::vec3(0.0f);
+    float                boundsRadius = 0.0f;
+};
 
-struct Texture {
-    unsigned int id;
-    string type;
-    string path;
+// fits the bounding box and sphere (around the box center) to the vertices
+inline void ComputeBounds(MeshData &mesh)
+{
+    if (mesh.vertices.empty())
+        return;
+    mesh.boundsMin = mesh.boundsMax = mesh.vertices[0].Position;
+    for (const Vertex &vertex : mesh.vertices)
+    {
+        mesh.boundsMin = glm::min(mesh.boundsMin, vertex.Position);
+        mesh.boundsMax = glm::max(mesh.boundsMax, vertex.Position);
+    }
+    mesh.boundsCenter = (mesh.boundsMin + mesh.boundsMax) * 0.5f;
+    mesh.boundsRadius = 0.0f;
+    for (const Vertex &vertex : mesh.vertices)
+        mesh.boundsRadius = max(mesh.boundsRadius, glm::length(vertex.Position - mesh.boundsCenter));
+}
+
+// the uniforms DrawGeometry sets, resolved once per program. a program without one of them, like the depth
+// prepass without vertexFormat, gets location -1 for it
+struct MeshUniforms {
+    Uniform<int> vertexFormat;
+    Uniform<glm::vec3> positionScale;
+    Uniform<glm::vec3> positionBias;
+
+    MeshUniforms() = default;
+
+    explicit MeshUniforms(const Shader &shader)
+        : vertexFormat(shader.GetUniform<int>("vertexFormat")),
+          positionScale(shader.GetUniform<glm::vec3>("positionScale")),
+          positionBias(shader.GetUniform<glm::vec3>("positionBias"))
+    {
+    }
 };
 
 class Mesh {
@@ -38,102 +86,143 @@ public:
     // mesh Data
     vector<Vertex>       vertices;
     vector<unsigned int> indices;
-    vector<Texture>      textures;
+    // shared with the other meshes of the model that use the same textures
+    shared_ptr<Material> material;
 
     unsigned int VAO;
-    std::string glslIdentifierPrefix;
+    // VAO of the arena's position stream, for depth only passes
+    unsigned int PositionVAO;
+    // layout of the vertex buffer, packed positions are positionBias + positionScale * p
+    Vertex_Format vertexFormat;
+    glm::vec3 positionScale;
+    glm::vec3 positionBias;
+    // GL_UNSIGNED_SHORT for meshes with less than 64k vertices, GL_UNSIGNED_INT otherwise
+    GLenum indexType;
+    // levels of detail as ranges of indices, empty when all indices are one level
+    vector<MeshLod> lods;
+    glm::vec3 boundsMin = glm::vec3(0.0f);
+    glm::vec3 boundsMax = glm::vec3(0.0f);
+    glm::vec3 boundsCenter = glm::vec3(0.0f);
+    float boundsRadius = 0.0f;
     // constructor
-    Mesh(vector<Vertex> vertices, vector<unsigned int> indices, vector<Texture> textures)
+    Mesh(vector<Vertex> vertices, vector<unsigned int> indices, vector<Texture> textures, Vertex_Format format = VERTEX_FULL)
+        : Mesh(std::move(vertices), std::move(indices), make_shared<Material>(textures), format)
     {
-        this->vertices = vertices;
-        this->indices = indices;
-        this->textures = textures;
+    }
+
+    Mesh(vector<Vertex> vertices, vector<unsigned int> indices, shared_ptr<Material> material, Vertex_Format format = VERTEX_FULL)
+        : material(std::move(material)), vertexFormat(format), positionScale(1.0f), positionBias(0.0f), indexType(GL_UNSIGNED_INT)
+    {
+        this->vertices = std::move(vertices);
+        this->indices = std::move(indices);
 
         // now that we have all the required data, set the vertex buffers and its attribute pointers.
         setupMesh();
     }
 
-    // render the mesh
-    void Draw(Shader &shader)
+    // render the mesh at the given level of detail. bindGeometry can be false when the arena of the mesh's vertex
+    // format is already bound, so consecutive meshes don't switch VAOs.
+    void Draw(Shader &shader, bool bindGeometry = true, unsigned int lod = 0) const
     {
-        // bind appropriate textures
-        unsigned int diffuseNr  = 1;
-        unsigned int specularNr = 1;
-        unsigned int normalNr   = 1;
-        unsigned int heightNr   = 1;
-        for(unsigned int i = 0; i < textures.size(); i++)
-        {
-            glActiveTexture(GL_TEXTURE0 + i); // active proper texture unit before binding
-            // retrieve texture number (the N in diffuse_textureN)
-            string number;
-            string name = textures[i].type;
-            if(name == "texture_diffuse")
-                number = std::to_string(diffuseNr++);
-            else if(name == "texture_specular")
-                number = std::to_string(specularNr++); // transfer unsigned int to stream
-            else if(name == "texture_normal")
-                number = std::to_string(normalNr++); // transfer unsigned int to stream
-            else if(name == "texture_height")
-                number = std::to_string(heightNr++); // transfer unsigned int to stream
-
-            // now set the sampler to the correct texture unit
-            glUniform1i(glGetUniformLocation(shader.ID, (glslIdentifierPrefix + name + number).c_str()), i);
-            // and finally bind the texture
-            glBindTexture(GL_TEXTURE_2D, textures[i].id);
-        }
+        BindMaterial(shader);
+        if (bindGeometry)
+            glBindVertexArray(VAO);
+        DrawGeometry(MeshUniforms(shader), lod);
+    }
 
+    // binds the textures and sets the material parameters
+    void BindMaterial(Shader &shader) const
+    {
+        material->Bind(shader);
+    }
 
+    // draws the given level of detail with the uniforms of the program in use, the material and the VAO have to
+    // be bound already
+    void DrawGeometry(const MeshUniforms &uniforms, unsigned int lod = 0) const
+    {
+        // tell the vertex shader how to decode the vertices
+        uniforms.vertexFormat.Set(vertexFormat);
+        uniforms.positionScale.Set(positionScale);
+        uniforms.positionBias.Set(positionBias);
 
         // draw mesh
-        glBindVertexArray(VAO);
-        glDrawElements(GL_TRIANGLES, indices.size(), GL_UNSIGNED_INT, 0);
-        glBindVertexArray(0);
+        GeometryArena &arena = GeometryArena::ForFormat(vertexFormat);
+        size_t firstIndex = 0, indexCount = indices.size();
+        if (lod < lods.size())
+        {
+            firstIndex = lods[lod].firstIndex;
+            indexCount = lods[lod].indexCount;
+        }
+        size_t indexSize = indexType == GL_UNSIGNED_SHORT ? sizeof(uint16_t) : sizeof(unsigned int);
+        const char *indexOffset = static_cast<const char *>(arena.IndexOffset(geometry)) + firstIndex * indexSize;
+        glDrawElementsBaseVertex(GL_TRIANGLES, indexCount, indexType, indexOffset, arena.BaseVertex(geometry));
+    }
+
+    // identifies the material's state, meshes with the same one can share a material binding
+    uint64_t MaterialHash() const
+    {
+        return material->Hash();
+    }
 
-        // always good practice to set everything back to defaults once configured.
-        glActiveTexture(GL_TEXTURE0);
+    // prefix of the sampler names in the shader, the samplers are <prefix><type><N>. changes the shared material.
+    void SetTextureNamePrefix(const std::string &prefix)
+    {
+        material->SetSamplerPrefix(prefix);
+    }
+
+    // returns the mesh's space in the geometry arena. copies of a mesh share it, so only one of them may release it.
+    void Release()
+    {
+        GeometryArena::ForFormat(vertexFormat).Free(geometry);
+        geometry = GeometryArena::INVALID_HANDLE;
     }
 
 private:
-    // render data
-    unsigned int VBO, EBO;
+    // render data, an allocation in the GeometryArena of the vertex format
+    unsigned int geometry = GeometryArena::INVALID_HANDLE;
 
-    // initializes all the buffer objects/arrays
+    // converts the vertices to the vertex format and copies them and the indices into the arena
     void setupMesh()
     {
-        // create buffers/arrays
-        glGenVertexArrays(1, &VAO);
-        glGenBuffers(1, &VBO);
-        glGenBuffers(1, &EBO);
-
-        glBindVertexArray(VAO);
-        // load data into vertex buffers
-        glBindBuffer(GL_ARRAY_BUFFER, VBO);
-        // A great thing about structs is that their memory layout is sequential for all its items.
-        // The effect is that we can simply pass a pointer to the struct and it translates perfectly to a glm::vec3/2 array which
-        // again translates to 3/2 floats which translates to a byte array.
-        glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(Vertex), &vertices[0], GL_STATIC_DRAW);
-
-        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
-        glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), &indices[0], GL_STATIC_DRAW);
-
-        // set the vertex attribute pointers
-        // vertex Positions
-        glEnableVertexAttribArray(0);
-        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)0);
-        // vertex normals
-        glEnableVertexAttribArray(1);
-        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Normal));
-        // vertex texture coords
-        glEnableVertexAttribArray(2);
-        glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, TexCoords));
-        // vertex tangent
-        glEnableVertexAttribArray(3);
-        glVertexAttribPointer(3, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Tangent));
-        // vertex bitangent
-        glEnableVertexAttribArray(4);
-        glVertexAttribPointer(4, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Bitangent));
-
-        glBindVertexArray(0);
+        vector<unsigned char> vertexData;
+        if (vertexFormat == VERTEX_FULL)
+        {
+            // A great thing about structs is that their memory layout is sequential for all its items.
+            // The effect is that we can simply pass a pointer to the struct and it translates perfectly to a glm::vec3/2 array which
+            // again translates to 3/2 floats which translates to a byte array.
+            const unsigned char *bytes = reinterpret_cast<const unsigned char *>(vertices.data());
+            vertexData.assign(bytes, bytes + vertices.size() * sizeof(Vertex));
+        }
+        else
+            vertexData = packVertices();
+
+        GeometryArena &arena = GeometryArena::ForFormat(vertexFormat);
+        if (vertices.size() <= 65536)
+        {
+            // every index fits in 16 bits, halves the index buffer and the index fetch
+            vector<uint16_t> shortIndices(indices.begin(), indices.end());
+            geometry = arena.Allocate(vertexData.data(), vertices.size(), shortIndices.data(), shortIndices.size() * sizeof(uint16_t));
+            indexType = GL_UNSIGNED_SHORT;
+        }
+        else
+            geometry = arena.Allocate(vertexData.data(), vertices.size(), indices.data(), indices.size() * sizeof(unsigned int));
+        VAO = arena.VAO();
+        PositionVAO = arena.PositionVAO();
+    }
+
+    // quantizes the vertices to the compact layout
+    vector<unsigned char> packVertices()
+    {
+        PositionQuantization(vertices, positionScale, positionBias);
+        vector<unsigned char> packed(vertices.size() * GeometryArena::Stride(vertexFormat));
+        for (size_t i = 0; i < vertices.size(); i++)
+        {
+            if (vertexFormat == VERTEX_PACKED)
+                reinterpret_cast<PackedVertex *>(packed.data())[i] = PackVertex(vertices[i], positionScale, positionBias);
+            else
+                reinterpret_cast<PackedTangentVertex *>(packed.data())[i] = PackTangentVertex(vertices[i], positionScale, positionBias);
+        }
+        return packed;
     }
 };
 #endif
\ No newline at end of file
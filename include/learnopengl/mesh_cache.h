@@ -0,0 +1,219 @@
+#ifndef MESH_CACHE_H
+#define MESH_CACHE_H
+
+#include <learnopengl/hash.h>
+#include <learnopengl/mesh.h>
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <fstream>
+#include <iostream>
+#include <vector>
+using namespace std;
+
+// Binary geometry cache stored next to each model as <model path>.meshcache.
+// Holds the processed meshes (ready to upload vertex/index blobs plus texture references),
+// keyed by the content hash of the source file and the importer flags used to produce it.
+//
+// layout (all values little endian, every block 4 byte aligned):
+//   MeshCacheHeader
+//   per mesh: MeshCacheEntry, vertexCount * Vertex, indexCount * uint32, lodCount * MeshLod,
+//             textureCount * (uint32 typeLength, uint32 pathLength, type, path, padding)
+
+// bump whenever the file layout or the processing that produces MeshData changes
+const uint32_t MESH_CACHE_VERSION = 5;
+const char MESH_CACHE_MAGIC[8] = {'R', 'G', 'M', 'E', 'S', 'H', 0, 0};
+
+struct MeshCacheHeader {
+    char     magic[8];
+    uint32_t version;
+    uint32_t importFlags;
+    uint64_t sourceHash;
+    uint32_t vertexSize;
+    uint32_t meshCount;
+};
+
+struct MeshCacheEntry {
+    uint32_t vertexCount;
+    uint32_t indexCount;
+    uint32_t textureCount;
+    uint32_t lodCount;
+    float    boundsMin[3];
+    float    boundsMax[3];
+    float    boundsCenter[3];
+    float    boundsRadius;
+};
+
+class MeshCache
+{
+public:
+    static string CachePath(const string &sourcePath)
+    {
+        return sourcePath + ".meshcache";
+    }
+
+    // maps the cache file of sourcePath and fills meshes from it.
+    // returns false (leaving meshes empty) if there is no cache or it is stale.
+    static bool Load(const string &sourcePath, unsigned int importFlags, vector<MeshData> &meshes)
+    {
+        uint64_t sourceHash;
+        if (!HashFile(sourcePath, sourceHash))
+            return false;
+
+        int fd = open(CachePath(sourcePath).c_str(), O_RDONLY);
+        if (fd < 0)
+            return false;
+        struct stat info;
+        if (fstat(fd, &info) != 0 || (size_t) info.st_size < sizeof(MeshCacheHeader))
+        {
+            close(fd);
+            return false;
+        }
+        size_t size = (size_t) info.st_size;
+        void *mapped = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        close(fd);
+        if (mapped == MAP_FAILED)
+            return false;
+
+        bool ok = parse(static_cast<const char *>(mapped), size, sourceHash, importFlags, meshes);
+        munmap(mapped, size);
+        if (!ok)
+            meshes.clear();
+        return ok;
+    }
+
+    // writes meshes to the cache file of sourcePath, replacing the old one atomically
+    static bool Store(const string &sourcePath, unsigned int importFlags, const vector<MeshData> &meshes)
+    {
+        uint64_t sourceHash;
+        if (!HashFile(sourcePath, sourceHash))
+            return false;
+
+        string cachePath = CachePath(sourcePath);
+        string tempPath = cachePath + ".tmp";
+        ofstream out(tempPath, ios::binary | ios::trunc);
+        if (!out)
+        {
+            cout << "ERROR::MESH_CACHE:: can't write " << tempPath << endl;
+            return false;
+        }
+
+        MeshCacheHeader header;
+        memcpy(header.magic, MESH_CACHE_MAGIC, sizeof(header.magic));
+        header.version = MESH_CACHE_VERSION;
+        header.importFlags = importFlags;
+        header.sourceHash = sourceHash;
+        header.vertexSize = sizeof(Vertex);
+        header.meshCount = (uint32_t) meshes.size();
+        out.write(reinterpret_cast<const char *>(&header), sizeof(header));
+
+        for (const MeshData &mesh : meshes)
+        {
+            MeshCacheEntry entry;
+            entry.vertexCount = (uint32_t) mesh.vertices.size();
+            entry.indexCount = (uint32_t) mesh.indices.size();
+            entry.textureCount = (uint32_t) mesh.textures.size();
+            entry.lodCount = (uint32_t) mesh.lods.size();
+            memcpy(entry.boundsMin, &mesh.boundsMin[0], sizeof(entry.boundsMin));
+            memcpy(entry.boundsMax, &mesh.boundsMax[0], sizeof(entry.boundsMax));
+            memcpy(entry.boundsCenter, &mesh.boundsCenter[0], sizeof(entry.boundsCenter));
+            entry.boundsRadius = mesh.boundsRadius;
+            out.write(reinterpret_cast<const char *>(&entry), sizeof(entry));
+            out.write(reinterpret_cast<const char *>(mesh.vertices.data()), mesh.vertices.size() * sizeof(Vertex));
+            out.write(reinterpret_cast<const char *>(mesh.indices.data()), mesh.indices.size() * sizeof(uint32_t));
+            out.write(reinterpret_cast<const char *>(mesh.lods.data()), mesh.lods.size() * sizeof(MeshLod));
+            for (const TextureRef &texture : mesh.textures)
+            {
+                uint32_t lengths[2] = {(uint32_t) texture.type.size(), (uint32_t) texture.path.size()};
+                out.write(reinterpret_cast<const char *>(lengths), sizeof(lengths));
+                out.write(texture.type.data(), texture.type.size());
+                out.write(texture.path.data(), texture.path.size());
+                const char zeros[4] = {0, 0, 0, 0};
+                out.write(zeros, padding(texture.type.size() + texture.path.size()));
+            }
+        }
+        out.close();
+        if (!out || rename(tempPath.c_str(), cachePath.c_str()) != 0)
+        {
+            cout << "ERROR::MESH_CACHE:: failed to write " << cachePath << endl;
+            remove(tempPath.c_str());
+            return false;
+        }
+        return true;
+    }
+
+private:
+    static size_t padding(size_t size)
+    {
+        return (4 - size % 4) % 4;
+    }
+
+    static bool parse(const char *data, size_t size, uint64_t sourceHash, unsigned int importFlags, vector<MeshData> &meshes)
+    {
+        const MeshCacheHeader *header = reinterpret_cast<const MeshCacheHeader *>(data);
+        if (memcmp(header->magic, MESH_CACHE_MAGIC, sizeof(header->magic)) != 0
+            || header->version != MESH_CACHE_VERSION
+            || header->importFlags != importFlags
+            || header->sourceHash != sourceHash
+            || header->vertexSize != sizeof(Vertex))
+            return false;
+
+        size_t offset = sizeof(MeshCacheHeader);
+        meshes.resize(header->meshCount);
+        for (MeshData &mesh : meshes)
+        {
+            if (size - offset < sizeof(MeshCacheEntry))
+                return false;
+            const MeshCacheEntry *entry = reinterpret_cast<const MeshCacheEntry *>(data + offset);
+            offset += sizeof(MeshCacheEntry);
+
+            size_t vertexBytes = (size_t) entry->vertexCount * sizeof(Vertex);
+            size_t indexBytes = (size_t) entry->indexCount * sizeof(uint32_t);
+            size_t lodBytes = (size_t) entry->lodCount * sizeof(MeshLod);
+            if (size - offset < vertexBytes + indexBytes + lodBytes)
+                return false;
+            const Vertex *vertices = reinterpret_cast<const Vertex *>(data + offset);
+            mesh.vertices.assign(vertices, vertices + entry->vertexCount);
+            offset += vertexBytes;
+            const uint32_t *indices = reinterpret_cast<const uint32_t *>(data + offset);
+            mesh.indices.assign(indices, indices + entry->indexCount);
+            offset += indexBytes;
+            const MeshLod *lods = reinterpret_cast<const MeshLod *>(data + offset);
+            mesh.lods.assign(lods, lods + entry->lodCount);
+            offset += lodBytes;
+            for (const MeshLod &lod : mesh.lods)
+            {
+                if ((size_t) lod.firstIndex + lod.indexCount > mesh.indices.size())
+                    return false;
+            }
+            mesh.boundsMin = glm::vec3(entry->boundsMin[0], entry->boundsMin[1], entry->boundsMin[2]);
+            mesh.boundsMax = glm::vec3(entry->boundsMax[0], entry->boundsMax[1], entry->boundsMax[2]);
+            mesh.boundsCenter = glm::vec3(entry->boundsCenter[0], entry->boundsCenter[1], entry->boundsCenter[2]);
+            mesh.boundsRadius = entry->boundsRadius;
+
+            mesh.textures.resize(entry->textureCount);
+            for (TextureRef &texture : mesh.textures)
+            {
+                if (size - offset < 2 * sizeof(uint32_t))
+                    return false;
+                const uint32_t *lengths = reinterpret_cast<const uint32_t *>(data + offset);
+                size_t typeLength = lengths[0], pathLength = lengths[1];
+                offset += 2 * sizeof(uint32_t);
+                if (size - offset < typeLength + pathLength + padding(typeLength + pathLength))
+                    return false;
+                texture.type.assign(data + offset, typeLength);
+                texture.path.assign(data + offset + typeLength, pathLength);
+                offset += typeLength + pathLength + padding(typeLength + pathLength);
+            }
+        }
+        return offset == size;
+    }
+};
+
+#endif
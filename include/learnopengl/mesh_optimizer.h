@@ -0,0 +1,403 @@
+#ifndef MESH_OPTIMIZER_H
+#define MESH_OPTIMIZER_H
+
+#include <glm/glm.hpp>
+
+#include <learnopengl/hash.h>
+#include <learnopengl/mesh.h>
+#include <learnopengl/mesh_simplifier.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+using namespace std;
+
+// size of the FIFO post transform cache ACMR/ATVR are measured with, a typical hardware value
+const unsigned int MESH_STATS_CACHE_SIZE = 16;
+// size of the LRU cache the triangle order is optimized for
+const unsigned int MESH_OPTIMIZER_CACHE_SIZE = 32;
+// how much worse than the cache optimized order the overdraw pass may make the ACMR
+const float MESH_OVERDRAW_THRESHOLD = 1.05f;
+// levels of detail per mesh including the full one, each with about MESH_LOD_REDUCTION of the previous one's triangles
+const unsigned int MESH_LOD_LEVELS = 4;
+const float MESH_LOD_REDUCTION = 0.5f;
+// a level that doesn't get below this fraction of the previous one's triangles isn't worth keeping
+const float MESH_LOD_MIN_REDUCTION = 0.8f;
+
+// vertex cache efficiency of an index buffer, summed over meshes so assets can be reported as a whole
+struct MeshStats {
+    size_t triangles = 0;
+    size_t vertices = 0;
+    size_t misses = 0;
+    // triangles of the coarsest level of detail
+    size_t lodTriangles = 0;
+
+    // average cache miss ratio: transformed vertices per triangle, 0.5 is the ideal for large grids
+    float ACMR() const
+    {
+        return triangles ? (float) misses / triangles : 0.0f;
+    }
+
+    // average transform to vertex ratio: 1 means every vertex is transformed exactly once
+    float ATVR() const
+    {
+        return vertices ? (float) misses / vertices : 0.0f;
+    }
+
+    MeshStats &operator+=(const MeshStats &other)
+    {
+        triangles += other.triangles;
+        vertices += other.vertices;
+        misses += other.misses;
+        lodTriangles += other.lodTriangles;
+        return *this;
+    }
+};
+
+// what the optimizer did to a mesh (or all meshes of a model)
+struct MeshOptimizerReport {
+    MeshStats before;
+    MeshStats after;
+
+    MeshOptimizerReport &operator+=(const MeshOptimizerReport &other)
+    {
+        before += other.before;
+        after += other.after;
+        return *this;
+    }
+
+    void Print(const string &name) const
+    {
+        char line[256];
+        snprintf(line, sizeof(line), "vertices %zu -> %zu, ACMR %.3f -> %.3f, ATVR %.3f -> %.3f, LOD triangles %zu -> %zu",
+                 before.vertices, after.vertices, before.ACMR(), after.ACMR(), before.ATVR(), after.ATVR(), after.triangles, after.lodTriangles);
+        cout << "MESH_OPTIMIZER:: " << name << ": " << line << endl;
+    }
+};
+
+// simulates a FIFO cache of the given size over the index buffer
+inline MeshStats AnalyzeVertexCache(const vector<unsigned int> &indices, size_t vertexCount, unsigned int cacheSize = MESH_STATS_CACHE_SIZE)
+{
+    MeshStats stats;
+    stats.triangles = indices.size() / 3;
+    stats.vertices = vertexCount;
+
+    // a vertex is in the cache if it was put there less than cacheSize misses ago
+    vector<size_t> insertedAt(vertexCount, 0);
+    size_t time = cacheSize + 1;
+    for (unsigned int index : indices)
+    {
+        if (time - insertedAt[index] > cacheSize)
+        {
+            insertedAt[index] = time++;
+            stats.misses++;
+        }
+    }
+    return stats;
+}
+
+// merges bit identical vertices, the importer emits separate vertices for every face corner
+inline void WeldVertices(vector<Vertex> &vertices, vector<unsigned int> &indices)
+{
+    vector<unsigned int> remap(vertices.size());
+    vector<Vertex> welded;
+    welded.reserve(vertices.size());
+    unordered_multimap<uint64_t, unsigned int> unique;
+    unique.reserve(vertices.size());
+
+    for (unsigned int i = 0; i < vertices.size(); i++)
+    {
+        uint64_t hash = HashBytes(&vertices[i], sizeof(Vertex));
+        unsigned int found = (unsigned int) welded.size();
+        auto candidates = unique.equal_range(hash);
+        for (auto candidate = candidates.first; candidate != candidates.second; ++candidate)
+        {
+            if (memcmp(&welded[candidate->second], &vertices[i], sizeof(Vertex)) == 0)
+            {
+                found = candidate->second;
+                break;
+            }
+        }
+        if (found == welded.size())
+        {
+            unique.emplace(hash, found);
+            welded.push_back(vertices[i]);
+        }
+        remap[i] = found;
+    }
+
+    for (unsigned int &index : indices)
+        index = remap[index];
+    vertices = std::move(welded);
+}
+
+// Tom Forsyth's linear speed vertex cache optimization: greedily emits the triangle with the best score,
+// where vertices score high when they are recently used (in an LRU cache model) or have few triangles left.
+inline void OptimizeVertexCache(vector<unsigned int> &indices, size_t vertexCount)
+{
+    const unsigned int cacheSize = MESH_OPTIMIZER_CACHE_SIZE;
+    size_t triangleCount = indices.size() / 3;
+    if (triangleCount == 0)
+        return;
+
+    auto vertexScore = [cacheSize](int cachePosition, unsigned int trianglesLeft) {
+        if (trianglesLeft == 0)
+            return -1.0f;
+        float score = 0.0f;
+        if (cachePosition >= 0)
+        {
+            // the last triangle's vertices get a fixed score so the next triangle doesn't just reuse its edge
+            if (cachePosition < 3)
+                score = 0.75f;
+            else
+                score = pow(1.0f - (float) (cachePosition - 3) / (cacheSize - 3), 1.5f);
+        }
+        // boost vertices with few triangles left, so lone triangles don't get left behind
+        return score + 2.0f * pow((float) trianglesLeft, -0.5f);
+    };
+
+    // triangles using each vertex, as offsets into one adjacency array
+    vector<unsigned int> trianglesLeft(vertexCount, 0), adjacencyOffset(vertexCount + 1, 0), adjacency(indices.size());
+    for (unsigned int index : indices)
+        trianglesLeft[index]++;
+    for (size_t v = 0; v < vertexCount; v++)
+        adjacencyOffset[v + 1] = adjacencyOffset[v] + trianglesLeft[v];
+    vector<unsigned int> filled(adjacencyOffset.begin(), adjacencyOffset.end() - 1);
+    for (size_t i = 0; i < indices.size(); i++)
+        adjacency[filled[indices[i]]++] = (unsigned int) (i / 3);
+
+    vector<int> cachePosition(vertexCount, -1);
+    vector<float> score(vertexCount);
+    for (size_t v = 0; v < vertexCount; v++)
+        score[v] = vertexScore(-1, trianglesLeft[v]);
+    vector<float> triangleScore(triangleCount);
+    for (size_t t = 0; t < triangleCount; t++)
+        triangleScore[t] = score[indices[t * 3]] + score[indices[t * 3 + 1]] + score[indices[t * 3 + 2]];
+
+    vector<bool> emitted(triangleCount, false);
+    vector<unsigned int> result;
+    result.reserve(indices.size());
+    vector<unsigned int> cache, nextCache;
+    size_t scanPosition = 0;
+    int best = 0;
+
+    while (best >= 0)
+    {
+        emitted[best] = true;
+        const unsigned int *triangle = &indices[best * 3];
+        result.insert(result.end(), triangle, triangle + 3);
+
+        // move the triangle's vertices to the front of the cache
+        nextCache.assign(triangle, triangle + 3);
+        for (unsigned int v : cache)
+        {
+            if (v != triangle[0] && v != triangle[1] && v != triangle[2])
+                nextCache.push_back(v);
+        }
+        for (int corner = 0; corner < 3; corner++)
+        {
+            unsigned int v = triangle[corner];
+            trianglesLeft[v]--;
+            unsigned int *begin = &adjacency[adjacencyOffset[v]];
+            unsigned int *end = begin + trianglesLeft[v] + 1;
+            *std::find(begin, end, (unsigned int) best) = *(end - 1);
+        }
+
+        // rescore every vertex that was or is in the cache, and the triangles using them
+        for (size_t i = 0; i < nextCache.size(); i++)
+        {
+            unsigned int v = nextCache[i];
+            cachePosition[v] = i < cacheSize ? (int) i : -1;
+            float newScore = vertexScore(cachePosition[v], trianglesLeft[v]);
+            float delta = newScore - score[v];
+            score[v] = newScore;
+            for (unsigned int a = adjacencyOffset[v]; a < adjacencyOffset[v] + trianglesLeft[v]; a++)
+                triangleScore[adjacency[a]] += delta;
+        }
+        if (nextCache.size() > cacheSize)
+            nextCache.resize(cacheSize);
+        cache.swap(nextCache);
+
+        // the next triangle is the best one touching the cache, or the first one left when nothing does
+        best = -1;
+        float bestScore = -1.0f;
+        for (unsigned int v : cache)
+        {
+            for (unsigned int a = adjacencyOffset[v]; a < adjacencyOffset[v] + trianglesLeft[v]; a++)
+            {
+                unsigned int t = adjacency[a];
+                if (triangleScore[t] > bestScore)
+                {
+                    bestScore = triangleScore[t];
+                    best = (int) t;
+                }
+            }
+        }
+        if (best < 0)
+        {
+            while (scanPosition < triangleCount && emitted[scanPosition])
+                scanPosition++;
+            if (scanPosition < triangleCount)
+                best = (int) scanPosition;
+        }
+    }
+    indices = std::move(result);
+}
+
+// Reorders clusters of the cache optimized triangles so the outward facing ones come first, which lets the
+// early depth test reject more of the hidden fragments (after Sander et al., "Fast Triangle Reordering for
+// Vertex Locality and Reduced Overdraw"). Clusters start where the cache is cold anyway, and only if the
+// ACMR stays within threshold of what the cache optimization reached.
+inline void OptimizeOverdraw(vector<unsigned int> &indices, const vector<Vertex> &vertices, float threshold = MESH_OVERDRAW_THRESHOLD)
+{
+    size_t triangleCount = indices.size() / 3;
+    if (triangleCount < 2)
+        return;
+
+    // split where every vertex of a triangle misses the cache, the order before and after it doesn't matter there
+    float allowedACMR = AnalyzeVertexCache(indices, vertices.size()).ACMR() * threshold;
+    vector<size_t> clusterStart;
+    {
+        vector<size_t> insertedAt(vertices.size(), 0);
+        size_t time = MESH_STATS_CACHE_SIZE + 1, clusterMisses = 0;
+        for (size_t t = 0; t < triangleCount; t++)
+        {
+            unsigned int misses = 0;
+            for (int corner = 0; corner < 3; corner++)
+            {
+                unsigned int v = indices[t * 3 + corner];
+                if (time - insertedAt[v] > MESH_STATS_CACHE_SIZE)
+                {
+                    insertedAt[v] = time++;
+                    misses++;
+                }
+            }
+            size_t clusterTriangles = clusterStart.empty() ? 0 : t - clusterStart.back();
+            if (clusterStart.empty() || (misses == 3 && clusterMisses <= allowedACMR * clusterTriangles))
+            {
+                clusterStart.push_back(t);
+                clusterMisses = 0;
+            }
+            clusterMisses += misses;
+        }
+    }
+    if (clusterStart.size() < 2)
+        return;
+    clusterStart.push_back(triangleCount);
+
+    // area weighted centroid and normal of every cluster, sorted by how much they face away from the mesh center
+    glm::vec3 meshCentroid(0.0f);
+    float meshArea = 0.0f;
+    size_t clusterCount = clusterStart.size() - 1;
+    vector<glm::vec3> clusterCentroid(clusterCount, glm::vec3(0.0f)), clusterNormal(clusterCount, glm::vec3(0.0f));
+    vector<float> clusterArea(clusterCount, 0.0f);
+    for (size_t c = 0; c < clusterCount; c++)
+    {
+        for (size_t t = clusterStart[c]; t < clusterStart[c + 1]; t++)
+        {
+            const glm::vec3 &a = vertices[indices[t * 3]].Position, &b = vertices[indices[t * 3 + 1]].Position, &d = vertices[indices[t * 3 + 2]].Position;
+            glm::vec3 normal = glm::cross(b - a, d - a);
+            float area = glm::length(normal);
+            clusterCentroid[c] += (a + b + d) * (area / 3.0f);
+            clusterNormal[c] += normal;
+            clusterArea[c] += area;
+        }
+        meshCentroid += clusterCentroid[c];
+        meshArea += clusterArea[c];
+    }
+    if (meshArea > 0.0f)
+        meshCentroid /= meshArea;
+
+    vector<float> sortKey(clusterCount, 0.0f);
+    for (size_t c = 0; c < clusterCount; c++)
+    {
+        float normalLength = glm::length(clusterNormal[c]);
+        if (clusterArea[c] > 0.0f && normalLength > 0.0f)
+            sortKey[c] = glm::dot(clusterCentroid[c] / clusterArea[c] - meshCentroid, clusterNormal[c] / normalLength);
+    }
+    vector<size_t> order(clusterCount);
+    for (size_t c = 0; c < clusterCount; c++)
+        order[c] = c;
+    stable_sort(order.begin(), order.end(), [&sortKey](size_t a, size_t b) { return sortKey[a] > sortKey[b]; });
+
+    vector<unsigned int> result;
+    result.reserve(indices.size());
+    for (size_t c : order)
+        result.insert(result.end(), indices.begin() + clusterStart[c] * 3, indices.begin() + clusterStart[c + 1] * 3);
+    indices = std::move(result);
+}
+
+// orders the vertices by first use, so fetching them walks the vertex buffer front to back. drops unused vertices.
+inline void OptimizeVertexFetch(vector<Vertex> &vertices, vector<unsigned int> &indices)
+{
+    const unsigned int unassigned = ~0u;
+    vector<unsigned int> remap(vertices.size(), unassigned);
+    vector<Vertex> ordered;
+    ordered.reserve(vertices.size());
+    for (unsigned int &index : indices)
+    {
+        if (remap[index] == unassigned)
+        {
+            remap[index] = (unsigned int) ordered.size();
+            ordered.push_back(vertices[index]);
+        }
+        index = remap[index];
+    }
+    vertices = std::move(ordered);
+}
+
+// simplified index lists of the welded mesh, finest first; the first one is indices itself
+inline vector<vector<unsigned int>> BuildLods(const vector<Vertex> &vertices, const vector<unsigned int> &indices, vector<float> &errors)
+{
+    vector<vector<unsigned int>> levels(1, indices);
+    errors.assign(1, 0.0f);
+    MeshSimplifier simplifier(vertices, indices);
+    while (levels.size() < MESH_LOD_LEVELS)
+    {
+        size_t previous = levels.back().size() / 3;
+        float error;
+        vector<unsigned int> level = simplifier.Simplify((size_t) (previous * MESH_LOD_REDUCTION), error);
+        if (level.empty() || level.size() / 3 > previous * MESH_LOD_MIN_REDUCTION)
+            break;
+        levels.push_back(std::move(level));
+        errors.push_back(error);
+    }
+    return levels;
+}
+
+// runs all the passes on a freshly imported mesh, in the order they depend on each other
+inline MeshOptimizerReport OptimizeMesh(MeshData &mesh)
+{
+    MeshOptimizerReport report;
+    report.before = AnalyzeVertexCache(mesh.indices, mesh.vertices.size());
+    report.before.lodTriangles = report.before.triangles;
+
+    WeldVertices(mesh.vertices, mesh.indices);
+    vector<float> errors;
+    vector<vector<unsigned int>> levels = BuildLods(mesh.vertices, mesh.indices, errors);
+
+    mesh.indices.clear();
+    mesh.lods.clear();
+    for (size_t i = 0; i < levels.size(); i++)
+    {
+        OptimizeVertexCache(levels[i], mesh.vertices.size());
+        if (i == 0)
+            OptimizeOverdraw(levels[i], mesh.vertices);
+        mesh.lods.push_back(MeshLod{(unsigned int) mesh.indices.size(), (unsigned int) levels[i].size(), errors[i]});
+        mesh.indices.insert(mesh.indices.end(), levels[i].begin(), levels[i].end());
+    }
+    // the coarser levels only use vertices of the full one, so its order decides
+    OptimizeVertexFetch(mesh.vertices, mesh.indices);
+
+    vector<unsigned int> full(mesh.indices.begin(), mesh.indices.begin() + mesh.lods[0].indexCount);
+    report.after = AnalyzeVertexCache(full, mesh.vertices.size());
+    report.after.lodTriangles = mesh.lods.back().indexCount / 3;
+    return report;
+}
+
+#endif
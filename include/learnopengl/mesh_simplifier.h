@@ -0,0 +1,343 @@
+#ifndef MESH_SIMPLIFIER_H
+#define MESH_SIMPLIFIER_H
+
+#include <glm/glm.hpp>
+
+#include <learnopengl/vertex_format.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <queue>
+#include <unordered_map>
+#include <vector>
+using namespace std;
+
+// Quadric error edge collapse simplification (Garland & Heckbert).
+// Collapses are half edge collapses onto existing vertices, so every level indexes the original vertex buffer
+// and the levels only differ in their index lists. Vertices on borders and attribute seams (several vertices
+// at one position) never move, which keeps the outline and the texture mapping intact.
+// The quadrics only order the collapses (they measure RMS distance); the error reported for a level is the
+// largest distance of any vertex that took part in a collapse to the original triangle planes it now stands for.
+class MeshSimplifier
+{
+public:
+    MeshSimplifier(const vector<Vertex> &vertices, const vector<unsigned int> &indices)
+        : vertices(vertices), triangles(indices), remap(vertices.size()), version(vertices.size(), 0),
+          locked(vertices.size(), false), quadrics(vertices.size()), vertexTriangles(vertices.size()),
+          vertexPlanes(vertices.size())
+    {
+        for (unsigned int v = 0; v < vertices.size(); v++)
+            remap[v] = v;
+        aliveTriangles = triangles.size() / 3;
+        triangleAlive.assign(aliveTriangles, true);
+
+        lockBordersAndSeams();
+        planes.resize(aliveTriangles);
+        for (size_t t = 0; t < aliveTriangles; t++)
+        {
+            const unsigned int *corners = &triangles[t * 3];
+            double area = 0.0;
+            planes[t] = Plane::FromTriangle(vertices[corners[0]].Position, vertices[corners[1]].Position, vertices[corners[2]].Position, area);
+            Quadric quadric = Quadric::FromPlane(planes[t], area);
+            for (int corner = 0; corner < 3; corner++)
+            {
+                quadrics[corners[corner]] += quadric;
+                vertexTriangles[corners[corner]].push_back((unsigned int) t);
+                vertexPlanes[corners[corner]].push_back((unsigned int) t);
+            }
+        }
+        for (size_t t = 0; t < aliveTriangles; t++)
+        {
+            for (int corner = 0; corner < 3; corner++)
+            {
+                pushCollapse(triangles[t * 3 + corner], triangles[t * 3 + (corner + 1) % 3]);
+                pushCollapse(triangles[t * 3 + (corner + 1) % 3], triangles[t * 3 + corner]);
+            }
+        }
+    }
+
+    // collapses edges, cheapest first, until at most targetTriangles are left or nothing can be collapsed.
+    // returns the remaining triangles; error is the largest distance (in model units) of a collapsed vertex to the
+    // original planes around it so far.
+    vector<unsigned int> Simplify(size_t targetTriangles, float &error)
+    {
+        while (aliveTriangles > targetTriangles && !collapses.empty())
+        {
+            Collapse collapse = collapses.top();
+            collapses.pop();
+            if (remap[collapse.from] != collapse.from || remap[collapse.to] != collapse.to
+                || version[collapse.from] != collapse.fromVersion || version[collapse.to] != collapse.toVersion)
+                continue;
+            if (!collapseValid(collapse.from, collapse.to))
+                continue;
+            maxError = max(maxError, planeDistance(collapse.from, collapse.to));
+            apply(collapse.from, collapse.to);
+        }
+
+        error = maxError;
+        vector<unsigned int> result;
+        result.reserve(aliveTriangles * 3);
+        for (size_t t = 0; t < triangleAlive.size(); t++)
+        {
+            if (triangleAlive[t])
+                result.insert(result.end(), &triangles[t * 3], &triangles[t * 3 + 3]);
+        }
+        return result;
+    }
+
+private:
+    // unit normal and offset of a triangle's plane, all zero for degenerate triangles
+    struct Plane {
+        double n[4] = {};
+
+        static Plane FromTriangle(const glm::vec3 &p0, const glm::vec3 &p1, const glm::vec3 &p2, double &area)
+        {
+            Plane plane;
+            // in double, the plane offsets of far away triangles lose too much in float
+            double e1[3] = {(double) p1.x - p0.x, (double) p1.y - p0.y, (double) p1.z - p0.z};
+            double e2[3] = {(double) p2.x - p0.x, (double) p2.y - p0.y, (double) p2.z - p0.z};
+            double normal[3] = {e1[1] * e2[2] - e1[2] * e2[1], e1[2] * e2[0] - e1[0] * e2[2], e1[0] * e2[1] - e1[1] * e2[0]};
+            double length = sqrt(normal[0] * normal[0] + normal[1] * normal[1] + normal[2] * normal[2]);
+            area = length * 0.5;
+            if (length == 0.0)
+                return plane;
+            for (int i = 0; i < 3; i++)
+                plane.n[i] = normal[i] / length;
+            plane.n[3] = -(plane.n[0] * p0.x + plane.n[1] * p0.y + plane.n[2] * p0.z);
+            return plane;
+        }
+
+        double Distance(const glm::vec3 &p) const
+        {
+            return fabs(n[0] * p.x + n[1] * p.y + n[2] * p.z + n[3]);
+        }
+    };
+
+    // symmetric 4x4 matrix of the squared distance to a set of planes, weighted by triangle area
+    struct Quadric {
+        double a[10] = {};
+        double weight = 0.0;
+
+        static Quadric FromPlane(const Plane &plane, double area)
+        {
+            Quadric q;
+            int k = 0;
+            for (int i = 0; i < 4; i++)
+                for (int j = i; j < 4; j++)
+                    q.a[k++] = plane.n[i] * plane.n[j] * area;
+            q.weight = area;
+            return q;
+        }
+
+        Quadric &operator+=(const Quadric &other)
+        {
+            for (int i = 0; i < 10; i++)
+                a[i] += other.a[i];
+            weight += other.weight;
+            return *this;
+        }
+
+        // root mean squared distance of the point to the planes
+        float Distance(const glm::vec3 &p) const
+        {
+            double x = p.x, y = p.y, z = p.z;
+            double error = a[0] * x * x + 2 * a[1] * x * y + 2 * a[2] * x * z + 2 * a[3] * x
+                         + a[4] * y * y + 2 * a[5] * y * z + 2 * a[6] * y
+                         + a[7] * z * z + 2 * a[8] * z
+                         + a[9];
+            return weight > 0.0 ? (float) sqrt(max(0.0, error) / weight) : 0.0f;
+        }
+    };
+
+    struct Collapse {
+        float cost;
+        unsigned int from, to;
+        unsigned int fromVersion, toVersion;
+
+        bool operator<(const Collapse &other) const
+        {
+            // priority_queue pops the largest, we want the cheapest
+            return cost > other.cost;
+        }
+    };
+
+    const vector<Vertex> &vertices;
+    vector<unsigned int> triangles;
+    vector<bool> triangleAlive;
+    size_t aliveTriangles;
+    vector<unsigned int> remap;
+    vector<unsigned int> version;
+    vector<bool> locked;
+    vector<Quadric> quadrics;
+    vector<vector<unsigned int>> vertexTriangles;
+    // planes of the original triangles, and the ones each vertex stands for (its own and those collapsed into it)
+    vector<Plane> planes;
+    vector<vector<unsigned int>> vertexPlanes;
+    priority_queue<Collapse> collapses;
+    float maxError = 0.0f;
+
+    // vertices sharing a position with another vertex sit on an attribute seam; edges used by only one
+    // triangle (comparing positions, not vertices) are on a border
+    void lockBordersAndSeams()
+    {
+        // vertices sorted by position, so equal positions are adjacent
+        vector<unsigned int> order(vertices.size());
+        for (unsigned int v = 0; v < vertices.size(); v++)
+            order[v] = v;
+        sort(order.begin(), order.end(), [this](unsigned int a, unsigned int b) {
+            const glm::vec3 &p = vertices[a].Position, &q = vertices[b].Position;
+            return p.x != q.x ? p.x < q.x : p.y != q.y ? p.y < q.y : p.z < q.z;
+        });
+        vector<unsigned int> positionId(vertices.size());
+        vector<unsigned int> positionUses;
+        for (size_t i = 0; i < order.size(); i++)
+        {
+            if (i == 0 || vertices[order[i]].Position != vertices[order[i - 1]].Position)
+                positionUses.push_back(0);
+            positionId[order[i]] = (unsigned int) positionUses.size() - 1;
+            positionUses.back()++;
+        }
+        for (unsigned int v = 0; v < vertices.size(); v++)
+        {
+            if (positionUses[positionId[v]] > 1)
+                locked[v] = true;
+        }
+
+        unordered_map<uint64_t, int> edges;
+        for (size_t i = 0; i < triangles.size(); i += 3)
+        {
+            for (int corner = 0; corner < 3; corner++)
+            {
+                unsigned int a = positionId[triangles[i + corner]], b = positionId[triangles[i + (corner + 1) % 3]];
+                edges[((uint64_t) min(a, b) << 32) | max(a, b)]++;
+            }
+        }
+        for (size_t i = 0; i < triangles.size(); i += 3)
+        {
+            for (int corner = 0; corner < 3; corner++)
+            {
+                unsigned int va = triangles[i + corner], vb = triangles[i + (corner + 1) % 3];
+                unsigned int a = positionId[va], b = positionId[vb];
+                if (edges[((uint64_t) min(a, b) << 32) | max(a, b)] == 1)
+                    locked[va] = locked[vb] = true;
+            }
+        }
+    }
+
+    void pushCollapse(unsigned int from, unsigned int to)
+    {
+        if (locked[from] || from == to)
+            return;
+        Quadric combined = quadrics[from];
+        combined += quadrics[to];
+        collapses.push(Collapse{combined.Distance(vertices[to].Position), from, to, version[from], version[to]});
+    }
+
+    // largest distance of to's position to the original planes around from and to
+    float planeDistance(unsigned int from, unsigned int to) const
+    {
+        const glm::vec3 &target = vertices[to].Position;
+        double distance = 0.0;
+        for (unsigned int v : {from, to})
+            for (unsigned int plane : vertexPlanes[v])
+                distance = max(distance, planes[plane].Distance(target));
+        return (float) distance;
+    }
+
+    // rejects collapses that would flip a triangle around from
+    bool collapseValid(unsigned int from, unsigned int to) const
+    {
+        const glm::vec3 &target = vertices[to].Position;
+        for (unsigned int t : vertexTriangles[from])
+        {
+            if (!triangleAlive[t])
+                continue;
+            const unsigned int *corners = &triangles[t * 3];
+            if (corners[0] == to || corners[1] == to || corners[2] == to)
+                continue;
+            glm::vec3 p[3], moved[3];
+            for (int corner = 0; corner < 3; corner++)
+            {
+                p[corner] = vertices[corners[corner]].Position;
+                moved[corner] = corners[corner] == from ? target : p[corner];
+            }
+            glm::vec3 before = glm::cross(p[1] - p[0], p[2] - p[0]);
+            glm::vec3 after = glm::cross(moved[1] - moved[0], moved[2] - moved[0]);
+            if (glm::dot(before, after) <= 0.0f)
+                return false;
+        }
+        return true;
+    }
+
+    void apply(unsigned int from, unsigned int to)
+    {
+        remap[from] = to;
+        quadrics[to] += quadrics[from];
+        vector<unsigned int> &merged = vertexPlanes[to];
+        merged.insert(merged.end(), vertexPlanes[from].begin(), vertexPlanes[from].end());
+        sort(merged.begin(), merged.end());
+        merged.erase(unique(merged.begin(), merged.end()), merged.end());
+        vector<unsigned int>().swap(vertexPlanes[from]);
+        for (unsigned int t : vertexTriangles[from])
+        {
+            if (!triangleAlive[t])
+                continue;
+            unsigned int *corners = &triangles[t * 3];
+            if (corners[0] == to || corners[1] == to || corners[2] == to)
+            {
+                triangleAlive[t] = false;
+                aliveTriangles--;
+                continue;
+            }
+            for (int corner = 0; corner < 3; corner++)
+            {
+                if (corners[corner] == from)
+                    corners[corner] = to;
+            }
+            vertexTriangles[to].push_back(t);
+        }
+        vertexTriangles[from].clear();
+
+        // the costs of all edges around the target changed
+        version[to]++;
+        vector<unsigned int> neighbors;
+        for (unsigned int t : vertexTriangles[to])
+        {
+            if (!triangleAlive[t])
+                continue;
+            for (int corner = 0; corner < 3; corner++)
+            {
+                unsigned int v = triangles[t * 3 + corner];
+                if (v != to)
+                    neighbors.push_back(v);
+            }
+        }
+        sort(neighbors.begin(), neighbors.end());
+        neighbors.erase(unique(neighbors.begin(), neighbors.end()), neighbors.end());
+        for (unsigned int v : neighbors)
+            version[v]++;
+        for (unsigned int v : neighbors)
+        {
+            pushCollapse(to, v);
+            pushCollapse(v, to);
+            // the neighbor's other edges are stale as well now
+            for (unsigned int t : vertexTriangles[v])
+            {
+                if (!triangleAlive[t])
+                    continue;
+                for (int corner = 0; corner < 3; corner++)
+                {
+                    unsigned int w = triangles[t * 3 + corner];
+                    if (w != v && w != to)
+                    {
+                        pushCollapse(v, w);
+                        pushCollapse(w, v);
+                    }
+                }
+            }
+        }
+    }
+};
+
+#endif
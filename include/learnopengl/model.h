@@ -10,26 +10,52 @@
 #include <assimp/scene.h>
 #include <assimp/postprocess.h>
 
+#include <learnopengl/frustum_culler.h>
+#include <learnopengl/material.h>
 #include <learnopengl/mesh.h>
+#include <learnopengl/mesh_cache.h>
+#include <learnopengl/mesh_optimizer.h>
+#include <learnopengl/render_queue.h>
 #include <learnopengl/shader.h>
+#include <learnopengl/texture_loader.h>
+#include <learnopengl/texture_registry.h>
 
+#include <algorithm>
+#include <memory>
 #include <string>
 #include <fstream>
 #include <sstream>
 #include <iostream>
 #include <map>
+#include <unordered_map>
 #include <vector>
 using namespace std;
 
 unsigned int TextureFromFile(const char *path, const string &directory, bool gamma = true);
 
+// post processing requested from ASSIMP, part of the geometry cache key
+const unsigned int MODEL_IMPORT_FLAGS = aiProcess_Triangulate | aiProcess_GenSmoothNormals | aiProcess_FlipUVs | aiProcess_CalcTangentSpace;
+// how far (in pixels) a simplified mesh may be off on screen before a finer level of detail is used
+const float LOD_MAX_PIXEL_ERROR = 1.0f;
+
+// what LOD selection needs from the camera: where it is and how many pixels one unit at distance 1 covers
+struct LodView {
+    glm::vec3 position;
+    float pixelsPerUnit;
+};
+
+inline LodView MakeLodView(const glm::vec3 &cameraPosition, const glm::mat4 &projection, float viewportHeight)
+{
+    // projection[1][1] is cot(fovy / 2), it maps the view space y/z to [-1, 1]
+    return LodView{cameraPosition, projection[1][1] * viewportHeight * 0.5f};
+}
 
 
 class Model
 {
 public:
     // model data
-    vector<Texture> textures_loaded;	// stores all the textures loaded so far, optimization to make sure textures aren't loaded more than once.
+    unordered_map<string, TextureHandle> textures_loaded;	// textures used by the model, keyed by material path. holds them alive in the TextureRegistry.
     vector<Mesh>    meshes;
     string directory;
     bool gammaCorrection;
@@ -40,63 +66,269 @@ public:
         loadModel(path);
     }
 
+    // empty model, filled in later through Upload (see ModelLoader)
+    Model() : gammaCorrection(true)
+    {
+    }
+
+    // meshes own their space in the geometry arena
+    Model(const Model &) = delete;
+    Model &operator=(const Model &) = delete;
+
+    ~Model()
+    {
+        Release();
+    }
+
     // draws the model, and thus all its meshes
     void Draw(Shader &shader)
     {
-        for(unsigned int i = 0; i < meshes.size(); i++)
-            meshes[i].Draw(shader);
+        visibleMeshes.resize(meshes.size());
+        for (unsigned int i = 0; i < meshes.size(); i++)
+            visibleMeshes[i] = i;
+        drawMeshes(shader, nullptr, 0.0f, nullptr, 0.0f);
+    }
+
+    // draws the meshes whose bounds intersect the culler's frustum, each at the coarsest level of detail whose error
+    // projects to at most maxPixelError pixels. model is the matrix the model is drawn with.
+    void Draw(Shader &shader, const glm::mat4 &model, const LodView &view, FrustumCuller &culler, float maxPixelError = LOD_MAX_PIXEL_ERROR)
+    {
+        cullMeshes(model, culler);
+        drawMeshes(shader, &model, maxAxisScale(model), &view, maxPixelError);
+    }
+
+    // like Draw, but pushes the visible meshes into the queue instead of drawing them. object is the index of the
+    // model's Object block in the ObjectUniformBuffer the queue is submitted with.
+    void Enqueue(RenderQueue &queue, Render_Pass pass, Shader &shader, unsigned int object, const glm::mat4 &model,
+                 const LodView &view, FrustumCuller &culler, float maxPixelError = LOD_MAX_PIXEL_ERROR)
+    {
+        cullMeshes(model, culler);
+        enqueueVisible(queue, pass, shader, object, model, view, maxPixelError);
+    }
+
+    // queues the bounds of the meshes into a culler shared by several models, so its batches hold the meshes of all
+    // of them. once the caller has run Cull, the Enqueue taking the visible list picks this model's part out of it.
+    void AddBounds(FrustumCuller &culler, const glm::mat4 &model)
+    {
+        firstBox = culler.Count();
+        boxCount = (unsigned int) meshes.size();
+        for (const Mesh &mesh : meshes)
+            culler.Add(mesh.boundsMin, mesh.boundsMax, model);
+    }
+
+    // like Enqueue, with the visible boxes from a Cull over the bounds added with AddBounds
+    void Enqueue(RenderQueue &queue, Render_Pass pass, Shader &shader, unsigned int object, const glm::mat4 &model,
+                 const LodView &view, const vector<unsigned int> &visible, float maxPixelError = LOD_MAX_PIXEL_ERROR)
+    {
+        visibleMeshes.clear();
+        // meshes uploaded after AddBounds have no boxes in this cull
+        if (boxCount == meshes.size())
+        {
+            vector<unsigned int>::const_iterator box = std::lower_bound(visible.begin(), visible.end(), firstBox);
+            for (; box != visible.end() && *box < firstBox + boxCount; ++box)
+                visibleMeshes.push_back(*box - firstBox);
+        }
+        enqueueVisible(queue, pass, shader, object, model, view, maxPixelError);
+    }
+
+    // frees the geometry of all meshes, the model is empty afterwards
+    void Release()
+    {
+        for (Mesh &mesh : meshes)
+            mesh.Release();
+        meshes.clear();
+        materials.clear();
     }
 
     void SetShaderTextureNamePrefix(std::string prefix) {
-        for (Mesh& mesh: meshes) {
-            mesh.glslIdentifierPrefix = prefix;
+        glslIdentifierPrefix = prefix;
+        for (auto &material : materials) {
+            material.second->SetSamplerPrefix(prefix);
         }
     }
+
+    // specular exponent of all materials of the model, MATERIAL_DEFAULT_SHININESS unless set
+    void SetShininess(float shininess) {
+        this->shininess = shininess;
+        for (auto &material : materials) {
+            material.second->SetShininess(shininess);
+        }
+    }
+
+    // vertex layout meshes uploaded from now on get, VERTEX_FULL by default.
+    // the packed formats only keep what model_lighting.vs reads.
+    void SetVertexFormat(Vertex_Format format) {
+        vertexFormat = format;
+    }
+
+    // creates the GL objects for already imported meshes, has to be called on the thread owning the GL context.
+    // textures found in images (keyed by the path the material uses) are uploaded as read, the rest is loaded from disk.
+    void Upload(string const &path, vector<MeshData> &meshData, const map<string, TextureSource> *images = nullptr)
+    {
+        // retrieve the directory path of the filepath
+        directory = path.substr(0, path.find_last_of('/'));
+
+        meshes.reserve(meshes.size() + meshData.size());
+        for (MeshData &data : meshData)
+            meshes.push_back(createMesh(data, images));
+    }
+
 private:
+    friend class ModelLoader;
+
+    string glslIdentifierPrefix;
+    float shininess = MATERIAL_DEFAULT_SHININESS;
+    Vertex_Format vertexFormat = VERTEX_FULL;
+    // materials of the meshes, keyed by the textures they reference, so meshes using the same textures share one
+    unordered_map<uint64_t, shared_ptr<Material>> materials;
+    // scratch list of the meshes that survived culling, kept to not allocate every frame
+    vector<unsigned int> visibleMeshes;
+    // where the last AddBounds put the meshes' boxes in the shared culler
+    unsigned int firstBox = 0;
+    unsigned int boxCount = 0;
+
+    // fills visibleMeshes with the meshes whose bounds intersect the culler's frustum
+    void cullMeshes(const glm::mat4 &model, FrustumCuller &culler)
+    {
+        culler.Clear();
+        for (const Mesh &mesh : meshes)
+            culler.Add(mesh.boundsMin, mesh.boundsMax, model);
+        culler.Cull(visibleMeshes);
+    }
+
+    void enqueueVisible(RenderQueue &queue, Render_Pass pass, Shader &shader, unsigned int object, const glm::mat4 &model,
+                        const LodView &view, float maxPixelError)
+    {
+        float scale = maxAxisScale(model);
+        for (unsigned int i : visibleMeshes)
+        {
+            float distance;
+            unsigned int lod = selectLod(meshes[i], model, scale, view, maxPixelError, distance);
+            queue.PushMesh(pass, shader, meshes[i], lod, object, distance);
+        }
+    }
+
+    // draws the meshes listed in visibleMeshes grouped by material and vertex format, so each material is bound
+    // and each arena VAO is switched to once. without a view all meshes are drawn at full detail.
+    void drawMeshes(Shader &shader, const glm::mat4 *model, float scale, const LodView *view, float maxPixelError)
+    {
+        std::sort(visibleMeshes.begin(), visibleMeshes.end(), [this](unsigned int a, unsigned int b) {
+            const Mesh &first = meshes[a], &second = meshes[b];
+            if (first.material != second.material)
+                return first.material < second.material;
+            return first.vertexFormat < second.vertexFormat;
+        });
+        MeshUniforms uniforms(shader);
+        const Material *material = nullptr;
+        unsigned int vao = 0;
+        for (unsigned int i : visibleMeshes)
+        {
+            const Mesh &mesh = meshes[i];
+            if (mesh.material.get() != material)
+            {
+                mesh.BindMaterial(shader);
+                material = mesh.material.get();
+            }
+            if (mesh.VAO != vao)
+            {
+                glBindVertexArray(mesh.VAO);
+                vao = mesh.VAO;
+            }
+            float distance;
+            unsigned int lod = view ? selectLod(mesh, *model, scale, *view, maxPixelError, distance) : 0;
+            mesh.DrawGeometry(uniforms, lod);
+        }
+    }
+
+    // errors are in model units, the largest axis scale converts them to world units
+    static float maxAxisScale(const glm::mat4 &model)
+    {
+        return sqrt(max(glm::dot(glm::vec3(model[0]), glm::vec3(model[0])),
+                    max(glm::dot(glm::vec3(model[1]), glm::vec3(model[1])), glm::dot(glm::vec3(model[2]), glm::vec3(model[2])))));
+    }
+
+    // the coarsest level of detail whose error projects to at most maxPixelError pixels, distance is set to how far
+    // the mesh's bounding sphere is from the camera
+    static unsigned int selectLod(const Mesh &mesh, const glm::mat4 &model, float scale, const LodView &view, float maxPixelError, float &distance)
+    {
+        glm::vec3 center = glm::vec3(model * glm::vec4(mesh.boundsCenter, 1.0f));
+        // distance to the closest point of the bounding sphere, the camera may be inside it
+        distance = max(glm::length(center - view.position) - mesh.boundsRadius * scale, 0.01f);
+        unsigned int lod = 0;
+        while (lod + 1 < mesh.lods.size() && mesh.lods[lod + 1].error * scale * view.pixelsPerUnit / distance <= maxPixelError)
+            lod++;
+        return lod;
+    }
+
     // loads a model with supported ASSIMP extensions from file and stores the resulting meshes in the meshes vector.
+    // the processed geometry is cached next to the model file, so ASSIMP only runs when the cache is missing or stale.
     void loadModel(string const &path)
+    {
+        vector<MeshData> meshData;
+        if (!MeshCache::Load(path, MODEL_IMPORT_FLAGS, meshData))
+        {
+            if (!importModel(path, meshData))
+                return;
+            MeshCache::Store(path, MODEL_IMPORT_FLAGS, meshData);
+        }
+        Upload(path, meshData);
+    }
+
+    // reads the model via ASSIMP and converts all of its meshes
+    static bool importModel(string const &path, vector<MeshData> &meshData)
     {
         // read file via ASSIMP
         Assimp::Importer importer;
-        const aiScene* scene = importer.ReadFile(path, aiProcess_Triangulate | aiProcess_GenSmoothNormals | aiProcess_FlipUVs | aiProcess_CalcTangentSpace);
+        const aiScene* scene = readScene(importer, path);
+        if (!scene)
+            return false;
+
+        vector<aiMesh*> sceneMeshes;
+        collectMeshes(scene->mRootNode, scene, sceneMeshes);
+        MeshOptimizerReport report;
+        for (aiMesh *mesh : sceneMeshes)
+        {
+            meshData.push_back(processMesh(mesh, scene));
+            report += OptimizeMesh(meshData.back());
+        }
+        report.Print(path);
+        return true;
+    }
+
+    static const aiScene* readScene(Assimp::Importer &importer, string const &path)
+    {
+        const aiScene* scene = importer.ReadFile(path, MODEL_IMPORT_FLAGS);
         // check for errors
         if(!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode) // if is Not Zero
         {
             cout << "ERROR::ASSIMP:: " << importer.GetErrorString() << endl;
-            return;
+            return nullptr;
         }
-        // retrieve the directory path of the filepath
-        directory = path.substr(0, path.find_last_of('/'));
-
-        // process ASSIMP's root node recursively
-        processNode(scene->mRootNode, scene);
+        return scene;
     }
 
-    // processes a node in a recursive fashion. Processes each individual mesh located at the node and repeats this process on its children nodes (if any).
-    void processNode(aiNode *node, const aiScene *scene)
+    // walks the nodes in a recursive fashion and collects the meshes located at each node, in drawing order.
+    static void collectMeshes(aiNode *node, const aiScene *scene, vector<aiMesh*> &sceneMeshes)
     {
-        // process each mesh located at the current node
+        // the node object only contains indices to index the actual objects in the scene.
+        // the scene contains all the data, node is just to keep stuff organized (like relations between nodes).
         for(unsigned int i = 0; i < node->mNumMeshes; i++)
-        {
-            // the node object only contains indices to index the actual objects in the scene.
-            // the scene contains all the data, node is just to keep stuff organized (like relations between nodes).
-            aiMesh* mesh = scene->mMeshes[node->mMeshes[i]];
-            meshes.push_back(processMesh(mesh, scene));
-        }
-        // after we've processed all of the meshes (if any) we then recursively process each of the children nodes
+            sceneMeshes.push_back(scene->mMeshes[node->mMeshes[i]]);
+        // after we've collected all of the meshes (if any) we then recursively process each of the children nodes
         for(unsigned int i = 0; i < node->mNumChildren; i++)
-        {
-            processNode(node->mChildren[i], scene);
-        }
-
+            collectMeshes(node->mChildren[i], scene, sceneMeshes);
     }
 
-    Mesh processMesh(aiMesh *mesh, const aiScene *scene)
+    static MeshData processMesh(aiMesh *mesh, const aiScene *scene)
     {
         // data to fill
-        vector<Vertex> vertices;
-        vector<unsigned int> indices;
-        vector<Texture> textures;
+        MeshData data;
+        vector<Vertex> &vertices = data.vertices;
+        vector<unsigned int> &indices = data.indices;
+        vector<TextureRef> &textures = data.textures;
+
+        vertices.reserve(mesh->mNumVertices);
+        indices.reserve(mesh->mNumFaces * 3);
 
         // walk through each of the mesh's vertices
         for(unsigned int i = 0; i < mesh->mNumVertices; i++)
@@ -116,6 +348,8 @@ private:
                 vector.z = mesh->mNormals[i].z;
                 vertex.Normal = vector;
             }
+            else
+                vertex.Normal = glm::vec3(0.0f);
             // texture coordinates
             if(mesh->mTextureCoords[0]) // does the mesh contain texture coordinates?
             {
@@ -137,7 +371,12 @@ private:
                 vertex.Bitangent = vector;
             }
             else
+            {
                 vertex.TexCoords = glm::vec2(0.0f, 0.0f);
+                // vertices are welded by their bytes, so nothing may be left uninitialized
+                vertex.Tangent = glm::vec3(0.0f);
+                vertex.Bitangent = glm::vec3(0.0f);
+            }
 
             vertices.push_back(vertex);
 
@@ -151,6 +390,7 @@ private:
             for(unsigned int j = 0; j < face.mNumIndices; j++)
                 indices.push_back(face.mIndices[j]);
         }
+        ComputeBounds(data);
         // process materials
         aiMaterial* material = scene->mMaterials[mesh->mMaterialIndex];
         // we assume a convention for sampler names in the shaders. Each diffuse texture should be named
@@ -164,55 +404,81 @@ private:
 
 
         // 1. diffuse maps
-        vector<Texture> diffuseMaps = loadMaterialTextures(material, aiTextureType_DIFFUSE, "texture_diffuse");
-        textures.insert(textures.end(), diffuseMaps.begin(), diffuseMaps.end());
+        collectMaterialTextures(material, aiTextureType_DIFFUSE, "texture_diffuse", textures);
         // 2. specular maps
-        vector<Texture> specularMaps = loadMaterialTextures(material, aiTextureType_SPECULAR, "texture_specular");
-        textures.insert(textures.end(), specularMaps.begin(), specularMaps.end());
+        collectMaterialTextures(material, aiTextureType_SPECULAR, "texture_specular", textures);
         // 3. normal maps
-        std::vector<Texture> normalMaps = loadMaterialTextures(material, aiTextureType_HEIGHT, "texture_normal");
-        textures.insert(textures.end(), normalMaps.begin(), normalMaps.end());
+        collectMaterialTextures(material, aiTextureType_HEIGHT, "texture_normal", textures);
         // 4. height maps
-        std::vector<Texture> heightMaps = loadMaterialTextures(material, aiTextureType_AMBIENT, "texture_height");
-        textures.insert(textures.end(), heightMaps.begin(), heightMaps.end());
+        collectMaterialTextures(material, aiTextureType_AMBIENT, "texture_height", textures);
 
-
-
-        // return a mesh object created from the extracted mesh data
-        return Mesh(vertices, indices, textures);
+        return data;
     }
 
-    // checks all material textures of a given type and loads the textures if they're not loaded yet.
-    // the required info is returned as a Texture struct.
-    vector<Texture> loadMaterialTextures(aiMaterial *mat, aiTextureType type, string typeName)
+    // appends references to all material textures of a given type
+    static void collectMaterialTextures(aiMaterial *mat, aiTextureType type, string typeName, vector<TextureRef> &textures)
     {
-        vector<Texture> textures;
         for(unsigned int i = 0; i < mat->GetTextureCount(type); i++)
         {
             aiString str;
             mat->GetTexture(type, i, &str);
-            // check if texture was loaded before and if so, continue to next iteration: skip loading a new texture
-            bool skip = false;
-            for(unsigned int j = 0; j < textures_loaded.size(); j++)
-            {
-                if(std::strcmp(textures_loaded[j].path.data(), str.C_Str()) == 0)
-                {
-                    textures.push_back(textures_loaded[j]);
-                    skip = true; // a texture with the same filepath has already been loaded, continue to next one. (optimization)
-                    break;
-                }
-            }
-            if(!skip)
-            {   // if texture hasn't been loaded already, load it
-                Texture texture;
-                texture.id = TextureFromFile(str.C_Str(), this->directory);
-                texture.type = typeName;
-                texture.path = str.C_Str();
-                textures.push_back(texture);
-                textures_loaded.push_back(texture);  // store it as texture loaded for entire model, to ensure we won't unnecesery load duplicate textures.
-            }
+            textures.push_back(TextureRef{typeName, str.C_Str()});
+        }
+    }
+
+    // creates the GL side mesh with the material of its textures
+    Mesh createMesh(MeshData &data, const map<string, TextureSource> *images)
+    {
+        Mesh mesh(std::move(data.vertices), std::move(data.indices), findMaterial(data.textures, images), vertexFormat);
+        mesh.lods = std::move(data.lods);
+        mesh.boundsMin = data.boundsMin;
+        mesh.boundsMax = data.boundsMax;
+        mesh.boundsCenter = data.boundsCenter;
+        mesh.boundsRadius = data.boundsRadius;
+        return mesh;
+    }
+
+    // the model's material for these textures, made (loading the textures) the first time a mesh references them
+    shared_ptr<Material> findMaterial(const vector<TextureRef> &refs, const map<string, TextureSource> *images)
+    {
+        uint64_t key = FNV_OFFSET_BASIS;
+        for (const TextureRef &ref : refs)
+        {
+            key = HashBytes(ref.type.c_str(), ref.type.size() + 1, key);
+            key = HashBytes(ref.path.c_str(), ref.path.size() + 1, key);
         }
-        return textures;
+        shared_ptr<Material> &material = materials[key];
+        if (!material)
+        {
+            vector<Texture> textures;
+            for (const TextureRef &ref : refs)
+                textures.push_back(loadMaterialTexture(ref, images));
+            material = make_shared<Material>(textures, glslIdentifierPrefix);
+            material->SetShininess(shininess);
+        }
+        return material;
+    }
+
+    // looks the texture up in the model first and then in the global registry, which only loads it if it's not resident yet.
+    // the required info is returned as a Texture struct.
+    Texture loadMaterialTexture(const TextureRef &ref, const map<string, TextureSource> *images)
+    {
+        unordered_map<string, TextureHandle>::iterator loaded = textures_loaded.find(ref.path);
+        if (loaded == textures_loaded.end())
+        {
+            const TextureSource *prepared = nullptr;
+            map<string, TextureSource>::const_iterator found;
+            if (images && (found = images->find(ref.path)) != images->end())
+                prepared = &found->second;
+            TextureHandle handle = TextureRegistry::Instance().Get2D(this->directory + '/' + ref.path, prepared);
+            loaded = textures_loaded.emplace(ref.path, handle).first;
+        }
+
+        Texture texture;
+        texture.id = loaded->second.ID();
+        texture.type = ref.type;
+        texture.path = ref.path;
+        return texture;
     }
 };
 
@@ -222,38 +488,10 @@ unsigned int TextureFromFile(const char *path, const string &directory, bool gam
     string filename = string(path);
     filename = directory + '/' + filename;
 
-    unsigned int textureID;
-    glGenTextures(1, &textureID);
-
-    int width, height, nrComponents;
-    unsigned char *data = stbi_load(filename.c_str(), &width, &height, &nrComponents, 0);
-    if (data)
-    {
-        GLenum format;
-        if (nrComponents == 1)
-            format = GL_RED;
-        else if (nrComponents == 3)
-            format = GL_RGB;
-        else if (nrComponents == 4)
-            format = GL_RGBA;
-
-        glBindTexture(GL_TEXTURE_2D, textureID);
-        glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
-        glGenerateMipmap(GL_TEXTURE_2D);
-
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-        stbi_image_free(data);
-    }
-    else
-    {
+    Image image = DecodeImage(filename);
+    if (!image.Valid())
         std::cout << "Texture failed to load at path: " << path << std::endl;
-        stbi_image_free(data);
-    }
 
-    return textureID;
+    return CreateTexture2D(image);
 }
 #endif
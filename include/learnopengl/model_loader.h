@@ -0,0 +1,235 @@
+#ifndef MODEL_LOADER_H
+#define MODEL_LOADER_H
+
+#include <learnopengl/model.h>
+#include <learnopengl/thread_pool.h>
+
+#include <atomic>
+#include <deque>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+using namespace std;
+
+// Handle to a model that is being loaded in the background.
+// The model itself exists right away (empty, so drawing it is a no-op) and gets its meshes
+// once the loader finishes it on the render thread.
+class AsyncModel
+{
+public:
+    AsyncModel() {}
+
+    bool Ready() const
+    {
+        return state && state->ready;
+    }
+
+    Model &Get()
+    {
+        return state->model;
+    }
+
+    Model *operator->()
+    {
+        return &state->model;
+    }
+
+private:
+    friend class ModelLoader;
+
+    struct State {
+        Model model;
+        bool ready = false;
+    };
+    shared_ptr<State> state;
+};
+
+// Loads models on a thread pool: ASSIMP parsing (or reading the geometry cache), per mesh
+// processing and optimization, and reading cooked textures or decoding the source images run on the workers, and only the GL object creation is
+// handed back to the render thread through a completion queue drained by ProcessCompleted.
+class ModelLoader
+{
+public:
+    explicit ModelLoader(ThreadPool &pool) : pool(pool), completed(make_shared<CompletionQueue>())
+    {
+        // the workers check cooked textures against it, the query itself needs the GL thread
+        GetCompressedFormatSupport();
+    }
+
+    AsyncModel Load(string const &path)
+    {
+        AsyncModel handle;
+        handle.state = make_shared<AsyncModel::State>();
+
+        shared_ptr<Job> job = make_shared<Job>();
+        job->path = path;
+        job->target = handle.state;
+        job->completed = completed;
+        {
+            lock_guard<mutex> lock(completed->mutex);
+            completed->pending++;
+        }
+        ThreadPool *workers = &pool;
+        pool.Enqueue([workers, job]() { importModel(*workers, job); });
+        return handle;
+    }
+
+    // creates the GL objects of finished models, at most maxCount of them (0 means all).
+    // has to be called on the thread owning the GL context; returns the number of models finished.
+    unsigned int ProcessCompleted(unsigned int maxCount = 0)
+    {
+        unsigned int count = 0;
+        while (maxCount == 0 || count < maxCount)
+        {
+            shared_ptr<Job> job;
+            {
+                lock_guard<mutex> lock(completed->mutex);
+                if (completed->jobs.empty())
+                    break;
+                job = completed->jobs.front();
+                completed->jobs.pop_front();
+                completed->pending--;
+            }
+            shared_ptr<AsyncModel::State> target = job->target.lock();
+            if (target)
+            {
+                target->model.Upload(job->path, job->meshData, &job->images);
+                target->ready = true;
+            }
+            count++;
+        }
+        return count;
+    }
+
+    // true when there are no models left in flight
+    bool Idle() const
+    {
+        lock_guard<mutex> lock(completed->mutex);
+        return completed->pending == 0;
+    }
+
+private:
+    struct Job;
+
+    // shared with the jobs, so workers can still finish after the loader is gone
+    struct CompletionQueue {
+        mutable std::mutex mutex;
+        deque<shared_ptr<Job>> jobs;
+        unsigned int pending = 0;
+    };
+
+    struct Job {
+        string path;
+        weak_ptr<AsyncModel::State> target;
+        shared_ptr<CompletionQueue> completed;
+
+        vector<MeshData> meshData;
+        // textures read on the workers, keyed by the path used in the materials
+        map<string, TextureSource> images;
+        atomic<unsigned int> texturesLeft{0};
+        // kept alive while the meshes of the scene are being processed
+        shared_ptr<Assimp::Importer> importer;
+        const aiScene *scene = nullptr;
+        atomic<unsigned int> meshesLeft{0};
+        vector<MeshOptimizerReport> reports;
+    };
+
+    ThreadPool &pool;
+    shared_ptr<CompletionQueue> completed;
+
+    static void finish(const shared_ptr<Job> &job)
+    {
+        job->importer.reset();
+        job->scene = nullptr;
+        lock_guard<mutex> lock(job->completed->mutex);
+        job->completed->jobs.push_back(job);
+    }
+
+    // worker side: either reads the geometry cache or parses the file and fans out one job per mesh
+    static void importModel(ThreadPool &pool, const shared_ptr<Job> &job)
+    {
+        if (MeshCache::Load(job->path, MODEL_IMPORT_FLAGS, job->meshData))
+        {
+            decodeTextures(pool, job);
+            return;
+        }
+
+        job->importer = make_shared<Assimp::Importer>();
+        job->scene = Model::readScene(*job->importer, job->path);
+        if (!job->scene)
+        {
+            finish(job);
+            return;
+        }
+
+        vector<aiMesh*> sceneMeshes;
+        Model::collectMeshes(job->scene->mRootNode, job->scene, sceneMeshes);
+        if (sceneMeshes.empty())
+        {
+            finish(job);
+            return;
+        }
+
+        job->meshData.resize(sceneMeshes.size());
+        job->reports.resize(sceneMeshes.size());
+        job->meshesLeft = (unsigned int) sceneMeshes.size();
+        for (unsigned int i = 0; i < sceneMeshes.size(); i++)
+        {
+            aiMesh *mesh = sceneMeshes[i];
+            ThreadPool *workers = &pool;
+            pool.Enqueue([workers, job, mesh, i]() {
+                job->meshData[i] = Model::processMesh(mesh, job->scene);
+                job->reports[i] = OptimizeMesh(job->meshData[i]);
+                // the last mesh to finish stores the cache and moves on to the textures
+                if (--job->meshesLeft == 0)
+                {
+                    job->importer.reset();
+                    job->scene = nullptr;
+                    MeshOptimizerReport report;
+                    for (const MeshOptimizerReport &meshReport : job->reports)
+                        report += meshReport;
+                    report.Print(job->path);
+                    MeshCache::Store(job->path, MODEL_IMPORT_FLAGS, job->meshData);
+                    decodeTextures(*workers, job);
+                }
+            });
+        }
+    }
+
+    // fans out one read job per distinct texture of the model that isn't resident yet, the last one hands the model over
+    static void decodeTextures(ThreadPool &pool, const shared_ptr<Job> &job)
+    {
+        string directory = job->path.substr(0, job->path.find_last_of('/'));
+        for (const MeshData &mesh : job->meshData)
+        {
+            for (const TextureRef &texture : mesh.textures)
+            {
+                if (!job->images.count(texture.path) && !TextureRegistry::Instance().Contains(directory + '/' + texture.path))
+                    job->images[texture.path];
+            }
+        }
+        if (job->images.empty())
+        {
+            finish(job);
+            return;
+        }
+
+        job->texturesLeft = (unsigned int) job->images.size();
+        for (map<string, TextureSource>::value_type &entry : job->images)
+        {
+            TextureSource *source = &entry.second;
+            string filename = directory + '/' + entry.first;
+            pool.Enqueue([job, source, filename]() {
+                // the cooked file if it's usable, the decoded source if not: the GL thread only creates the texture
+                *source = TextureRegistry::Instance().Read(filename);
+                if (--job->texturesLeft == 0)
+                    finish(job);
+            });
+        }
+    }
+};
+
+#endif
@@ -0,0 +1,575 @@
+#ifndef RENDER_GRAPH_H
+#define RENDER_GRAPH_H
+
+#include <glad/glad.h>
+
+#include <glm/glm.hpp>
+
+#include <learnopengl/gpu_profiler.h>
+#include <learnopengl/hash.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <functional>
+#include <iostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+using namespace std;
+
+// a texture of the graph, valid for the frame it was declared in
+typedef unsigned int RenderResource;
+const RenderResource RENDER_RESOURCE_NONE = ~0u;
+
+// size of a transient texture relative to the frame (or fixed, when width and height are set), and its format.
+// depth formats become depth attachments. with dynamicResolution the passes only render to the render scale
+// part of it (see RenderGraph::Begin).
+struct RenderTextureDesc {
+    GLenum format = GL_RGBA16F;
+    float scale = 1.0f;
+    unsigned int width = 0, height = 0;
+    GLenum filter = GL_LINEAR;
+    bool dynamicResolution = true;
+};
+
+struct RenderGraphStats {
+    unsigned int passes = 0;
+    unsigned int culledPasses = 0;
+    // textures the passes declared, and the pooled ones that backed them
+    unsigned int textures = 0;
+    unsigned int pooledTextures = 0;
+    size_t pooledBytes = 0;
+};
+
+class RenderGraph;
+
+// declares what a pass reads and writes, returned by RenderGraph::AddPass
+class RenderPassBuilder
+{
+public:
+    RenderPassBuilder(RenderGraph &graph, unsigned int pass) : graph(graph), pass(pass)
+    {
+    }
+
+    // the pass samples the texture
+    RenderPassBuilder &Read(RenderResource resource);
+    // the pass renders into the texture. the first pass to write a texture gets it cleared (color 0, depth 1),
+    // later ones render onto what is there.
+    RenderPassBuilder &Write(RenderResource resource);
+    // the pass does something besides writing its targets (reads back, draws UI), it is never culled
+    RenderPassBuilder &SideEffect();
+
+private:
+    RenderGraph &graph;
+    unsigned int pass;
+};
+
+// The frame as passes that declare the textures they read and write. A frame is declared anew every frame:
+// Begin, CreateTexture / ImportBackbuffer and AddPass, then Execute, which
+//   - culls the passes nothing consumes: a pass runs if it writes the backbuffer, has a side effect, or writes
+//     a texture a running pass reads after it,
+//   - runs the rest in declaration order (a pass can only read what earlier passes wrote, so that order already
+//     satisfies every dependency),
+//   - backs the textures with pooled GL textures. A pooled texture is handed to the next texture with the same
+//     format and size once the last pass using the previous one ran, so textures whose lifetimes don't overlap
+//     share memory. Pooled textures no frame used are deleted, which is all a resize takes,
+//   - binds a framebuffer with the targets of every pass (cached per set of textures) and sets the viewport.
+// Textures are allocated at the frame size, a render scale below 1 only shrinks the viewport of the passes to the
+// lower left part of them, so the scale can change every frame without reallocating anything.
+class RenderGraph
+{
+public:
+    RenderGraph() = default;
+    RenderGraph(const RenderGraph &) = delete;
+    RenderGraph &operator=(const RenderGraph &) = delete;
+
+    ~RenderGraph()
+    {
+        Release();
+    }
+
+    // starts declaring a frame of width x height, the size scaled textures are relative to. passes render
+    // renderScale of the width and height of dynamic resolution textures.
+    void Begin(unsigned int width, unsigned int height, float renderScale = 1.0f)
+    {
+        frameWidth = std::max(width, 1u);
+        frameHeight = std::max(height, 1u);
+        this->renderScale = std::min(std::max(renderScale, 0.0f), 1.0f);
+        passes.clear();
+        resources.clear();
+    }
+
+    RenderResource CreateTexture(const string &name, const RenderTextureDesc &desc)
+    {
+        Resource resource;
+        resource.name = name;
+        resource.desc = desc;
+        if (isDepthFormat(desc.format))
+            resource.desc.filter = GL_NEAREST;
+        resource.width = desc.width ? desc.width : std::max((unsigned int) (frameWidth * desc.scale), 1u);
+        resource.height = desc.height ? desc.height : std::max((unsigned int) (frameHeight * desc.scale), 1u);
+        float viewportScale = desc.dynamicResolution ? renderScale : 1.0f;
+        resource.viewportWidth = std::max((unsigned int) std::ceil(resource.width * viewportScale), 1u);
+        resource.viewportHeight = std::max((unsigned int) std::ceil(resource.height * viewportScale), 1u);
+        resources.push_back(resource);
+        return (RenderResource) resources.size() - 1;
+    }
+
+    // the default framebuffer, what the frame is for: passes writing it are never culled
+    RenderResource ImportBackbuffer()
+    {
+        Resource resource;
+        resource.name = "backbuffer";
+        resource.backbuffer = true;
+        resource.width = resource.viewportWidth = frameWidth;
+        resource.height = resource.viewportHeight = frameHeight;
+        resources.push_back(resource);
+        return (RenderResource) resources.size() - 1;
+    }
+
+    // execute runs with the pass's framebuffer bound and the viewport set to its targets
+    RenderPassBuilder AddPass(const string &name, function<void(RenderGraph &)> execute)
+    {
+        Pass pass;
+        pass.name = name;
+        pass.execute = std::move(execute);
+        passes.push_back(std::move(pass));
+        return RenderPassBuilder(*this, (unsigned int) passes.size() - 1);
+    }
+
+    // GL texture behind a resource, for the execute functions of the passes that read it
+    unsigned int Texture(RenderResource resource) const
+    {
+        return resource < resources.size() ? resources[resource].texture : 0;
+    }
+
+    unsigned int Width(RenderResource resource) const
+    {
+        return resources[resource].width;
+    }
+
+    unsigned int Height(RenderResource resource) const
+    {
+        return resources[resource].height;
+    }
+
+    // part of the texture the passes render to
+    unsigned int ViewportWidth(RenderResource resource) const
+    {
+        return resources[resource].viewportWidth;
+    }
+
+    unsigned int ViewportHeight(RenderResource resource) const
+    {
+        return resources[resource].viewportHeight;
+    }
+
+    // for sampling the rendered part of a texture with coordinates 0..1 over it: xy scales the coordinates,
+    // zw is the furthest they may go without bilinear filtering reaching texels outside of it
+    glm::vec4 Region(RenderResource resource) const
+    {
+        const Resource &r = resources[resource];
+        return glm::vec4((float) r.viewportWidth / r.width, (float) r.viewportHeight / r.height,
+                         (r.viewportWidth - 0.5f) / r.width, (r.viewportHeight - 0.5f) / r.height);
+    }
+
+    // culls, allocates and runs the passes. leaves the default framebuffer bound with the full viewport.
+    void Execute()
+    {
+        stats = RenderGraphStats();
+        stats.passes = (unsigned int) passes.size();
+        stats.textures = (unsigned int) std::count_if(resources.begin(), resources.end(),
+                                                      [](const Resource &resource) { return !resource.backbuffer; });
+        cull();
+        allocate();
+
+        for (size_t i = 0; i < passes.size(); i++)
+        {
+            Pass &pass = passes[i];
+            if (pass.culled)
+                continue;
+            if (profiler)
+                profiler->BeginScope(pass.name);
+            beginPass((int) i);
+            pass.execute(*this);
+            if (profiler)
+                profiler->EndScope();
+        }
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        glViewport(0, 0, frameWidth, frameHeight);
+
+        releaseUnused();
+        stats.pooledTextures = (unsigned int) pool.size();
+        for (const PooledTexture &texture : pool)
+            stats.pooledBytes += (size_t) texture.width * texture.height * bytesPerTexel(texture.format);
+    }
+
+    // times every pass that runs as a scope of the profiler, nullptr to stop
+    void SetProfiler(GpuProfiler *gpuProfiler)
+    {
+        profiler = gpuProfiler;
+    }
+
+    const RenderGraphStats &Stats() const
+    {
+        return stats;
+    }
+
+    // names of the passes that ran last frame, in order
+    vector<string> ExecutedPasses() const
+    {
+        vector<string> names;
+        for (const Pass &pass : passes)
+            if (!pass.culled)
+                names.push_back(pass.name);
+        return names;
+    }
+
+    // deletes the pooled textures and framebuffers, has to happen while the context is still alive
+    void Release()
+    {
+        for (const auto &framebuffer : framebuffers)
+            glDeleteFramebuffers(1, &framebuffer.second.fbo);
+        framebuffers.clear();
+        for (const PooledTexture &texture : pool)
+            glDeleteTextures(1, &texture.id);
+        pool.clear();
+    }
+
+private:
+    friend class RenderPassBuilder;
+
+    struct Resource {
+        string name;
+        RenderTextureDesc desc;
+        unsigned int width = 0, height = 0;
+        unsigned int viewportWidth = 0, viewportHeight = 0;
+        bool backbuffer = false;
+        // index of the first pass writing it, set while declaring
+        int firstWriter = -1;
+        // passes using it among the ones that run (the first of them writing it clears it), and the pooled
+        // texture backing it
+        int firstUse = -1, lastUse = -1, clearedBy = -1;
+        int pooled = -1;
+        unsigned int texture = 0;
+    };
+
+    struct Pass {
+        string name;
+        function<void(RenderGraph &)> execute;
+        vector<RenderResource> reads;
+        vector<RenderResource> writes;
+        bool sideEffect = false;
+        bool culled = false;
+    };
+
+    struct PooledTexture {
+        unsigned int id;
+        GLenum format;
+        unsigned int width, height;
+        GLenum filter;
+        // pass index from which it is free in the current frame, -1 when free from the start
+        int freeFrom;
+        bool used;
+    };
+
+    struct Framebuffer {
+        unsigned int fbo;
+        vector<unsigned int> textures;
+    };
+
+    unsigned int frameWidth = 1, frameHeight = 1;
+    float renderScale = 1.0f;
+    vector<Resource> resources;
+    vector<Pass> passes;
+    vector<PooledTexture> pool;
+    // framebuffers by the hash of their attachments
+    unordered_map<uint64_t, Framebuffer> framebuffers;
+    RenderGraphStats stats;
+    GpuProfiler *profiler = nullptr;
+
+    static bool isDepthFormat(GLenum format)
+    {
+        return format == GL_DEPTH_COMPONENT16 || format == GL_DEPTH_COMPONENT24 || format == GL_DEPTH_COMPONENT32F;
+    }
+
+    static size_t bytesPerTexel(GLenum format)
+    {
+        switch (format)
+        {
+            case GL_RGBA32F: return 16;
+            case GL_RGBA16F: return 8;
+            case GL_DEPTH_COMPONENT16: return 2;
+            case GL_R16F: return 2;
+            case GL_R8: return 1;
+            default: return 4;
+        }
+    }
+
+    void addRead(unsigned int pass, RenderResource resource)
+    {
+        if (resource >= resources.size())
+            return;
+        if (resources[resource].firstWriter < 0)
+            std::cout << "ERROR::RENDER_GRAPH:: pass " << passes[pass].name << " reads " << resources[resource].name
+                      << " before any pass writes it" << std::endl;
+        passes[pass].reads.push_back(resource);
+    }
+
+    void addWrite(unsigned int pass, RenderResource resource)
+    {
+        if (resource >= resources.size())
+            return;
+        if (resources[resource].firstWriter < 0)
+            resources[resource].firstWriter = (int) pass;
+        passes[pass].writes.push_back(resource);
+    }
+
+    // walks the passes backwards from the backbuffer: a pass runs when something after it needs what it writes,
+    // then what it reads is needed too. written textures stay needed, passes render onto earlier contents.
+    void cull()
+    {
+        vector<bool> needed(resources.size(), false);
+        for (size_t i = 0; i < resources.size(); i++)
+            needed[i] = resources[i].backbuffer;
+        for (size_t i = passes.size(); i-- > 0;)
+        {
+            Pass &pass = passes[i];
+            bool live = pass.sideEffect;
+            for (RenderResource resource : pass.writes)
+                live = live || needed[resource];
+            pass.culled = !live;
+            if (pass.culled)
+            {
+                stats.culledPasses++;
+                continue;
+            }
+            for (RenderResource resource : pass.reads)
+                needed[resource] = true;
+        }
+    }
+
+    // lifetimes over the passes that run, then pooled textures assigned in pass order
+    void allocate()
+    {
+        for (size_t i = 0; i < passes.size(); i++)
+        {
+            if (passes[i].culled)
+                continue;
+            auto use = [&](RenderResource resource) {
+                Resource &r = resources[resource];
+                if (r.firstUse < 0)
+                    r.firstUse = (int) i;
+                r.lastUse = (int) i;
+            };
+            for (RenderResource resource : passes[i].reads)
+                use(resource);
+            for (RenderResource resource : passes[i].writes)
+            {
+                use(resource);
+                if (resources[resource].clearedBy < 0)
+                    resources[resource].clearedBy = (int) i;
+            }
+        }
+
+        for (PooledTexture &texture : pool)
+        {
+            texture.freeFrom = -1;
+            texture.used = false;
+        }
+        for (size_t i = 0; i < passes.size(); i++)
+        {
+            for (Resource &resource : resources)
+                if (resource.firstUse == (int) i && !resource.backbuffer)
+                    acquire(resource, (int) i);
+            // what this pass used last can back textures from the next pass on
+            for (Resource &resource : resources)
+                if (resource.lastUse == (int) i && resource.pooled >= 0)
+                    pool[resource.pooled].freeFrom = (int) i + 1;
+        }
+    }
+
+    void acquire(Resource &resource, int pass)
+    {
+        for (size_t i = 0; i < pool.size(); i++)
+        {
+            PooledTexture &texture = pool[i];
+            bool free = texture.freeFrom >= 0 ? texture.freeFrom <= pass : !texture.used;
+            if (free && texture.format == resource.desc.format && texture.width == resource.width &&
+                texture.height == resource.height && texture.filter == resource.desc.filter)
+            {
+                bind(resource, (int) i);
+                return;
+            }
+        }
+        PooledTexture texture;
+        texture.format = resource.desc.format;
+        texture.width = resource.width;
+        texture.height = resource.height;
+        texture.filter = resource.desc.filter;
+        texture.freeFrom = -1;
+        texture.used = false;
+        glGenTextures(1, &texture.id);
+        glBindTexture(GL_TEXTURE_2D, texture.id);
+        bool depth = isDepthFormat(texture.format);
+        GLenum dataFormat = depth ? GL_DEPTH_COMPONENT : GL_RGBA;
+        if (texture.format == GL_R11F_G11F_B10F)
+            dataFormat = GL_RGB;
+        else if (texture.format == GL_R32F || texture.format == GL_R16F || texture.format == GL_R8)
+            dataFormat = GL_RED;
+        glTexImage2D(GL_TEXTURE_2D, 0, texture.format, texture.width, texture.height, 0, dataFormat, GL_FLOAT, NULL);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, texture.filter);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, texture.filter);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glBindTexture(GL_TEXTURE_2D, 0);
+        pool.push_back(texture);
+        bind(resource, (int) pool.size() - 1);
+    }
+
+    void bind(Resource &resource, int pooled)
+    {
+        pool[pooled].used = true;
+        // taken until the resource's last pass releases it
+        pool[pooled].freeFrom = -1;
+        resource.pooled = pooled;
+        resource.texture = pool[pooled].id;
+    }
+
+    // binds the pass's targets, clears the ones it writes first and sets the viewport to their size
+    void beginPass(int passIndex)
+    {
+        const Pass &pass = passes[passIndex];
+        if (pass.writes.empty())
+            return;
+        const Resource &first = resources[pass.writes[0]];
+        if (first.backbuffer)
+            glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        else
+            glBindFramebuffer(GL_FRAMEBUFFER, framebuffer(pass));
+        glViewport(0, 0, first.viewportWidth, first.viewportHeight);
+
+        // clears are limited to the rendered part, the rest of the texture is never sampled
+        glScissor(0, 0, first.viewportWidth, first.viewportHeight);
+        glEnable(GL_SCISSOR_TEST);
+        const float black[4] = {0.0f, 0.0f, 0.0f, 1.0f};
+        const float farDepth = 1.0f;
+        int colorIndex = 0;
+        for (RenderResource index : pass.writes)
+        {
+            const Resource &resource = resources[index];
+            bool depth = !resource.backbuffer && isDepthFormat(resource.desc.format);
+            bool clear = resource.clearedBy == passIndex;
+            if (resource.viewportWidth != first.viewportWidth || resource.viewportHeight != first.viewportHeight)
+                std::cout << "ERROR::RENDER_GRAPH:: targets of pass " << pass.name << " differ in size" << std::endl;
+            if (clear && (depth || resource.backbuffer))
+            {
+                glDepthMask(GL_TRUE);
+                glClearBufferfv(GL_DEPTH, 0, &farDepth);
+            }
+            if (clear && !depth)
+                glClearBufferfv(GL_COLOR, colorIndex, black);
+            if (!depth)
+                colorIndex++;
+        }
+        glDisable(GL_SCISSOR_TEST);
+    }
+
+    // framebuffer with the pass's color targets in the order it wrote them, and its depth target
+    unsigned int framebuffer(const Pass &pass)
+    {
+        vector<unsigned int> colors;
+        unsigned int depth = 0;
+        for (RenderResource index : pass.writes)
+        {
+            if (isDepthFormat(resources[index].desc.format))
+                depth = resources[index].texture;
+            else
+                colors.push_back(resources[index].texture);
+        }
+        vector<unsigned int> textures = colors;
+        textures.push_back(depth);
+        uint64_t key = HashBytes(textures.data(), textures.size() * sizeof(unsigned int));
+        auto found = framebuffers.find(key);
+        if (found != framebuffers.end() && found->second.textures == textures)
+            return found->second.fbo;
+        if (found != framebuffers.end())
+            glDeleteFramebuffers(1, &found->second.fbo);
+
+        Framebuffer framebuffer;
+        framebuffer.textures = textures;
+        glGenFramebuffers(1, &framebuffer.fbo);
+        glBindFramebuffer(GL_FRAMEBUFFER, framebuffer.fbo);
+        vector<GLenum> attachments;
+        for (size_t i = 0; i < colors.size(); i++)
+        {
+            glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0 + i, GL_TEXTURE_2D, colors[i], 0);
+            attachments.push_back(GL_COLOR_ATTACHMENT0 + i);
+        }
+        if (depth)
+            glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, depth, 0);
+        if (attachments.empty())
+            glDrawBuffer(GL_NONE);
+        else
+            glDrawBuffers((GLsizei) attachments.size(), attachments.data());
+        if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+            std::cout << "ERROR::RENDER_GRAPH:: framebuffer of pass " << pass.name << " not complete" << std::endl;
+        framebuffers[key] = framebuffer;
+        return framebuffer.fbo;
+    }
+
+    // deletes the pooled textures this frame didn't use, and the framebuffers they were attached to
+    void releaseUnused()
+    {
+        vector<unsigned int> deleted;
+        vector<PooledTexture> kept;
+        for (const PooledTexture &texture : pool)
+        {
+            if (texture.used)
+                kept.push_back(texture);
+            else
+                deleted.push_back(texture.id);
+        }
+        if (deleted.empty())
+            return;
+        for (auto it = framebuffers.begin(); it != framebuffers.end();)
+        {
+            bool stale = false;
+            for (unsigned int id : it->second.textures)
+                stale = stale || std::find(deleted.begin(), deleted.end(), id) != deleted.end();
+            if (stale)
+            {
+                glDeleteFramebuffers(1, &it->second.fbo);
+                it = framebuffers.erase(it);
+            }
+            else
+                ++it;
+        }
+        glDeleteTextures((GLsizei) deleted.size(), deleted.data());
+        pool = kept;
+        // the resources of this frame point into the old pool
+        for (Resource &resource : resources)
+            resource.pooled = -1;
+    }
+};
+
+inline RenderPassBuilder &RenderPassBuilder::Read(RenderResource resource)
+{
+    graph.addRead(pass, resource);
+    return *this;
+}
+
+inline RenderPassBuilder &RenderPassBuilder::Write(RenderResource resource)
+{
+    graph.addWrite(pass, resource);
+    return *this;
+}
+
+inline RenderPassBuilder &RenderPassBuilder::SideEffect()
+{
+    graph.passes[pass].sideEffect = true;
+    return *this;
+}
+
+#endif
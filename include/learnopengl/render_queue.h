@@ -0,0 +1,273 @@
+#ifndef RENDER_QUEUE_H
+#define RENDER_QUEUE_H
+
+#include <glad/glad.h>
+
+#include <learnopengl/mesh.h>
+#include <learnopengl/shader.h>
+#include <learnopengl/uniform_buffers.h>
+
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <unordered_map>
+#include <vector>
+using namespace std;
+
+// passes run in this order. depth items only lay down depth (from the position stream, without a material),
+// cutout items are alpha tested (discard, no blending), the sky fills what's left after the geometry and
+// blended items come last, back to front.
+enum Render_Pass {
+    RENDER_PASS_DEPTH,
+    RENDER_PASS_OPAQUE,
+    RENDER_PASS_CUTOUT,
+    RENDER_PASS_SKY,
+    RENDER_PASS_BLENDED
+};
+
+// how many state changes a Submit made, compared to the number of items
+struct RenderQueueStats {
+    unsigned int items = 0;
+    unsigned int programChanges = 0;
+    unsigned int materialChanges = 0;
+    unsigned int geometryChanges = 0;
+
+    RenderQueueStats &operator+=(const RenderQueueStats &other)
+    {
+        items += other.items;
+        programChanges += other.programChanges;
+        materialChanges += other.materialChanges;
+        geometryChanges += other.geometryChanges;
+        return *this;
+    }
+};
+
+// Collects the draws of a frame and submits them sorted by a 64-bit key, most significant bits first:
+//   pass 4 | program 10 | material 16 | geometry 10 | depth 24    opaque, cutout and sky items, front to back per state
+//   pass 4 | far depth 24 | program 10 | material 16 | geometry 10    blended items, back to front
+// Program, material and geometry are small ids handed out by the queue, so items sharing state end up next
+// to each other and Submit only changes what differs from the previous item.
+// Submit also sets the depth and color masks each pass needs: with a depth prepass the opaque items are drawn
+// with GL_EQUAL and depth writes off, so only the visible fragment of every pixel runs the material's shader.
+class RenderQueue
+{
+public:
+    // with a shader every opaque mesh pushed from now on is also drawn into the depth buffer first, with the
+    // shader and the mesh's position stream. nullptr turns the prepass off.
+    void SetDepthPrepass(Shader *shader)
+    {
+        depthShader = shader;
+    }
+
+    // mesh at a level of detail, drawn with the Object block at index object of the ObjectUniformBuffer.
+    // depth is the distance from the camera.
+    void PushMesh(Render_Pass pass, Shader &shader, const Mesh &mesh, unsigned int lod, unsigned int object, float depth)
+    {
+        Item item;
+        item.shader = &shader;
+        item.mesh = &mesh;
+        item.lod = lod;
+        item.object = object;
+        item.depthOnly = pass == RENDER_PASS_DEPTH;
+        item.material = item.depthOnly ? 0 : mesh.MaterialHash();
+        item.vao = item.depthOnly ? mesh.PositionVAO : mesh.VAO;
+        item.key = makeKey(pass, programId(shader), materialId(item.material), geometryId(item.vao), depth);
+        items.push_back(item);
+        if (pass == RENDER_PASS_OPAQUE && depthShader)
+            PushMesh(RENDER_PASS_DEPTH, *depthShader, mesh, lod, object, depth);
+    }
+
+    // item that sets its own state and draws itself with shader in use, like the vegetation and the sky.
+    // it may bind textures and VAOs, those are bound again for the next item.
+    void PushCustom(Render_Pass pass, Shader &shader, float depth, function<void()> draw)
+    {
+        Item item;
+        item.shader = &shader;
+        item.custom = std::move(draw);
+        item.key = makeKey(pass, programId(shader), 0, 0, depth);
+        items.push_back(std::move(item));
+    }
+
+    // sorts the items, draws them and empties the queue
+    void Submit(const ObjectUniformBuffer &objects)
+    {
+        stats = RenderQueueStats();
+        stats.items = (unsigned int) items.size();
+        sort();
+
+        const Shader *shader = nullptr;
+        const MeshUniforms *uniforms = nullptr;
+        uint64_t material = 0;
+        unsigned int vao = 0, object = ~0u;
+        bool materialBound = false;
+        int pass = -1;
+        bool prepassed = !sorted.empty() && (sorted[0].key >> 60) == RENDER_PASS_DEPTH;
+        for (const SortEntry &entry : sorted)
+        {
+            const Item &item = items[entry.index];
+            if ((int) (entry.key >> 60) != pass)
+            {
+                pass = (int) (entry.key >> 60);
+                beginPass((Render_Pass) pass, prepassed);
+            }
+            if (item.shader != shader)
+            {
+                shader = item.shader;
+                uniforms = &meshUniforms(*item.shader);
+                item.shader->use();
+                // the material parameters are program state, so the material has to be set again
+                materialBound = false;
+                stats.programChanges++;
+            }
+            if (item.custom)
+            {
+                item.custom();
+                materialBound = false;
+                vao = 0;
+                continue;
+            }
+            if (!item.depthOnly && (!materialBound || item.material != material))
+            {
+                item.mesh->BindMaterial(*item.shader);
+                material = item.material;
+                materialBound = true;
+                stats.materialChanges++;
+            }
+            if (item.vao != vao)
+            {
+                glBindVertexArray(item.vao);
+                vao = item.vao;
+                stats.geometryChanges++;
+            }
+            if (item.object != object)
+            {
+                objects.Bind(item.object);
+                object = item.object;
+            }
+            item.mesh->DrawGeometry(*uniforms, item.lod);
+        }
+        glBindVertexArray(0);
+        // back to the default state for whatever is drawn next
+        beginPass(RENDER_PASS_OPAQUE, false);
+        items.clear();
+    }
+
+    const RenderQueueStats &Stats() const
+    {
+        return stats;
+    }
+
+private:
+    struct Item {
+        uint64_t key;
+        Shader *shader;
+        const Mesh *mesh = nullptr;
+        unsigned int lod = 0;
+        unsigned int object = 0;
+        uint64_t material = 0;
+        unsigned int vao = 0;
+        bool depthOnly = false;
+        function<void()> custom;
+    };
+
+    struct SortEntry {
+        uint64_t key;
+        unsigned int index;
+    };
+
+    vector<Item> items;
+    vector<SortEntry> sorted, scratch;
+    Shader *depthShader = nullptr;
+    // dense ids for the key, they only decide the order so running out of bits costs batching, not correctness
+    unordered_map<const Shader *, unsigned int> programs;
+    unordered_map<uint64_t, unsigned int> materials;
+    unordered_map<unsigned int, unsigned int> geometries;
+    // resolved the first time a program is submitted, kept for the following frames
+    unordered_map<const Shader *, MeshUniforms> programUniforms;
+    RenderQueueStats stats;
+
+    // depth and color state of a pass, the default (GL_LESS, depth and color writes on) for everything but
+    // the depth pass and the opaque items after it
+    static void beginPass(Render_Pass pass, bool prepassed)
+    {
+        bool depthPass = pass == RENDER_PASS_DEPTH;
+        bool equalPass = pass == RENDER_PASS_OPAQUE && prepassed;
+        GLboolean color = depthPass ? GL_FALSE : GL_TRUE;
+        glColorMask(color, color, color, color);
+        glDepthMask(equalPass ? GL_FALSE : GL_TRUE);
+        glDepthFunc(equalPass ? GL_EQUAL : GL_LESS);
+    }
+
+    template <typename K>
+    static unsigned int denseId(unordered_map<K, unsigned int> &ids, const K &key)
+    {
+        return ids.emplace(key, (unsigned int) ids.size()).first->second;
+    }
+
+    const MeshUniforms &meshUniforms(const Shader &shader)
+    {
+        unordered_map<const Shader *, MeshUniforms>::iterator found = programUniforms.find(&shader);
+        if (found == programUniforms.end())
+            found = programUniforms.emplace(&shader, MeshUniforms(shader)).first;
+        return found->second;
+    }
+
+    unsigned int programId(const Shader &shader)
+    {
+        return denseId(programs, &shader);
+    }
+
+    unsigned int materialId(uint64_t material)
+    {
+        return denseId(materials, material);
+    }
+
+    unsigned int geometryId(unsigned int vao)
+    {
+        return denseId(geometries, vao);
+    }
+
+    static uint64_t makeKey(Render_Pass pass, unsigned int program, unsigned int material, unsigned int geometry, float depth)
+    {
+        // the bits of a non negative float grow with its value, the top 24 of them are a coarse but monotonic depth
+        float clamped = depth > 0.0f ? depth : 0.0f;
+        uint32_t depthBits;
+        memcpy(&depthBits, &clamped, sizeof(depthBits));
+        uint64_t quantized = depthBits >> 8;
+
+        uint64_t state = ((uint64_t) (program & 0x3ff) << 26) | ((uint64_t) (material & 0xffff) << 10) | (geometry & 0x3ff);
+        if (pass == RENDER_PASS_BLENDED)
+            return ((uint64_t) pass << 60) | ((0xffffff - quantized) << 36) | state;
+        return ((uint64_t) pass << 60) | (state << 24) | quantized;
+    }
+
+    // LSD radix sort on bytes of the key, skipping bytes all keys agree on. stable, so equal keys keep push order.
+    void sort()
+    {
+        sorted.resize(items.size());
+        for (unsigned int i = 0; i < items.size(); i++)
+            sorted[i] = SortEntry{items[i].key, i};
+        scratch.resize(sorted.size());
+
+        for (int shift = 0; shift < 64; shift += 8)
+        {
+            size_t counts[256] = {};
+            for (const SortEntry &entry : sorted)
+                counts[(entry.key >> shift) & 0xff]++;
+            if (counts[(sorted.empty() ? 0 : sorted[0].key >> shift) & 0xff] == sorted.size())
+                continue;
+            size_t offsets[256];
+            size_t offset = 0;
+            for (int digit = 0; digit < 256; digit++)
+            {
+                offsets[digit] = offset;
+                offset += counts[digit];
+            }
+            for (const SortEntry &entry : sorted)
+                scratch[offsets[(entry.key >> shift) & 0xff]++] = entry;
+            sorted.swap(scratch);
+        }
+    }
+};
+
+#endif
@@ -4,11 +4,53 @@
 #include <glad/glad.h>
 #include <glm/glm.hpp>
 
+#include <learnopengl/hash.h>
+
 #include <string>
 #include <fstream>
 #include <sstream>
 #include <iostream>
+#include <unordered_map>
+#include <vector>
 #include <common.h>
+
+// name of a uniform, reduced to its hash. string literals are hashed at compile time, so setting a uniform
+// by name is a table lookup, without building a string or asking the driver.
+struct UniformName {
+    uint64_t hash;
+
+    template <size_t N>
+    constexpr UniformName(const char (&name)[N]) : hash(HashString(name, N - 1))
+    {
+    }
+
+    UniformName(const std::string &name) : hash(HashString(name.c_str(), name.size()))
+    {
+    }
+};
+
+inline void SetUniformValue(GLint location, bool value) { glUniform1i(location, (int)value); }
+inline void SetUniformValue(GLint location, int value) { glUniform1i(location, value); }
+inline void SetUniformValue(GLint location, float value) { glUniform1f(location, value); }
+inline void SetUniformValue(GLint location, const glm::vec2 &value) { glUniform2fv(location, 1, &value[0]); }
+inline void SetUniformValue(GLint location, const glm::vec3 &value) { glUniform3fv(location, 1, &value[0]); }
+inline void SetUniformValue(GLint location, const glm::vec4 &value) { glUniform4fv(location, 1, &value[0]); }
+inline void SetUniformValue(GLint location, const glm::mat2 &value) { glUniformMatrix2fv(location, 1, GL_FALSE, &value[0][0]); }
+inline void SetUniformValue(GLint location, const glm::mat3 &value) { glUniformMatrix3fv(location, 1, GL_FALSE, &value[0][0]); }
+inline void SetUniformValue(GLint location, const glm::mat4 &value) { glUniformMatrix4fv(location, 1, GL_FALSE, &value[0][0]); }
+
+// a uniform resolved once (see Shader::GetUniform), Set writes it in the program currently in use.
+// uniforms the program doesn't have get location -1, which GL ignores.
+template <typename T>
+struct Uniform {
+    GLint location = -1;
+
+    void Set(const T &value) const
+    {
+        SetUniformValue(location, value);
+    }
+};
+
 class Shader
 {
 public:
@@ -102,6 +144,7 @@ public:
         if(geometryPath != nullptr)
             glDeleteShader(geometry);
 
+        reflectUniforms();
     }
     // activate the shader
     // ------------------------------------------------------------------------
@@ -109,69 +152,117 @@ public:
     { 
         glUseProgram(ID); 
     }
+    // resolves a uniform once for setting it every frame
+    template <typename T>
+    Uniform<T> GetUniform(UniformName name) const
+    {
+        return Uniform<T>{GetUniformLocation(name)};
+    }
+    // location of an active uniform, -1 if the program doesn't use it
+    GLint GetUniformLocation(UniformName name) const
+    {
+        std::unordered_map<uint64_t, GLint>::const_iterator found = uniformLocations.find(name.hash);
+        return found != uniformLocations.end() ? found->second : -1;
+    }
     // utility uniform functions
     // ------------------------------------------------------------------------
-    void setBool(const std::string &name, bool value) const
+    void setBool(UniformName name, bool value) const
     {         
-        glUniform1i(glGetUniformLocation(ID, name.c_str()), (int)value); 
+        glUniform1i(GetUniformLocation(name), (int)value); 
     }
     // ------------------------------------------------------------------------
-    void setInt(const std::string &name, int value) const
+    void setInt(UniformName name, int value) const
     { 
-        glUniform1i(glGetUniformLocation(ID, name.c_str()), value); 
+        glUniform1i(GetUniformLocation(name), value); 
     }
     // ------------------------------------------------------------------------
-    void setFloat(const std::string &name, float value) const
+    void setFloat(UniformName name, float value) const
     { 
-        glUniform1f(glGetUniformLocation(ID, name.c_str()), value); 
+        glUniform1f(GetUniformLocation(name), value); 
     }
     // ------------------------------------------------------------------------
-    void setVec2(const std::string &name, const glm::vec2 &value) const
+    void setVec2(UniformName name, const glm::vec2 &value) const
     { 
-        glUniform2fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]); 
+        glUniform2fv(GetUniformLocation(name), 1, &value[0]); 
     }
-    void setVec2(const std::string &name, float x, float y) const
+    void setVec2(UniformName name, float x, float y) const
     { 
-        glUniform2f(glGetUniformLocation(ID, name.c_str()), x, y); 
+        glUniform2f(GetUniformLocation(name), x, y); 
     }
     // ------------------------------------------------------------------------
-    void setVec3(const std::string &name, const glm::vec3 &value) const
+    void setVec3(UniformName name, const glm::vec3 &value) const
     { 
-        glUniform3fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]); 
+        glUniform3fv(GetUniformLocation(name), 1, &value[0]); 
     }
-    void setVec3(const std::string &name, float x, float y, float z) const
+    void setVec3(UniformName name, float x, float y, float z) const
     { 
-        glUniform3f(glGetUniformLocation(ID, name.c_str()), x, y, z); 
+        glUniform3f(GetUniformLocation(name), x, y, z); 
     }
     // ------------------------------------------------------------------------
-    void setVec4(const std::string &name, const glm::vec4 &value) const
+    void setVec4(UniformName name, const glm::vec4 &value) const
     { 
-        glUniform4fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]); 
+        glUniform4fv(GetUniformLocation(name), 1, &value[0]); 
     }
-    void setVec4(const std::string &name, float x, float y, float z, float w) 
+    void setVec4(UniformName name, float x, float y, float z, float w) 
     { 
-        glUniform4f(glGetUniformLocation(ID, name.c_str()), x, y, z, w); 
+        glUniform4f(GetUniformLocation(name), x, y, z, w); 
     }
     // ------------------------------------------------------------------------
-    void setMat2(const std::string &name, const glm::mat2 &mat) const
+    void setMat2(UniformName name, const glm::mat2 &mat) const
     {
-        glUniformMatrix2fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+        glUniformMatrix2fv(GetUniformLocation(name), 1, GL_FALSE, &mat[0][0]);
     }
     // ------------------------------------------------------------------------
-    void setMat3(const std::string &name, const glm::mat3 &mat) const
+    void setMat3(UniformName name, const glm::mat3 &mat) const
     {
-        glUniformMatrix3fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+        glUniformMatrix3fv(GetUniformLocation(name), 1, GL_FALSE, &mat[0][0]);
     }
     // ------------------------------------------------------------------------
-    void setMat4(const std::string &name, const glm::mat4 &mat) const
+    void setMat4(UniformName name, const glm::mat4 &mat) const
     {
-        glUniformMatrix4fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+        glUniformMatrix4fv(GetUniformLocation(name), 1, GL_FALSE, &mat[0][0]);
     }
     ~Shader() {
         glDeleteProgram(ID);
     }
 
 private:
+    // locations of all active uniforms by name hash, filled once after linking
+    std::unordered_map<uint64_t, GLint> uniformLocations;
+
+    void reflectUniforms()
+    {
+        GLint count = 0, maxLength = 0;
+        glGetProgramiv(ID, GL_ACTIVE_UNIFORMS, &count);
+        glGetProgramiv(ID, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxLength);
+        std::vector<GLchar> buffer(maxLength > 0 ? maxLength : 1);
+        for (GLint i = 0; i < count; i++)
+        {
+            GLsizei length = 0;
+            GLint size = 0;
+            GLenum type;
+            glGetActiveUniform(ID, (GLuint)i, (GLsizei)buffer.size(), &length, &size, &type, buffer.data());
+            std::string name(buffer.data(), length);
+            GLint location = glGetUniformLocation(ID, name.c_str());
+            // members of uniform blocks have no location
+            if (location < 0)
+                continue;
+            uniformLocations[UniformName(name).hash] = location;
+
+            // arrays are reported once as "name[0]", their elements can be set as name, name[0] .. name[size - 1]
+            if (name.size() > 3 && name.compare(name.size() - 3, 3, "[0]") == 0)
+            {
+                std::string base = name.substr(0, name.size() - 3);
+                uniformLocations[UniformName(base).hash] = location;
+                for (GLint element = 1; element < size; element++)
+                {
+                    std::string elementName = base + "[" + std::to_string(element) + "]";
+                    uniformLocations[UniformName(elementName).hash] = glGetUniformLocation(ID, elementName.c_str());
+                }
+            }
+        }
+    }
+
     // utility function for checking shader compilation/linking errors.
     // ------------------------------------------------------------------------
     void checkCompileErrors(GLuint shader, std::string type)
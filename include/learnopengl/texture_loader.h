@@ -0,0 +1,155 @@
+#ifndef TEXTURE_LOADER_H
+#define TEXTURE_LOADER_H
+
+#include <glad/glad.h>
+#include <stb_image.h>
+
+#include <learnopengl/thread_pool.h>
+
+#include <cstring>
+#include <future>
+#include <memory>
+#include <string>
+#include <vector>
+using namespace std;
+
+// number of pixel unpack buffers uploads rotate through
+const unsigned int TEXTURE_STAGING_BUFFERS = 4;
+
+// decoded 8 bit image, pixels are released with stbi_image_free
+struct Image {
+    int width = 0;
+    int height = 0;
+    int components = 0;
+    shared_ptr<unsigned char> pixels;
+
+    bool Valid() const
+    {
+        return pixels != nullptr;
+    }
+
+    size_t Size() const
+    {
+        return (size_t) width * height * components;
+    }
+
+    GLenum Format() const
+    {
+        if (components == 1)
+            return GL_RED;
+        else if (components == 4)
+            return GL_RGBA;
+        return GL_RGB;
+    }
+};
+
+// decodes an image file, safe to call from any thread
+inline Image DecodeImage(const string &path)
+{
+    Image image;
+    unsigned char *data = stbi_load(path.c_str(), &image.width, &image.height, &image.components, 0);
+    if (data)
+        image.pixels = shared_ptr<unsigned char>(data, stbi_image_free);
+    return image;
+}
+
+// decodes all files in parallel on the pool, results are in the same order as paths
+inline vector<Image> DecodeImages(ThreadPool &pool, const vector<string> &paths)
+{
+    vector<future<Image>> pending;
+    for (const string &path : paths)
+        pending.push_back(pool.Submit([path]() { return DecodeImage(path); }));
+
+    vector<Image> images;
+    for (future<Image> &image : pending)
+        images.push_back(image.get());
+    return images;
+}
+
+// Streams decoded pixels to the GL through a small ring of pixel unpack buffers.
+// Each upload orphans its buffer's storage with glBufferData before mapping it, so a buffer the GL is still
+// reading from is never waited for; the driver hands out fresh storage and frees the old one when it's done.
+class TextureUploader
+{
+public:
+    static TextureUploader &Instance()
+    {
+        static TextureUploader uploader;
+        return uploader;
+    }
+
+    // specifies level 0 of target (GL_TEXTURE_2D or a cube map face) of the currently bound texture
+    void Upload(GLenum target, GLint internalFormat, const Image &image)
+    {
+        GLuint buffer = buffers[next];
+        next = (next + 1) % TEXTURE_STAGING_BUFFERS;
+
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, buffer);
+        glBufferData(GL_PIXEL_UNPACK_BUFFER, image.Size(), nullptr, GL_STREAM_DRAW);
+        void *staging = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, image.Size(), GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+        if (staging)
+        {
+            memcpy(staging, image.pixels.get(), image.Size());
+            glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+            glTexImage2D(target, 0, internalFormat, image.width, image.height, 0, image.Format(), GL_UNSIGNED_BYTE, (void*)0);
+        }
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+        // mapping can fail (out of memory), fall back to a plain client memory upload
+        if (!staging)
+            glTexImage2D(target, 0, internalFormat, image.width, image.height, 0, image.Format(), GL_UNSIGNED_BYTE, image.pixels.get());
+    }
+
+private:
+    GLuint buffers[TEXTURE_STAGING_BUFFERS] = {};
+    unsigned int next = 0;
+
+    TextureUploader()
+    {
+        glGenBuffers(TEXTURE_STAGING_BUFFERS, buffers);
+    }
+};
+
+// creates a mipmapped 2D texture from a decoded image. an invalid image gives an empty texture.
+// clampTransparent uses GL_CLAMP_TO_EDGE for RGBA images to prevent semi-transparent borders.
+inline unsigned int CreateTexture2D(const Image &image, bool clampTransparent = false)
+{
+    unsigned int textureID;
+    glGenTextures(1, &textureID);
+    if (!image.Valid())
+        return textureID;
+
+    GLenum format = image.Format();
+    glBindTexture(GL_TEXTURE_2D, textureID);
+    TextureUploader::Instance().Upload(GL_TEXTURE_2D, format, image);
+    glGenerateMipmap(GL_TEXTURE_2D);
+
+    GLint wrap = clampTransparent && format == GL_RGBA ? GL_CLAMP_TO_EDGE : GL_REPEAT;
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, wrap);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, wrap);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    return textureID;
+}
+
+// creates a cube map from six decoded faces in +X, -X, +Y, -Y, +Z, -Z order, invalid faces are left empty
+inline unsigned int CreateCubemap(const vector<Image> &faces)
+{
+    unsigned int textureID;
+    glGenTextures(1, &textureID);
+    glBindTexture(GL_TEXTURE_CUBE_MAP, textureID);
+
+    for (unsigned int i = 0; i < faces.size(); i++)
+    {
+        if (faces[i].Valid())
+            TextureUploader::Instance().Upload(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, GL_RGB, faces[i]);
+    }
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+    return textureID;
+}
+
+#endif
@@ -0,0 +1,358 @@
+#ifndef TEXTURE_REGISTRY_H
+#define TEXTURE_REGISTRY_H
+
+#include <glad/glad.h>
+
+#include <learnopengl/hash.h>
+#include <learnopengl/ktx.h>
+#include <learnopengl/texture_loader.h>
+#include <learnopengl/thread_pool.h>
+
+#include <sys/stat.h>
+#include <climits>
+#include <cstdlib>
+#include <iostream>
+#include <list>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+using namespace std;
+
+// default budget for textures kept resident after their last user is gone
+const size_t TEXTURE_BUDGET_BYTES = 512u * 1024u * 1024u;
+
+enum Texture_Kind {
+    TEXTURE_2D,
+    TEXTURE_2D_CLAMP_TRANSPARENT,
+    TEXTURE_CUBEMAP
+};
+
+class TextureRegistry;
+
+// a texture read on a worker for Get2D: the cooked file when it's up to date and the GL can sample it,
+// otherwise the decoded source image
+struct TextureSource {
+    bool cooked = false;
+    KtxFile ktx;
+    Image image;
+};
+
+// Counted reference to a texture owned by the TextureRegistry.
+// Must be copied and released on the thread owning the GL context.
+class TextureHandle
+{
+public:
+    TextureHandle() {}
+    TextureHandle(const TextureHandle &other);
+    TextureHandle(TextureHandle &&other) : entry(other.entry) { other.entry = nullptr; }
+    TextureHandle &operator=(TextureHandle other)
+    {
+        std::swap(entry, other.entry);
+        return *this;
+    }
+    ~TextureHandle();
+
+    bool Valid() const
+    {
+        return entry != nullptr;
+    }
+
+    unsigned int ID() const;
+
+private:
+    friend class TextureRegistry;
+    struct Entry;
+
+    explicit TextureHandle(Entry *entry);
+
+    Entry *entry = nullptr;
+};
+
+struct TextureHandle::Entry {
+    uint64_t key;
+    unsigned int id;
+    size_t bytes;
+    unsigned int references;
+    list<uint64_t>::iterator unusedPosition;
+};
+
+// Process wide texture cache. Textures are keyed by their content hash (files are identified by
+// canonical path, and rehashed only when their size or modification time changes), so identical
+// images are decoded and uploaded once no matter which path or model they come from.
+// Textures nobody references any more stay resident until the budget is exceeded, then the least
+// recently released ones are deleted.
+class TextureRegistry
+{
+public:
+    static TextureRegistry &Instance()
+    {
+        static TextureRegistry registry;
+        return registry;
+    }
+
+    void SetBudget(size_t bytes)
+    {
+        lock_guard<mutex> lock(guard);
+        budgetBytes = bytes;
+        evict();
+    }
+
+    size_t ResidentBytes() const
+    {
+        lock_guard<mutex> lock(guard);
+        return residentBytes;
+    }
+
+    size_t Count() const
+    {
+        lock_guard<mutex> lock(guard);
+        return entries.size();
+    }
+
+    // true if the file is already resident as a texture of this kind; safe to call from any thread
+    bool Contains(const string &path, Texture_Kind kind = TEXTURE_2D)
+    {
+        uint64_t contentHash;
+        if (!identify(path, contentHash))
+            return false;
+        lock_guard<mutex> lock(guard);
+        return entries.count(textureKey(kind, contentHash)) != 0;
+    }
+
+    // reads the cooked .ktx next to the file if it's up to date and supported, decodes the file if not. safe to
+    // call from any thread once GetCompressedFormatSupport has run on the GL thread.
+    TextureSource Read(const string &path)
+    {
+        TextureSource source;
+        uint64_t contentHash;
+        bool found = identify(path, contentHash);
+        source.cooked = found && ReadCookedTexture(path, contentHash, source.ktx);
+        if (!source.cooked)
+        {
+            source.ktx = KtxFile();
+            source.image = DecodeImage(path);
+        }
+        return source;
+    }
+
+    // returns the texture for the file if it's resident, otherwise creates it from what Read prepared or, without
+    // that, reads the file here first
+    TextureHandle Get2D(const string &path, const TextureSource *prepared = nullptr, Texture_Kind kind = TEXTURE_2D)
+    {
+        uint64_t contentHash;
+        bool found = identify(path, contentHash);
+        uint64_t key = found ? textureKey(kind, contentHash) : HashBytes(path.data(), path.size(), kind);
+
+        TextureHandle resident = find(key);
+        if (resident.Valid())
+            return resident;
+
+        TextureSource source = prepared ? TextureSource() : Read(path);
+        const TextureSource &texture = prepared ? *prepared : source;
+        if (texture.cooked)
+            return insert(key, CreateCompressedTexture2D(texture.ktx, kind == TEXTURE_2D_CLAMP_TRANSPARENT), texture.ktx.Size());
+
+        const Image &image = texture.image;
+        if (!image.Valid())
+            std::cout << "Texture failed to load at path: " << path << std::endl;
+        unsigned int id = CreateTexture2D(image, kind == TEXTURE_2D_CLAMP_TRANSPARENT);
+        return insert(key, id, textureBytes(image, 1));
+    }
+
+    // returns the cube map made of the six faces, decoding them in parallel if it's not resident
+    TextureHandle GetCubemap(ThreadPool &pool, const vector<string> &faces)
+    {
+        uint64_t key = TEXTURE_CUBEMAP;
+        vector<uint64_t> contentHashes(faces.size());
+        bool found = true;
+        for (unsigned int i = 0; i < faces.size(); i++)
+        {
+            uint64_t faceKey;
+            if (identify(faces[i], contentHashes[i]))
+                faceKey = textureKey(TEXTURE_CUBEMAP, contentHashes[i]);
+            else
+            {
+                faceKey = HashBytes(faces[i].data(), faces[i].size(), TEXTURE_CUBEMAP);
+                found = false;
+            }
+            key = HashBytes(&faceKey, sizeof(faceKey), key);
+        }
+
+        TextureHandle resident = find(key);
+        if (resident.Valid())
+            return resident;
+
+        // the cooked faces are only used if all of them are there, in the same format
+        vector<KtxFile> cooked(faces.size());
+        for (unsigned int i = 0; found && i < faces.size(); i++)
+        {
+            found = ReadCookedTexture(faces[i], contentHashes[i], cooked[i])
+                    && cooked[i].internalFormat == cooked[0].internalFormat && cooked[i].width == cooked[0].width
+                    && cooked[i].levels.size() == cooked[0].levels.size();
+        }
+        if (found && !faces.empty())
+            return insert(key, CreateCompressedCubemap(cooked), cooked[0].Size() * cooked.size());
+
+        vector<Image> images = DecodeImages(pool, faces);
+        for (unsigned int i = 0; i < faces.size(); i++)
+        {
+            if (!images[i].Valid())
+                std::cout << "Cubemap texture failed to load at path: " << faces[i] << std::endl;
+        }
+        unsigned int id = CreateCubemap(images);
+        return insert(key, id, images.empty() ? 0 : textureBytes(images[0], (unsigned int) images.size()));
+    }
+
+private:
+    friend class TextureHandle;
+
+    // what we know about a file, so it's only rehashed when it changes
+    struct FileInfo {
+        off_t size;
+        time_t modified;
+        uint64_t contentHash;
+    };
+
+    mutable std::mutex guard;
+    unordered_map<uint64_t, TextureHandle::Entry> entries;
+    unordered_map<string, FileInfo> files;
+    // keys of the resident textures nobody references, least recently released first
+    list<uint64_t> unused;
+    size_t residentBytes = 0;
+    size_t budgetBytes = TEXTURE_BUDGET_BYTES;
+
+    TextureRegistry() {}
+
+    static uint64_t textureKey(Texture_Kind kind, uint64_t contentHash)
+    {
+        return HashBytes(&kind, sizeof(kind), contentHash);
+    }
+
+    // hash of the file's content, looked up by canonical path
+    bool identify(const string &path, uint64_t &contentHash)
+    {
+        char resolved[PATH_MAX];
+        struct stat info;
+        if (!realpath(path.c_str(), resolved) || stat(resolved, &info) != 0)
+            return false;
+
+        string canonical(resolved);
+        {
+            lock_guard<mutex> lock(guard);
+            unordered_map<string, FileInfo>::iterator known = files.find(canonical);
+            if (known != files.end() && known->second.size == info.st_size && known->second.modified == info.st_mtime)
+            {
+                contentHash = known->second.contentHash;
+                return true;
+            }
+        }
+        if (!HashFile(canonical, contentHash))
+            return false;
+        {
+            lock_guard<mutex> lock(guard);
+            files[canonical] = FileInfo{info.st_size, info.st_mtime, contentHash};
+        }
+        return true;
+    }
+
+    static size_t textureBytes(const Image &image, unsigned int layers)
+    {
+        // drivers pad RGB to four bytes per texel, mipmaps add a third on top
+        size_t texel = image.components == 1 ? 1 : 4;
+        return (size_t) image.width * image.height * texel * layers * 4 / 3;
+    }
+
+    TextureHandle find(uint64_t key);
+    TextureHandle insert(uint64_t key, unsigned int id, size_t bytes);
+    void acquire(TextureHandle::Entry *entry);
+    void release(TextureHandle::Entry *entry);
+    void evict();
+};
+
+inline TextureHandle::TextureHandle(Entry *entry) : entry(entry)
+{
+    if (entry)
+        TextureRegistry::Instance().acquire(entry);
+}
+
+inline TextureHandle::TextureHandle(const TextureHandle &other) : TextureHandle(other.entry)
+{
+}
+
+inline TextureHandle::~TextureHandle()
+{
+    if (entry)
+        TextureRegistry::Instance().release(entry);
+}
+
+inline unsigned int TextureHandle::ID() const
+{
+    return entry ? entry->id : 0;
+}
+
+inline TextureHandle TextureRegistry::find(uint64_t key)
+{
+    TextureHandle::Entry *entry = nullptr;
+    {
+        lock_guard<mutex> lock(guard);
+        unordered_map<uint64_t, TextureHandle::Entry>::iterator found = entries.find(key);
+        if (found != entries.end())
+            entry = &found->second;
+    }
+    return TextureHandle(entry);
+}
+
+inline TextureHandle TextureRegistry::insert(uint64_t key, unsigned int id, size_t bytes)
+{
+    TextureHandle::Entry *entry;
+    {
+        lock_guard<mutex> lock(guard);
+        entry = &entries[key];
+        entry->key = key;
+        entry->id = id;
+        entry->bytes = bytes;
+        entry->references = 0;
+        entry->unusedPosition = unused.end();
+        residentBytes += bytes;
+    }
+    TextureHandle handle(entry);
+    lock_guard<mutex> lock(guard);
+    evict();
+    return handle;
+}
+
+inline void TextureRegistry::acquire(TextureHandle::Entry *entry)
+{
+    lock_guard<mutex> lock(guard);
+    if (entry->references++ == 0 && entry->unusedPosition != unused.end())
+    {
+        unused.erase(entry->unusedPosition);
+        entry->unusedPosition = unused.end();
+    }
+}
+
+inline void TextureRegistry::release(TextureHandle::Entry *entry)
+{
+    lock_guard<mutex> lock(guard);
+    if (--entry->references == 0)
+    {
+        entry->unusedPosition = unused.insert(unused.end(), entry->key);
+        evict();
+    }
+}
+
+// deletes unreferenced textures, oldest first, until the resident size fits the budget. guard must be held.
+inline void TextureRegistry::evict()
+{
+    while (residentBytes > budgetBytes && !unused.empty())
+    {
+        unordered_map<uint64_t, TextureHandle::Entry>::iterator victim = entries.find(unused.front());
+        unused.pop_front();
+        glDeleteTextures(1, &victim->second.id);
+        residentBytes -= victim->second.bytes;
+        entries.erase(victim);
+    }
+}
+
+#endif
@@ -0,0 +1,149 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed size pool of worker threads executing jobs in FIFO order.
+// Jobs still queued when the pool is destroyed are dropped; running ones are waited for.
+class ThreadPool
+{
+public:
+    // by default leaves one core for the render thread
+    explicit ThreadPool(unsigned int threadCount = defaultThreadCount())
+    {
+        for (unsigned int i = 0; i < std::max(threadCount, 1u); i++)
+            workers.emplace_back([this]() { workerLoop(); });
+    }
+
+    ThreadPool(const ThreadPool &) = delete;
+    ThreadPool &operator=(const ThreadPool &) = delete;
+
+    ~ThreadPool()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+            jobs.clear();
+        }
+        wakeUp.notify_all();
+        for (std::thread &worker : workers)
+            worker.join();
+    }
+
+    unsigned int Size() const
+    {
+        return (unsigned int) workers.size();
+    }
+
+    // queues a job without a way to wait for it
+    void Enqueue(std::function<void()> job)
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            jobs.push_back(std::move(job));
+        }
+        wakeUp.notify_one();
+    }
+
+    // queues a job and returns a future for its result
+    template<typename F>
+    auto Submit(F job) -> std::future<decltype(job())>
+    {
+        typedef decltype(job()) Result;
+        std::shared_ptr<std::packaged_task<Result()>> task = std::make_shared<std::packaged_task<Result()>>(std::move(job));
+        std::future<Result> result = task->get_future();
+        Enqueue([task]() { (*task)(); });
+        return result;
+    }
+
+    // runs body(first, last) over [0, count) split into chunks, on the calling thread and on whichever workers
+    // get to it. chunks are claimed when they start, so the caller runs every chunk no worker has taken and only
+    // waits for the ones already running: per frame work never waits behind loads queued ahead of it.
+    void ParallelFor(unsigned int count, const std::function<void(unsigned int, unsigned int)> &body)
+    {
+        unsigned int chunkCount = std::min(count, Size() * 4 + 1);
+        if (chunkCount <= 1)
+        {
+            if (count)
+                body(0, count);
+            return;
+        }
+        // queued helpers can start after the call returned, they only find no chunks left then
+        std::shared_ptr<ParallelWork> work = std::make_shared<ParallelWork>(count, chunkCount, body);
+        for (unsigned int i = 0; i < std::min(Size(), chunkCount - 1); i++)
+            Enqueue([work]() { while (work->RunChunk()); });
+        while (work->RunChunk());
+        std::unique_lock<std::mutex> lock(work->mutex);
+        work->done.wait(lock, [&work]() { return work->finished == work->chunkCount; });
+    }
+
+private:
+    struct ParallelWork {
+        unsigned int count, chunkCount;
+        std::function<void(unsigned int, unsigned int)> body;
+        std::atomic<unsigned int> next{0};
+        unsigned int finished = 0;
+        std::mutex mutex;
+        std::condition_variable done;
+
+        ParallelWork(unsigned int count, unsigned int chunkCount, const std::function<void(unsigned int, unsigned int)> &body)
+                : count(count), chunkCount(chunkCount), body(body)
+        {
+        }
+
+        // runs the next unclaimed chunk, false when there is none
+        bool RunChunk()
+        {
+            unsigned int chunk = next++;
+            if (chunk >= chunkCount)
+                return false;
+            body(chunk * count / chunkCount, (chunk + 1) * count / chunkCount);
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                finished++;
+            }
+            done.notify_all();
+            return true;
+        }
+    };
+
+    std::vector<std::thread> workers;
+    std::deque<std::function<void()>> jobs;
+    std::mutex mutex;
+    std::condition_variable wakeUp;
+    bool stopping = false;
+
+    static unsigned int defaultThreadCount()
+    {
+        unsigned int cores = std::thread::hardware_concurrency();
+        return cores > 1 ? cores - 1 : 1;
+    }
+
+    void workerLoop()
+    {
+        for (;;)
+        {
+            std::function<void()> job;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                wakeUp.wait(lock, [this]() { return stopping || !jobs.empty(); });
+                if (stopping)
+                    return;
+                job = std::move(jobs.front());
+                jobs.pop_front();
+            }
+            job();
+        }
+    }
+};
+
+#endif
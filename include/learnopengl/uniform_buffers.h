@@ -0,0 +1,203 @@
+#ifndef UNIFORM_BUFFERS_H
+#define UNIFORM_BUFFERS_H
+
+#include <glad/glad.h>
+
+#include <glm/glm.hpp>
+
+#include <learnopengl/shader.h>
+
+#include <cstring>
+#include <vector>
+using namespace std;
+
+// binding points of the uniform blocks shared by all programs. the GLSL declarations (same names, std140)
+// are repeated in every shader that uses them.
+enum Uniform_Block_Binding {
+    FRAME_BLOCK_BINDING,
+    LIGHTS_BLOCK_BINDING,
+    OBJECT_BLOCK_BINDING
+};
+
+// C++ mirrors of the blocks in std140 layout: vec3 takes 16 bytes unless a float follows it,
+// so every vec3 is paired with a float (or padding) here and in the GLSL structs
+struct FrameUniforms {
+    glm::mat4 view;
+    glm::mat4 projection;
+    glm::vec3 viewPosition;
+    float time;
+    // light cluster lookup, see LightClusters::ShaderParameters
+    glm::vec4 clusterParameters;
+};
+
+struct PointLightUniforms {
+    glm::vec3 position;
+    float constant;
+    glm::vec3 ambient;
+    float linear;
+    glm::vec3 diffuse;
+    float quadratic;
+    glm::vec3 specular;
+    float padding;
+};
+
+struct SpotLightUniforms {
+    glm::vec3 position;
+    float constant;
+    glm::vec3 direction;
+    float linear;
+    glm::vec3 ambient;
+    float quadratic;
+    glm::vec3 diffuse;
+    float cutOff;
+    glm::vec3 specular;
+    float outerCutOff;
+};
+
+struct DirLightUniforms {
+    glm::vec3 direction;
+    float padding0;
+    glm::vec3 ambient;
+    float padding1;
+    glm::vec3 diffuse;
+    float padding2;
+    glm::vec3 specular;
+    float padding3;
+};
+
+// the lights that reach everything, the many small ones go through LightClusters
+struct LightsUniforms {
+    PointLightUniforms moonLight;
+    SpotLightUniforms spotLight;
+    DirLightUniforms dirLight;
+};
+
+struct ObjectUniforms {
+    glm::mat4 model;
+};
+
+static_assert(sizeof(FrameUniforms) == 160, "FrameUniforms doesn't match the std140 Frame block");
+static_assert(sizeof(PointLightUniforms) == 64 && sizeof(SpotLightUniforms) == 80 && sizeof(DirLightUniforms) == 64,
+              "light structs don't match their std140 layout");
+static_assert(sizeof(LightsUniforms) == 208, "LightsUniforms doesn't match the std140 Lights block");
+
+// points the blocks a program declares at the shared binding points, blocks it doesn't declare are skipped
+inline void BindUniformBlocks(Shader &shader)
+{
+    const char *names[] = {"Frame", "Lights", "Object"};
+    const GLuint bindings[] = {FRAME_BLOCK_BINDING, LIGHTS_BLOCK_BINDING, OBJECT_BLOCK_BINDING};
+    for (int i = 0; i < 3; i++)
+    {
+        GLuint index = glGetUniformBlockIndex(shader.ID, names[i]);
+        if (index != GL_INVALID_INDEX)
+            glUniformBlockBinding(shader.ID, index, bindings[i]);
+    }
+}
+
+// one std140 block in its own UBO, bound to binding for good. Update orphans the buffer, so writing it
+// never waits for draws still reading the previous contents.
+template <typename T>
+class UniformBlock
+{
+public:
+    explicit UniformBlock(GLuint binding)
+    {
+        glGenBuffers(1, &ubo);
+        glBindBuffer(GL_UNIFORM_BUFFER, ubo);
+        glBufferData(GL_UNIFORM_BUFFER, sizeof(T), nullptr, GL_STREAM_DRAW);
+        glBindBuffer(GL_UNIFORM_BUFFER, 0);
+        glBindBufferBase(GL_UNIFORM_BUFFER, binding, ubo);
+    }
+
+    UniformBlock(const UniformBlock &) = delete;
+    UniformBlock &operator=(const UniformBlock &) = delete;
+
+    ~UniformBlock()
+    {
+        Release();
+    }
+
+    void Update(const T &data)
+    {
+        glBindBuffer(GL_UNIFORM_BUFFER, ubo);
+        glBufferData(GL_UNIFORM_BUFFER, sizeof(T), &data, GL_STREAM_DRAW);
+        glBindBuffer(GL_UNIFORM_BUFFER, 0);
+    }
+
+    // deletes the buffer, has to happen while the context is still alive
+    void Release()
+    {
+        if (ubo)
+            glDeleteBuffers(1, &ubo);
+        ubo = 0;
+    }
+
+private:
+    unsigned int ubo = 0;
+};
+
+// the Object block of every object drawn in a frame, in one UBO: Push collects them, Upload sends all of
+// them at once and Bind points the binding at one of them with glBindBufferRange
+class ObjectUniformBuffer
+{
+public:
+    ObjectUniformBuffer()
+    {
+        GLint alignment = 256;
+        glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+        stride = (sizeof(ObjectUniforms) + alignment - 1) / alignment * alignment;
+        glGenBuffers(1, &ubo);
+    }
+
+    ObjectUniformBuffer(const ObjectUniformBuffer &) = delete;
+    ObjectUniformBuffer &operator=(const ObjectUniformBuffer &) = delete;
+
+    ~ObjectUniformBuffer()
+    {
+        Release();
+    }
+
+    // starts a new frame, forgetting the objects pushed so far
+    void Clear()
+    {
+        staging.clear();
+    }
+
+    // returns the index Bind takes
+    unsigned int Push(const ObjectUniforms &object)
+    {
+        size_t offset = staging.size();
+        staging.resize(offset + stride, 0);
+        memcpy(&staging[offset], &object, sizeof(ObjectUniforms));
+        return (unsigned int) (offset / stride);
+    }
+
+    void Upload()
+    {
+        if (staging.empty())
+            return;
+        glBindBuffer(GL_UNIFORM_BUFFER, ubo);
+        glBufferData(GL_UNIFORM_BUFFER, staging.size(), staging.data(), GL_STREAM_DRAW);
+        glBindBuffer(GL_UNIFORM_BUFFER, 0);
+    }
+
+    void Bind(unsigned int object) const
+    {
+        glBindBufferRange(GL_UNIFORM_BUFFER, OBJECT_BLOCK_BINDING, ubo, object * stride, sizeof(ObjectUniforms));
+    }
+
+    // deletes the buffer, has to happen while the context is still alive
+    void Release()
+    {
+        if (ubo)
+            glDeleteBuffers(1, &ubo);
+        ubo = 0;
+    }
+
+private:
+    unsigned int ubo = 0;
+    size_t stride;
+    vector<unsigned char> staging;
+};
+
+#endif
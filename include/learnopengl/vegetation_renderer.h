@@ -0,0 +1,212 @@
+#ifndef VEGETATION_RENDERER_H
+#define VEGETATION_RENDERER_H
+
+#include <glad/glad.h>
+
+#include <glm/glm.hpp>
+
+#include <learnopengl/frustum.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstring>
+#include <map>
+#include <utility>
+#include <vector>
+using namespace std;
+
+// side length of the square ground cells instances are culled in
+const float VEGETATION_CHUNK_SIZE = 16.0f;
+
+// one plant: the billboard is scaled, rotated around the y axis (radians) and moved to position
+struct VegetationInstance {
+    glm::vec3 position;
+    float scale;
+    float rotation;
+};
+
+// Draws many copies of one billboard with a single instanced draw call.
+// Instances are bucketed into ground chunks, every frame the chunks inside the frustum are copied into a
+// stream buffer that feeds the per instance attributes (locations 2 and 3, see vegetation.vs).
+class VegetationRenderer
+{
+public:
+    // vertices are interleaved positions and texture coords (5 floats per vertex), like the old transparent quad
+    VegetationRenderer(const float *vertices, unsigned int vertexCount) : vertexCount(vertexCount)
+    {
+        // the billboard reaches at most this far from the instance position at scale 1, whatever the rotation
+        for (unsigned int i = 0; i < vertexCount; i++)
+            extent = max(extent, glm::length(glm::vec3(vertices[i * 5], vertices[i * 5 + 1], vertices[i * 5 + 2])));
+
+        glGenVertexArrays(1, &vao);
+        glGenBuffers(1, &vbo);
+        glGenBuffers(1, &instanceVbo);
+        glBindVertexArray(vao);
+        glBindBuffer(GL_ARRAY_BUFFER, vbo);
+        glBufferData(GL_ARRAY_BUFFER, vertexCount * 5 * sizeof(float), vertices, GL_STATIC_DRAW);
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void*)0);
+        glEnableVertexAttribArray(1);
+        glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void*)(3 * sizeof(float)));
+
+        // per instance: position and scale, rotation
+        glBindBuffer(GL_ARRAY_BUFFER, instanceVbo);
+        glEnableVertexAttribArray(2);
+        glVertexAttribPointer(2, 4, GL_FLOAT, GL_FALSE, sizeof(VegetationInstance), (void*)offsetof(VegetationInstance, position));
+        glVertexAttribDivisor(2, 1);
+        glEnableVertexAttribArray(3);
+        glVertexAttribPointer(3, 1, GL_FLOAT, GL_FALSE, sizeof(VegetationInstance), (void*)offsetof(VegetationInstance, rotation));
+        glVertexAttribDivisor(3, 1);
+        glBindVertexArray(0);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+    }
+
+    VegetationRenderer(const VegetationRenderer &) = delete;
+    VegetationRenderer &operator=(const VegetationRenderer &) = delete;
+
+    ~VegetationRenderer()
+    {
+        Release();
+    }
+
+    // replaces all instances, sorting them into chunks
+    void SetInstances(const vector<VegetationInstance> &newInstances)
+    {
+        map<pair<int, int>, vector<VegetationInstance>> cells;
+        for (const VegetationInstance &instance : newInstances)
+        {
+            pair<int, int> cell((int) floor(instance.position.x / VEGETATION_CHUNK_SIZE), (int) floor(instance.position.z / VEGETATION_CHUNK_SIZE));
+            cells[cell].push_back(instance);
+        }
+
+        instances.clear();
+        instances.reserve(newInstances.size());
+        chunks.clear();
+        for (const auto &cell : cells)
+        {
+            Chunk chunk;
+            chunk.first = (unsigned int) instances.size();
+            chunk.count = (unsigned int) cell.second.size();
+            chunk.low = glm::vec3(INFINITY);
+            chunk.high = glm::vec3(-INFINITY);
+            for (const VegetationInstance &instance : cell.second)
+            {
+                glm::vec3 reach(extent * instance.scale);
+                chunk.low = glm::min(chunk.low, instance.position - reach);
+                chunk.high = glm::max(chunk.high, instance.position + reach);
+                instances.push_back(instance);
+            }
+            chunks.push_back(chunk);
+        }
+
+        // room for all of them, the visible ones are streamed in every frame
+        glBindBuffer(GL_ARRAY_BUFFER, instanceVbo);
+        glBufferData(GL_ARRAY_BUFFER, instances.size() * sizeof(VegetationInstance), nullptr, GL_STREAM_DRAW);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+        visibleInstances = 0;
+    }
+
+    // draws the instances of all chunks intersecting the frustum. the vegetation shader has to be in use with
+    // view, projection and the texture set up.
+    void Draw(const Frustum &frustum)
+    {
+        visibleInstances = 0;
+        visibleChunks = 0;
+        if (instances.empty())
+            return;
+
+        glBindBuffer(GL_ARRAY_BUFFER, instanceVbo);
+        // invalidating lets the driver hand out fresh memory instead of waiting for last frame's draw
+        VegetationInstance *mapped = static_cast<VegetationInstance *>(glMapBufferRange(GL_ARRAY_BUFFER, 0,
+                instances.size() * sizeof(VegetationInstance), GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT));
+        if (!mapped)
+        {
+            glBindBuffer(GL_ARRAY_BUFFER, 0);
+            return;
+        }
+        // chunks are consecutive in instances, so neighbouring visible chunks are copied in one go
+        size_t runStart = 0, runCount = 0;
+        for (const Chunk &chunk : chunks)
+        {
+            if (!frustum.IntersectsBox(chunk.low, chunk.high))
+                continue;
+            visibleChunks++;
+            if (runCount && runStart + runCount == chunk.first)
+                runCount += chunk.count;
+            else
+            {
+                copyRun(mapped, runStart, runCount);
+                runStart = chunk.first;
+                runCount = chunk.count;
+            }
+        }
+        copyRun(mapped, runStart, runCount);
+        glUnmapBuffer(GL_ARRAY_BUFFER);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+        if (visibleInstances == 0)
+            return;
+        glBindVertexArray(vao);
+        glDrawArraysInstanced(GL_TRIANGLES, 0, vertexCount, visibleInstances);
+        glBindVertexArray(0);
+    }
+
+    unsigned int InstanceCount() const
+    {
+        return (unsigned int) instances.size();
+    }
+
+    // what the last Draw call kept after culling
+    unsigned int VisibleInstances() const
+    {
+        return visibleInstances;
+    }
+
+    unsigned int VisibleChunks() const
+    {
+        return visibleChunks;
+    }
+
+    unsigned int ChunkCount() const
+    {
+        return (unsigned int) chunks.size();
+    }
+
+    // deletes the GL objects, has to happen while the context is still alive
+    void Release()
+    {
+        if (!vao)
+            return;
+        glDeleteVertexArrays(1, &vao);
+        glDeleteBuffers(1, &vbo);
+        glDeleteBuffers(1, &instanceVbo);
+        vao = vbo = instanceVbo = 0;
+    }
+
+private:
+    struct Chunk {
+        unsigned int first;
+        unsigned int count;
+        glm::vec3 low;
+        glm::vec3 high;
+    };
+
+    unsigned int vao = 0, vbo = 0, instanceVbo = 0;
+    unsigned int vertexCount;
+    float extent = 0.0f;
+    vector<VegetationInstance> instances;
+    vector<Chunk> chunks;
+    unsigned int visibleInstances = 0;
+    unsigned int visibleChunks = 0;
+
+    void copyRun(VegetationInstance *mapped, size_t first, size_t count)
+    {
+        if (count == 0)
+            return;
+        memcpy(mapped + visibleInstances, &instances[first], count * sizeof(VegetationInstance));
+        visibleInstances += (unsigned int) count;
+    }
+};
+
+#endif
@@ -0,0 +1,213 @@
+#ifndef VERTEX_FORMAT_H
+#define VERTEX_FORMAT_H
+
+#include <glm/glm.hpp>
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+using namespace std;
+
+struct Vertex {
+    // position
+    glm::vec3 Position;
+    // normal
+    glm::vec3 Normal;
+    // texCoords
+    glm::vec2 TexCoords;
+    // tangent
+    glm::vec3 Tangent;
+    // bitangent
+    glm::vec3 Bitangent;
+};
+
+// GPU side vertex layouts a Mesh can be uploaded with; the shaders decode them based on the vertexFormat uniform
+enum Vertex_Format {
+    VERTEX_FULL,            // Vertex as is, 56 bytes
+    VERTEX_PACKED,          // position, octahedral normal, uv; 16 bytes
+    VERTEX_PACKED_QTANGENT  // position, tangent frame quaternion, uv; 20 bytes
+};
+
+// position is unorm16 within the mesh bounds (positionBias + positionScale * p), w is padding.
+// normal is octahedral encoded snorm16, texture coordinates are half floats.
+struct PackedVertex {
+    uint16_t Position[4];
+    int16_t Normal[2];
+    uint16_t TexCoords[2];
+};
+
+// like PackedVertex, but with normal, tangent and bitangent in one snorm16 quaternion.
+// the sign of w is the handedness of the bitangent.
+struct PackedTangentVertex {
+    uint16_t Position[4];
+    int16_t TangentFrame[4];
+    uint16_t TexCoords[2];
+};
+
+inline uint16_t FloatToHalf(float value)
+{
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    uint32_t sign = (bits >> 16) & 0x8000;
+    int exponent = (int) ((bits >> 23) & 0xff) - 127 + 15;
+    uint32_t mantissa = bits & 0x7fffff;
+
+    if (((bits >> 23) & 0xff) == 0xff)
+        return (uint16_t) (sign | 0x7c00 | (mantissa ? 0x200 : 0));
+    if (exponent >= 31)
+        return (uint16_t) (sign | 0x7c00);
+    if (exponent <= 0)
+    {
+        // denormal or zero
+        if (exponent < -10)
+            return (uint16_t) sign;
+        mantissa |= 0x800000;
+        int shift = 14 - exponent;
+        uint32_t half = mantissa >> shift, rest = mantissa & ((1u << shift) - 1), halfway = 1u << (shift - 1);
+        if (rest > halfway || (rest == halfway && (half & 1)))
+            half++;
+        return (uint16_t) (sign | half);
+    }
+
+    // round to nearest even, a mantissa overflow carries into the exponent as it should
+    uint32_t half = sign | ((uint32_t) exponent << 10) | (mantissa >> 13), rest = mantissa & 0x1fff;
+    if (rest > 0x1000 || (rest == 0x1000 && (half & 1)))
+        half++;
+    return (uint16_t) half;
+}
+
+inline int16_t FloatToSnorm16(float value)
+{
+    return (int16_t) std::lround(std::fmin(1.0f, std::fmax(-1.0f, value)) * 32767.0f);
+}
+
+inline uint16_t FloatToUnorm16(float value)
+{
+    return (uint16_t) std::lround(std::fmin(1.0f, std::fmax(0.0f, value)) * 65535.0f);
+}
+
+// maps the unit sphere onto the [-1, 1] square
+inline glm::vec2 OctahedralEncode(glm::vec3 normal)
+{
+    float length = std::fabs(normal.x) + std::fabs(normal.y) + std::fabs(normal.z);
+    if (length == 0.0f)
+        return glm::vec2(0.0f);
+    normal /= length;
+    glm::vec2 encoded(normal.x, normal.y);
+    if (normal.z < 0.0f)
+    {
+        encoded.x = (1.0f - std::fabs(normal.y)) * (normal.x >= 0.0f ? 1.0f : -1.0f);
+        encoded.y = (1.0f - std::fabs(normal.x)) * (normal.y >= 0.0f ? 1.0f : -1.0f);
+    }
+    return encoded;
+}
+
+// quaternion (x, y, z, w) rotating the z axis onto the normal and the x axis onto the tangent.
+// w is kept away from zero so its sign survives quantization, and is negative for mirrored frames.
+inline glm::vec4 TangentFrameQuaternion(glm::vec3 normal, glm::vec3 tangent, glm::vec3 bitangent)
+{
+    normal = glm::normalize(normal);
+    tangent = tangent - normal * glm::dot(normal, tangent);
+    if (glm::dot(tangent, tangent) < 1e-12f)
+    {
+        // meshes without texture coordinates have no tangents, any perpendicular will do
+        tangent = std::fabs(normal.x) < 0.9f ? glm::vec3(1.0f, 0.0f, 0.0f) : glm::vec3(0.0f, 1.0f, 0.0f);
+        tangent = tangent - normal * glm::dot(normal, tangent);
+    }
+    tangent = glm::normalize(tangent);
+    glm::vec3 rotatedBitangent = glm::cross(normal, tangent);
+    bool mirrored = glm::dot(rotatedBitangent, bitangent) < 0.0f;
+
+    // columns of the rotation are tangent, bitangent, normal
+    float m00 = tangent.x, m10 = tangent.y, m20 = tangent.z;
+    float m01 = rotatedBitangent.x, m11 = rotatedBitangent.y, m21 = rotatedBitangent.z;
+    float m02 = normal.x, m12 = normal.y, m22 = normal.z;
+    glm::vec4 q;
+    float trace = m00 + m11 + m22;
+    if (trace > 0.0f)
+    {
+        float s = 0.5f / std::sqrt(trace + 1.0f);
+        q = glm::vec4((m21 - m12) * s, (m02 - m20) * s, (m10 - m01) * s, 0.25f / s);
+    }
+    else if (m00 > m11 && m00 > m22)
+    {
+        float s = 2.0f * std::sqrt(1.0f + m00 - m11 - m22);
+        q = glm::vec4(0.25f * s, (m01 + m10) / s, (m02 + m20) / s, (m21 - m12) / s);
+    }
+    else if (m11 > m22)
+    {
+        float s = 2.0f * std::sqrt(1.0f + m11 - m00 - m22);
+        q = glm::vec4((m01 + m10) / s, 0.25f * s, (m12 + m21) / s, (m02 - m20) / s);
+    }
+    else
+    {
+        float s = 2.0f * std::sqrt(1.0f + m22 - m00 - m11);
+        q = glm::vec4((m02 + m20) / s, (m12 + m21) / s, 0.25f * s, (m10 - m01) / s);
+    }
+    q = glm::normalize(q);
+    if (q.w < 0.0f)
+        q = -q;
+
+    const float bias = 1.0f / 32767.0f;
+    if (q.w < bias)
+    {
+        float scale = std::sqrt(1.0f - bias * bias) / std::sqrt(q.x * q.x + q.y * q.y + q.z * q.z);
+        q = glm::vec4(q.x * scale, q.y * scale, q.z * scale, bias);
+    }
+    return mirrored ? -q : q;
+}
+
+// per mesh bounds the packed positions are quantized to
+inline void PositionQuantization(const vector<Vertex> &vertices, glm::vec3 &scale, glm::vec3 &bias)
+{
+    glm::vec3 low(0.0f), high(0.0f);
+    if (!vertices.empty())
+        low = high = vertices[0].Position;
+    for (const Vertex &vertex : vertices)
+    {
+        low = glm::min(low, vertex.Position);
+        high = glm::max(high, vertex.Position);
+    }
+    bias = low;
+    scale = high - low;
+    for (int i = 0; i < 3; i++)
+    {
+        if (scale[i] <= 0.0f)
+            scale[i] = 1.0f;
+    }
+}
+
+inline void PackPosition(const Vertex &vertex, const glm::vec3 &scale, const glm::vec3 &bias, uint16_t (&position)[4])
+{
+    glm::vec3 normalized = (vertex.Position - bias) / scale;
+    for (int i = 0; i < 3; i++)
+        position[i] = FloatToUnorm16(normalized[i]);
+    position[3] = 0;
+}
+
+inline PackedVertex PackVertex(const Vertex &vertex, const glm::vec3 &scale, const glm::vec3 &bias)
+{
+    PackedVertex packed;
+    PackPosition(vertex, scale, bias, packed.Position);
+    glm::vec2 normal = OctahedralEncode(vertex.Normal);
+    packed.Normal[0] = FloatToSnorm16(normal.x);
+    packed.Normal[1] = FloatToSnorm16(normal.y);
+    packed.TexCoords[0] = FloatToHalf(vertex.TexCoords.x);
+    packed.TexCoords[1] = FloatToHalf(vertex.TexCoords.y);
+    return packed;
+}
+
+inline PackedTangentVertex PackTangentVertex(const Vertex &vertex, const glm::vec3 &scale, const glm::vec3 &bias)
+{
+    PackedTangentVertex packed;
+    PackPosition(vertex, scale, bias, packed.Position);
+    glm::vec4 frame = TangentFrameQuaternion(vertex.Normal, vertex.Tangent, vertex.Bitangent);
+    for (int i = 0; i < 4; i++)
+        packed.TangentFrame[i] = FloatToSnorm16(frame[i]);
+    packed.TexCoords[0] = FloatToHalf(vertex.TexCoords.x);
+    packed.TexCoords[1] = FloatToHalf(vertex.TexCoords.y);
+    return packed;
+}
+
+#endif
@@ -0,0 +1,77 @@
+#version 330 core
+out vec3 FragColor;
+
+in vec2 TexCoords;
+
+uniform sampler2D source;
+uniform vec2 sourceTexelSize;
+// rendered part of the source: coordinate scale, and the furthest coordinate inside it
+uniform vec4 sourceRegion;
+// the first level is the bright pass: karis average, then the threshold
+uniform bool prefilter;
+// threshold, threshold - knee, 2 * knee, 0.25 / knee
+uniform vec4 thresholdCurve;
+
+vec3 tap(vec2 uv, vec2 offset)
+{
+    return texture(source, min(uv + offset * sourceTexelSize, sourceRegion.zw)).rgb;
+}
+
+float luma(vec3 color)
+{
+    return dot(color, vec3(0.2126, 0.7152, 0.0722));
+}
+
+// averages the box with a weight of 1 / (1 + luma), so a single very bright texel can't dominate the level
+vec3 karisBox(vec3 a, vec3 b, vec3 c, vec3 d)
+{
+    vec3 sum = (a + b + c + d) * 0.25;
+    return sum / (1.0 + luma(sum));
+}
+
+// soft knee threshold: keeps the luminance over the threshold, easing in quadratically from threshold - knee
+// instead of a hard cut that makes edges of bright areas pop
+vec3 brightPass(vec3 color)
+{
+    float brightness = luma(color);
+    float soft = clamp(brightness - thresholdCurve.y, 0.0, thresholdCurve.z);
+    soft = soft * soft * thresholdCurve.w;
+    float contribution = max(soft, brightness - thresholdCurve.x) / max(brightness, 1e-4);
+    return color * contribution;
+}
+
+// 13 bilinear taps over a 6x6 texel footprint, as five overlapping 2x2 boxes (Jimenez, Next Generation Post Processing in Call of Duty)
+void main()
+{
+    vec2 uv = TexCoords * sourceRegion.xy;
+    vec3 a = tap(uv, vec2(-2.0,  2.0));
+    vec3 b = tap(uv, vec2( 0.0,  2.0));
+    vec3 c = tap(uv, vec2( 2.0,  2.0));
+    vec3 d = tap(uv, vec2(-2.0,  0.0));
+    vec3 e = tap(uv, vec2(0.0));
+    vec3 f = tap(uv, vec2( 2.0,  0.0));
+    vec3 g = tap(uv, vec2(-2.0, -2.0));
+    vec3 h = tap(uv, vec2( 0.0, -2.0));
+    vec3 i = tap(uv, vec2( 2.0, -2.0));
+    vec3 j = tap(uv, vec2(-1.0,  1.0));
+    vec3 k = tap(uv, vec2( 1.0,  1.0));
+    vec3 l = tap(uv, vec2(-1.0, -1.0));
+    vec3 m = tap(uv, vec2( 1.0, -1.0));
+
+    vec3 result;
+    if (prefilter)
+    {
+        result = karisBox(j, k, l, m) * 0.5
+               + (karisBox(a, b, d, e) + karisBox(b, c, e, f) + karisBox(d, e, g, h) + karisBox(e, f, h, i)) * 0.125;
+        // undo the weighting on the average, keeps the overall brightness
+        result = brightPass(result / max(1.0 - luma(result), 1e-4));
+    }
+    else
+    {
+        result = e * 0.125;
+        result += (a + c + g + i) * 0.03125;
+        result += (b + d + f + h) * 0.0625;
+        result += (j + k + l + m) * 0.125;
+    }
+    FragColor = max(result, vec3(0.0));
+}
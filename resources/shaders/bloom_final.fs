@@ -6,18 +6,45 @@ in vec2 TexCoords;
 uniform sampler2D scene;
 uniform sampler2D bloomBlur;
 uniform bool bloom;
+uniform float bloomIntensity;
 uniform float exposure;
+// rendered parts of the scene and the bloom: coordinate scale, and the furthest coordinate inside them
+uniform vec4 sceneRegion;
+uniform vec4 bloomRegion;
+uniform vec2 sceneTexelSize;
+// how much the upscaled scene is sharpened, 0 at full resolution
+uniform float sharpness;
+// tone curve, grading and display gamma, indexed by log2(color + lutShaper.x) * lutShaper.y + lutShaper.z
+uniform sampler3D colorLut;
+uniform vec3 lutShaper;
+uniform float lutSize;
+
+vec3 sceneTap(vec2 uv, vec2 offset)
+{
+    return texture(scene, min(uv + offset * sceneTexelSize, sceneRegion.zw)).rgb;
+}
 
 void main()
-{             
-    const float gamma = 2.2;
-    vec3 hdrColor = texture(scene, TexCoords).rgb;      
-    vec3 bloomColor = texture(bloomBlur, TexCoords).rgb;
+{
+    vec2 uv = TexCoords * sceneRegion.xy;
+    vec3 hdrColor = sceneTap(uv, vec2(0.0));
+    if(sharpness > 0.0)
+    {
+        // unsharp mask over the four neighbours, the bilinear upscale alone looks soft. kept within the
+        // neighbours' range so edges don't get halos
+        vec3 n = sceneTap(uv, vec2(0.0, 1.0));
+        vec3 s = sceneTap(uv, vec2(0.0, -1.0));
+        vec3 e = sceneTap(uv, vec2(1.0, 0.0));
+        vec3 w = sceneTap(uv, vec2(-1.0, 0.0));
+        vec3 sharpened = hdrColor + (4.0 * hdrColor - (n + s + e + w)) * 0.25 * sharpness;
+        vec3 low = min(hdrColor, min(min(n, s), min(e, w)));
+        vec3 high = max(hdrColor, max(max(n, s), max(e, w)));
+        hdrColor = clamp(sharpened, low, high);
+    }
     if(bloom)
-        hdrColor += bloomColor; // additive blending
-    // tone mapping
-    vec3 result = vec3(1.0) - exp(-hdrColor * exposure);
-    // also gamma correct while we're at it       
-    result = pow(result, vec3(1.0 / gamma));
+        hdrColor += texture(bloomBlur, min(TexCoords * bloomRegion.xy, bloomRegion.zw)).rgb * bloomIntensity; // additive blending
+    // tone mapping and grading in one lookup, the coordinate moved onto the centres of the end texels
+    vec3 lutCoord = clamp(log2(hdrColor * exposure + lutShaper.x) * lutShaper.y + lutShaper.z, 0.0, 1.0);
+    vec3 result = texture(colorLut, lutCoord * ((lutSize - 1.0) / lutSize) + 0.5 / lutSize).rgb;
     FragColor = vec4(result, 1.0);
-}
\ No newline at end of file
+}
@@ -0,0 +1,26 @@
+#version 330 core
+out vec3 FragColor;
+
+in vec2 TexCoords;
+
+uniform sampler2D source;
+uniform vec2 sourceTexelSize;
+// rendered part of the source: coordinate scale, and the furthest coordinate inside it
+uniform vec4 sourceRegion;
+uniform float radius;
+
+vec3 tap(vec2 uv, vec2 offset)
+{
+    return texture(source, min(uv + offset * sourceTexelSize, sourceRegion.zw)).rgb;
+}
+
+// 3x3 tent over the smaller level, blended additively onto the larger one
+void main()
+{
+    vec2 uv = TexCoords * sourceRegion.xy;
+    vec2 t = vec2(radius);
+    vec3 result = tap(uv, vec2(0.0)) * 4.0;
+    result += (tap(uv, vec2( t.x, 0.0)) + tap(uv, vec2(-t.x, 0.0)) + tap(uv, vec2(0.0, t.y)) + tap(uv, vec2(0.0, -t.y))) * 2.0;
+    result += tap(uv, vec2(-t.x, t.y)) + tap(uv, vec2(t.x, t.y)) + tap(uv, vec2(-t.x, -t.y)) + tap(uv, vec2(t.x, -t.y));
+    FragColor = result / 16.0;
+}
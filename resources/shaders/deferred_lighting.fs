@@ -0,0 +1,183 @@
+#version 330 core
+layout (location = 0) out vec4 FragColor;
+// the light structs are std140 laid out like their mirrors in uniform_buffers.h, a float after every vec3
+struct PointLight {
+    vec3 position;
+    float constant;
+    vec3 ambient;
+    float linear;
+    vec3 diffuse;
+    float quadratic;
+    vec3 specular;
+};
+struct SpotLight {
+    vec3 position;
+    float constant;
+    vec3 direction;
+    float linear;
+    vec3 ambient;
+    float quadratic;
+    vec3 diffuse;
+    float cutOff;
+    vec3 specular;
+    float outerCutOff;
+};
+struct DirLight {
+    vec3 direction;
+    vec3 ambient;
+    vec3 diffuse;
+    vec3 specular;
+};
+
+// surface read from the G-buffer
+struct Surface {
+    vec3 position;
+    vec3 normal;
+    vec3 albedo;
+    float specular;
+    float shininess;
+};
+
+in vec2 TexCoords;
+
+// written by gbuffer.fs, into the gBufferScale part of the textures
+uniform vec2 gBufferScale;
+uniform sampler2D gAlbedoSpecular;
+uniform sampler2D gNormalShininess;
+uniform sampler2D gDepth;
+// clip space back to world space
+uniform mat4 inverseViewProjection;
+
+// per frame constants, FrameUniforms in uniform_buffers.h
+layout (std140) uniform Frame {
+    mat4 view;
+    mat4 projection;
+    vec3 viewPosition;
+    float time;
+    vec4 clusterParameters;
+};
+
+// LightsUniforms in uniform_buffers.h
+layout (std140) uniform Lights {
+    PointLight moonLight;
+    SpotLight spotLight;
+    DirLight dirLight;
+};
+
+// light clusters, see LightClusters in light_clusters.h for the layout of the buffers
+const int CLUSTER_GRID_X = 16;
+const int CLUSTER_GRID_Y = 9;
+const int CLUSTER_GRID_Z = 24;
+uniform usamplerBuffer clusterGrid;
+uniform usamplerBuffer clusterLightIndices;
+uniform samplerBuffer clusterLights;
+
+vec3 octahedralDecode(vec2 e)
+{
+    vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+    if (n.z < 0.0)
+        n.xy = (1.0 - abs(n.yx)) * vec2(n.x >= 0.0 ? 1.0 : -1.0, n.y >= 0.0 ? 1.0 : -1.0);
+    return normalize(n);
+}
+
+// same terms as model_lighting.fs, with the material values taken from the surface
+vec3 CalcPointLight(PointLight light, Surface surface, vec3 viewDir)
+{
+    vec3 lightDir = normalize(light.position - surface.position);
+    float diff = max(dot(surface.normal, lightDir), 0.0);
+    vec3 halfwayDir = normalize(lightDir + viewDir);
+    float spec = pow(max(dot(surface.normal, halfwayDir), 0.0), surface.shininess);
+    float distance = length(light.position - surface.position);
+    float attenuation = 1.0 / (light.constant + light.linear * distance + light.quadratic * (distance * distance));
+    vec3 ambient = light.ambient * surface.albedo;
+    vec3 diffuse = light.diffuse * diff * surface.albedo;
+    vec3 specular = light.specular * spec * surface.specular;
+    return (ambient + diffuse + specular) * attenuation;
+}
+
+vec3 CalcSpotLight(SpotLight light, Surface surface, vec3 viewDir)
+{
+    vec3 lightDir = normalize(light.position - surface.position);
+    float diff = max(dot(surface.normal, lightDir), 0.0);
+    vec3 halfwayDir = normalize(lightDir + viewDir);
+    float spec = pow(max(dot(surface.normal, halfwayDir), 0.0), surface.shininess);
+    float distance = length(light.position - surface.position);
+    float attenuation = 1.0 / (light.constant + light.linear * distance + light.quadratic * (distance * distance));
+    float theta = dot(lightDir, normalize(-light.direction));
+    float epsilon = light.cutOff - light.outerCutOff;
+    float intensity = clamp((theta - light.outerCutOff) / epsilon, 0.0, 1.0);
+    vec3 ambient = light.ambient * surface.albedo;
+    vec3 diffuse = light.diffuse * diff * surface.albedo;
+    vec3 specular = light.specular * spec * surface.specular;
+    return (ambient + diffuse + specular) * attenuation * intensity;
+}
+
+vec3 CalcDirLight(DirLight light, Surface surface, vec3 viewDir)
+{
+    vec3 lightDir = normalize(-light.direction);
+    float diff = max(dot(surface.normal, lightDir), 0.0);
+    vec3 halfwayDir = normalize(lightDir + viewDir);
+    float spec = pow(max(dot(surface.normal, halfwayDir), 0.0), surface.shininess);
+    vec3 ambient = light.ambient * surface.albedo;
+    vec3 diffuse = light.diffuse * diff * surface.albedo;
+    vec3 specular = light.specular * spec * surface.specular;
+    return ambient + diffuse + specular;
+}
+
+vec3 CalcClusterLights(Surface surface, vec3 viewDir)
+{
+    float depth = -(view * vec4(surface.position, 1.0)).z;
+    ivec3 cell = ivec3(gl_FragCoord.xy / clusterParameters.zw, log(depth) * clusterParameters.x + clusterParameters.y);
+    cell = clamp(cell, ivec3(0), ivec3(CLUSTER_GRID_X - 1, CLUSTER_GRID_Y - 1, CLUSTER_GRID_Z - 1));
+    uvec2 range = texelFetch(clusterGrid, (cell.z * CLUSTER_GRID_Y + cell.y) * CLUSTER_GRID_X + cell.x).xy;
+
+    vec3 result = vec3(0.0);
+    for (uint i = 0u; i < range.y; i++)
+    {
+        int light = int(texelFetch(clusterLightIndices, int(range.x + i)).x) * 3;
+        vec4 positionRange = texelFetch(clusterLights, light);
+        vec4 colorInner = texelFetch(clusterLights, light + 1);
+        vec4 directionOuter = texelFetch(clusterLights, light + 2);
+
+        vec3 toLight = positionRange.xyz - surface.position;
+        float distance = length(toLight);
+        vec3 lightDir = toLight / max(distance, 0.0001);
+        float window = clamp(1.0 - pow(distance / positionRange.w, 4.0), 0.0, 1.0);
+        float attenuation = window * window / (1.0 + distance * distance);
+        float theta = dot(lightDir, -directionOuter.xyz);
+        attenuation *= clamp((theta - directionOuter.w) / (colorInner.w - directionOuter.w), 0.0, 1.0);
+
+        float diff = max(dot(surface.normal, lightDir), 0.0);
+        vec3 halfwayDir = normalize(lightDir + viewDir);
+        float spec = pow(max(dot(surface.normal, halfwayDir), 0.0), surface.shininess);
+        result += colorInner.rgb * attenuation * (diff * surface.albedo + spec * surface.specular);
+    }
+    return result;
+}
+
+void main()
+{
+    vec2 uv = TexCoords * gBufferScale;
+    float depth = texture(gDepth, uv).r;
+    // nothing was drawn here, the sky fills it later
+    if (depth == 1.0)
+        discard;
+
+    vec4 clip = inverseViewProjection * vec4(vec3(TexCoords, depth) * 2.0 - 1.0, 1.0);
+    vec4 albedoSpecular = texture(gAlbedoSpecular, uv);
+    vec4 normalShininess = texture(gNormalShininess, uv);
+    Surface surface;
+    surface.position = clip.xyz / clip.w;
+    surface.normal = octahedralDecode(normalShininess.xy);
+    surface.albedo = albedoSpecular.rgb;
+    surface.specular = albedoSpecular.a;
+    surface.shininess = normalShininess.z;
+
+    vec3 viewDir = normalize(viewPosition - surface.position);
+    vec3 result = CalcPointLight(moonLight, surface, viewDir);
+    result += CalcSpotLight(spotLight, surface, viewDir);
+    result += CalcDirLight(dirLight, surface, viewDir);
+    result += CalcClusterLights(surface, viewDir);
+
+    FragColor = vec4(result, 1.0);
+}
@@ -0,0 +1,29 @@
+#version 330 core
+layout (location = 0) in vec3 aPos;
+
+// per frame constants, FrameUniforms in uniform_buffers.h
+layout (std140) uniform Frame {
+    mat4 view;
+    mat4 projection;
+    vec3 viewPosition;
+    float time;
+    vec4 clusterParameters;
+};
+// ObjectUniforms in uniform_buffers.h
+layout (std140) uniform Object {
+    mat4 model;
+};
+
+// packed positions are quantized to the mesh bounds
+uniform vec3 positionScale = vec3(1.0);
+uniform vec3 positionBias = vec3(0.0);
+
+// computed exactly like in model_lighting.vs, so the color pass can test the depth with GL_EQUAL
+invariant gl_Position;
+
+void main()
+{
+    vec3 position = positionBias + positionScale * aPos;
+    vec3 fragPos = vec3(model * vec4(position, 1.0));
+    gl_Position = projection * view * vec4(fragPos, 1.0);
+}
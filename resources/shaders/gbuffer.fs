@@ -0,0 +1,31 @@
+#version 330 core
+// G-buffer of the deferred path, read back by deferred_lighting.fs
+layout (location = 0) out vec4 AlbedoSpecular;
+layout (location = 1) out vec4 NormalShininess;
+
+struct Material {
+    sampler2D texture_diffuse1;
+    sampler2D texture_specular1;
+
+    float shininess;
+};
+in vec2 TexCoords;
+in vec3 Normal;
+in vec3 FragPos;
+
+uniform Material material;
+
+// unit vector to the octahedron folded onto [-1, 1]^2, the inverse of octahedralDecode in model_lighting.vs
+vec2 octahedralEncode(vec3 n)
+{
+    n /= abs(n.x) + abs(n.y) + abs(n.z);
+    if (n.z < 0.0)
+        n.xy = (1.0 - abs(n.yx)) * vec2(n.x >= 0.0 ? 1.0 : -1.0, n.y >= 0.0 ? 1.0 : -1.0);
+    return n.xy;
+}
+
+void main()
+{
+    AlbedoSpecular = vec4(texture(material.texture_diffuse1, TexCoords).rgb, texture(material.texture_specular1, TexCoords).r);
+    NormalShininess = vec4(octahedralEncode(normalize(Normal)), material.shininess, 1.0);
+}
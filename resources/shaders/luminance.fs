@@ -0,0 +1,26 @@
+#version 330 core
+out float FragColor;
+
+in vec2 TexCoords;
+
+uniform sampler2D scene;
+// rendered part of the scene: coordinate scale, and the furthest coordinate inside it
+uniform vec4 sceneRegion;
+// part of the scene one texel of the target covers
+uniform vec2 footprint;
+
+float logLuminance(vec2 uv)
+{
+    vec3 color = texture(scene, min(uv, sceneRegion.zw)).rgb;
+    return log2(max(dot(color, vec3(0.2126, 0.7152, 0.0722)), 1e-5));
+}
+
+// log2 luminance of the texel's footprint, from four bilinear taps of 2x2 texels each. the target is sized so
+// the footprint is at most 4x4 scene texels, which the taps then cover completely
+void main()
+{
+    vec2 uv = TexCoords * sceneRegion.xy;
+    vec2 q = footprint * 0.25;
+    FragColor = 0.25 * (logLuminance(uv + vec2(-q.x, -q.y)) + logLuminance(uv + vec2(q.x, -q.y))
+                      + logLuminance(uv + vec2(-q.x, q.y)) + logLuminance(uv + vec2(q.x, q.y)));
+}
@@ -0,0 +1,12 @@
+#version 330 core
+out float FragColor;
+
+in vec2 TexCoords;
+
+uniform sampler2D source;
+
+// the target is half the size of the source, so the bilinear tap at its texel centre averages 2x2 source texels
+void main()
+{
+    FragColor = texture(source, TexCoords).r;
+}
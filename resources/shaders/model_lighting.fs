@@ -1,34 +1,29 @@
 #version 330 core
 layout (location = 0) out vec4 FragColor;
-layout (location = 1) out vec4 BrightColor;
+// the light structs are std140 laid out like their mirrors in uniform_buffers.h, a float after every vec3
 struct PointLight {
     vec3 position;
-
-    vec3 specular;
-    vec3 diffuse;
-    vec3 ambient;
-
     float constant;
+    vec3 ambient;
     float linear;
+    vec3 diffuse;
     float quadratic;
+    vec3 specular;
 };
 struct SpotLight {
     vec3 position;
-    vec3 direction;
-    float cutOff;
-    float outerCutOff;
-
     float constant;
+    vec3 direction;
     float linear;
-    float quadratic;
-
     vec3 ambient;
+    float quadratic;
     vec3 diffuse;
+    float cutOff;
     vec3 specular;
+    float outerCutOff;
 };
 struct DirLight {
     vec3 direction;
-
     vec3 ambient;
     vec3 diffuse;
     vec3 specular;
@@ -44,15 +39,35 @@ in vec2 TexCoords;
 in vec3 Normal;
 in vec3 FragPos;
 
-uniform PointLight pointLight[2];
 uniform Material material;
-uniform SpotLight spotLight;
-uniform DirLight dirLight;
 
-uniform vec3 viewPosition;
+// per frame constants, FrameUniforms in uniform_buffers.h
+layout (std140) uniform Frame {
+    mat4 view;
+    mat4 projection;
+    vec3 viewPosition;
+    float time;
+    vec4 clusterParameters;
+};
+
+// LightsUniforms in uniform_buffers.h
+layout (std140) uniform Lights {
+    PointLight moonLight;
+    SpotLight spotLight;
+    DirLight dirLight;
+};
+
+// light clusters, see LightClusters in light_clusters.h for the layout of the buffers
+const int CLUSTER_GRID_X = 16;
+const int CLUSTER_GRID_Y = 9;
+const int CLUSTER_GRID_Z = 24;
+uniform usamplerBuffer clusterGrid;
+uniform usamplerBuffer clusterLightIndices;
+uniform samplerBuffer clusterLights;
 
 vec3 CalcSpotLight(SpotLight light, vec3 normal, vec3 fragPos, vec3 viewDir);
 vec3 CalcDirLight(DirLight light, vec3 normal, vec3 viewDir);
+vec3 CalcClusterLights(vec3 normal, vec3 fragPos, vec3 viewDir);
 
 // calculates the color when using a point light.
 vec3 CalcPointLight(PointLight light, vec3 normal, vec3 fragPos, vec3 viewDir)
@@ -83,15 +98,10 @@ void main()
 {
     vec3 normal = normalize(Normal);
     vec3 viewDir = normalize(viewPosition - FragPos);
-    vec3 result = CalcPointLight(pointLight[0], normal, FragPos, viewDir);
-    result += CalcPointLight(pointLight[1], normal, FragPos, viewDir);
+    vec3 result = CalcPointLight(moonLight, normal, FragPos, viewDir);
     result+=CalcSpotLight(spotLight,normal,FragPos,viewDir);
     result+= CalcDirLight(dirLight, normal, viewDir);
-    float brightness = dot(result, vec3(0.2126, 0.7152, 0.0722));
-        if(brightness > 1.0)
-            BrightColor = vec4(result, 1.0);
-        else
-            BrightColor = vec4(0.0, 0.0, 0.0, 1.0);
+    result += CalcClusterLights(normal, FragPos, viewDir);
 
     FragColor = vec4(result, 1.0);
 }
@@ -137,3 +147,37 @@ vec3 CalcDirLight(DirLight light, vec3 normal, vec3 viewDir)
     vec3 specular = light.specular * spec * vec3(texture(material.texture_specular1, TexCoords));
     return (ambient + diffuse + specular);
 }
+
+// the lights of the fragment's cluster. they have no ambient term and fade out smoothly at their range.
+vec3 CalcClusterLights(vec3 normal, vec3 fragPos, vec3 viewDir)
+{
+    float depth = -(view * vec4(fragPos, 1.0)).z;
+    ivec3 cell = ivec3(gl_FragCoord.xy / clusterParameters.zw, log(depth) * clusterParameters.x + clusterParameters.y);
+    cell = clamp(cell, ivec3(0), ivec3(CLUSTER_GRID_X - 1, CLUSTER_GRID_Y - 1, CLUSTER_GRID_Z - 1));
+    uvec2 range = texelFetch(clusterGrid, (cell.z * CLUSTER_GRID_Y + cell.y) * CLUSTER_GRID_X + cell.x).xy;
+
+    vec3 diffuseColor = vec3(texture(material.texture_diffuse1, TexCoords));
+    vec3 specularColor = vec3(texture(material.texture_specular1, TexCoords));
+    vec3 result = vec3(0.0);
+    for (uint i = 0u; i < range.y; i++)
+    {
+        int light = int(texelFetch(clusterLightIndices, int(range.x + i)).x) * 3;
+        vec4 positionRange = texelFetch(clusterLights, light);
+        vec4 colorInner = texelFetch(clusterLights, light + 1);
+        vec4 directionOuter = texelFetch(clusterLights, light + 2);
+
+        vec3 toLight = positionRange.xyz - fragPos;
+        float distance = length(toLight);
+        vec3 lightDir = toLight / max(distance, 0.0001);
+        float window = clamp(1.0 - pow(distance / positionRange.w, 4.0), 0.0, 1.0);
+        float attenuation = window * window / (1.0 + distance * distance);
+        float theta = dot(lightDir, -directionOuter.xyz);
+        attenuation *= clamp((theta - directionOuter.w) / (colorInner.w - directionOuter.w), 0.0, 1.0);
+
+        float diff = max(dot(normal, lightDir), 0.0);
+        vec3 halfwayDir = normalize(lightDir + viewDir);
+        float spec = pow(max(dot(normal, halfwayDir), 0.0), material.shininess);
+        result += colorInner.rgb * attenuation * (diff * diffuseColor + spec * specularColor);
+    }
+    return result;
+}
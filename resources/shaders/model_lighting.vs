@@ -2,19 +2,61 @@
 layout (location = 0) in vec3 aPos;
 layout (location = 1) in vec3 aNormal;
 layout (location = 2) in vec2 aTexCoords;
+layout (location = 3) in vec4 aTangentFrame;
 
 out vec2 TexCoords;
 out vec3 Normal;
 out vec3 FragPos;
 
-uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
+// per frame constants, FrameUniforms in uniform_buffers.h
+layout (std140) uniform Frame {
+    mat4 view;
+    mat4 projection;
+    vec3 viewPosition;
+    float time;
+    vec4 clusterParameters;
+};
+// ObjectUniforms in uniform_buffers.h
+layout (std140) uniform Object {
+    mat4 model;
+};
+
+// vertex layout, same values as Vertex_Format in vertex_format.h
+const int VERTEX_FULL = 0;
+const int VERTEX_PACKED = 1;
+const int VERTEX_PACKED_QTANGENT = 2;
+uniform int vertexFormat = VERTEX_FULL;
+// packed positions are quantized to the mesh bounds
+uniform vec3 positionScale = vec3(1.0);
+uniform vec3 positionBias = vec3(0.0);
+
+// the depth prepass (depth_prepass.vs) computes the same position, the color pass may test it with GL_EQUAL
+invariant gl_Position;
+
+vec3 octahedralDecode(vec2 e)
+{
+    vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+    if (n.z < 0.0)
+        n.xy = (1.0 - abs(n.yx)) * vec2(n.x >= 0.0 ? 1.0 : -1.0, n.y >= 0.0 ? 1.0 : -1.0);
+    return normalize(n);
+}
+
+// z axis rotated by the tangent frame quaternion
+vec3 tangentFrameNormal(vec4 q)
+{
+    return vec3(2.0 * (q.x * q.z + q.w * q.y), 2.0 * (q.y * q.z - q.w * q.x), 1.0 - 2.0 * (q.x * q.x + q.y * q.y));
+}
 
 void main()
 {
-    FragPos = vec3(model * vec4(aPos, 1.0));
+    vec3 position = positionBias + positionScale * aPos;
     Normal = aNormal;
+    if (vertexFormat == VERTEX_PACKED)
+        Normal = octahedralDecode(aNormal.xy);
+    else if (vertexFormat == VERTEX_PACKED_QTANGENT)
+        Normal = tangentFrameNormal(normalize(aTangentFrame));
+
+    FragPos = vec3(model * vec4(position, 1.0));
     TexCoords = aTexCoords;    
     gl_Position = projection * view * vec4(FragPos, 1.0);
-}
\ No newline at end of file
+}
@@ -0,0 +1,28 @@
+#version 330 core
+layout (location = 0) in vec3 aPos;
+layout (location = 1) in vec2 aTexCoords;
+// per instance, see VegetationInstance in vegetation_renderer.h
+layout (location = 2) in vec4 aPositionScale;
+layout (location = 3) in float aRotation;
+
+out vec2 TexCoords;
+
+// per frame constants, FrameUniforms in uniform_buffers.h
+layout (std140) uniform Frame {
+    mat4 view;
+    mat4 projection;
+    vec3 viewPosition;
+    float time;
+    vec4 clusterParameters;
+};
+
+void main()
+{
+    TexCoords = aTexCoords;
+    // rotation around the y axis, like glm::rotate(model, aRotation, vec3(0, 1, 0))
+    float s = sin(aRotation);
+    float c = cos(aRotation);
+    vec3 rotated = vec3(c * aPos.x + s * aPos.z, aPos.y, -s * aPos.x + c * aPos.z);
+    vec3 worldPos = aPositionScale.xyz + aPositionScale.w * rotated;
+    gl_Position = projection * view * vec4(worldPos, 1.0);
+}
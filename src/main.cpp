@@ -9,11 +9,24 @@
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
 
+#include <learnopengl/auto_exposure.h>
+#include <learnopengl/bloom_renderer.h>
 #include <learnopengl/filesystem.h>
+#include <learnopengl/gpu_profiler.h>
 #include <learnopengl/shader.h>
 #include <learnopengl/camera.h>
+#include <learnopengl/color_lut.h>
+#include <learnopengl/dynamic_resolution.h>
+#include <learnopengl/light_clusters.h>
 #include <learnopengl/model.h>
-
+#include <learnopengl/model_loader.h>
+#include <learnopengl/render_graph.h>
+#include <learnopengl/texture_registry.h>
+#include <learnopengl/thread_pool.h>
+#include <learnopengl/uniform_buffers.h>
+#include <learnopengl/vegetation_renderer.h>
+
+#include <cmath>
 #include <iostream>
 
 //funkcije
@@ -27,12 +40,14 @@ void processInput(GLFWwindow *window);
 
 void key_callback(GLFWwindow *window, int key, int scancode, int action, int mods);
 
-unsigned int loadTexture(char const * path);
+TextureHandle loadTexture(char const * path);
 
-unsigned int loadCubemap(vector<std::string> faces);
+TextureHandle loadCubemap(ThreadPool &pool, vector<std::string> faces);
 
 void renderQuad();
 
+void addSceneLights(vector<ClusteredLight> &lights, float time, const Model &ufo, const glm::mat4 &modelufo);
+
 // osnovna podesavanja globalne
 
 //const unsigned int SCR_WIDTH = 800;
@@ -43,14 +58,14 @@ const unsigned int SCR_HEIGHT = 800;
 unsigned  int Width = SCR_WIDTH;
 unsigned  int Height = SCR_HEIGHT;
 
+const float NEAR_PLANE = 0.1f;
+const float FAR_PLANE = 1000.0f;
+
 bool hdr = true;
 float exposure = 1.0f;
 
 bool bloom = true;
 bool bloomKeyPressed = false;
-unsigned int pingpongColorbuffers[2];
-unsigned int colorBuffers[2];
-unsigned int rboDepth;
 
 
 // kamera
@@ -80,6 +95,34 @@ struct ProgramState {
     Camera camera;
     bool CameraMouseMovementUpdateEnabled = true;
     PointLight pointLight;
+    // odsecanje mesheva van vidnog polja, brojaci se prikazuju u ImGui
+    FrustumCuller culler;
+    unsigned int visibleVegetation = 0;
+    unsigned int totalVegetation = 0;
+    RenderQueueStats queueStats;
+    RenderGraphStats graphStats;
+    LightClusterStats lightStats;
+    // deferred umesto forward sencenja, G ili ImGui
+    bool deferred = false;
+    // dubina modela se crta pre boje, P ili ImGui
+    bool depthPrepass = false;
+    // rezolucija scene se smanjuje kad GPU ne stigne u zadato vreme, R ili ImGui
+    bool dynamicResolution = true;
+    float targetFrameMs = 16.0f;
+    float sharpness = 0.5f;
+    // ekspozicija se meri iz scene, Q/E je pomeraju za po jedan stop u sekundi
+    AutoExposureSettings exposureSettings;
+    float sceneLuminance = 0.0f;
+    float renderScale = 1.0f;
+    float gpuFrameTime = 0.0f;
+    float frameTime = 0.0f;
+    // GPU vreme svakog prolaza, iz upita od pre nekoliko frejmova; dugme u ImGui ih snima kao Chrome trace
+    vector<GpuTiming> gpuTimings;
+    bool exportGpuTrace = false;
+    // nivoi, radijus, prag i jacina bloom-a
+    BloomSettings bloomSettings;
+    // tonska kriva, balans bele, kontrast, zasicenje i lift/gamma/gain, zapeceni u 3D LUT
+    ColorGradingSettings gradingSettings;
     ProgramState()
             : camera(glm::vec3(139.0f, 36.0f, 28.0f)) {}
 };
@@ -148,72 +191,68 @@ int main() {
     glEnable(GL_CULL_FACE);
 
 
+    // radne niti za ucitavanje modela i dekodiranje tekstura
+    ThreadPool threadPool;
+
     // build and compile shaders
     // -------------------------
 
     Shader ourShader("resources/shaders/model_lighting.vs", "resources/shaders/model_lighting.fs");
 
-    Shader shader ("resources/shaders/blending.vs","resources/shaders/blending.fs");
+    Shader shader ("resources/shaders/vegetation.vs","resources/shaders/blending.fs");
 
     Shader skyboxShader("resources/shaders/skybox.vs", "resources/shaders/skybox.fs");
 
     Shader shaderLight("resources/shaders/model_lighting.vs", "resources/shaders/light_box.fs");
 
-    Shader shaderBlur("resources/shaders/blur.vs", "resources/shaders/blur.fs");
-
     Shader shaderBloomFinal("resources/shaders/bloom_final.vs", "resources/shaders/bloom_final.fs");
 
-
-    unsigned int hdrFBO;
-    glGenFramebuffers(1, &hdrFBO);
-    glBindFramebuffer(GL_FRAMEBUFFER, hdrFBO);
-
-
-    glGenTextures(2, colorBuffers);
-    for (unsigned int i = 0; i < 2; i++)
-    {
-        glBindTexture(GL_TEXTURE_2D, colorBuffers[i]);
-        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA16F, SCR_WIDTH, SCR_HEIGHT, 0, GL_RGBA, GL_FLOAT, NULL);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);  // we clamp to the edge as the blur filter would otherwise sample repeated texture values!
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-        // attach texture to framebuffer
-        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0 + i, GL_TEXTURE_2D, colorBuffers[i], 0);
-    }
-    // create and attach depth buffer (renderbuffer)
-
-    glGenRenderbuffers(1, &rboDepth);
-    glBindRenderbuffer(GL_RENDERBUFFER, rboDepth);
-    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT, SCR_WIDTH, SCR_HEIGHT);
-    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, rboDepth);
-    // tell OpenGL which color attachments we'll use (of this framebuffer) for rendering
-    unsigned int attachments[2] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1 };
-    glDrawBuffers(2, attachments);
-    // finally check if framebuffer is complete
-    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
-        std::cout << "Framebuffer not complete!" << std::endl;
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
-
-    // ping-pong-framebuffer for blurring
-    unsigned int pingpongFBO[2];
-
-    glGenFramebuffers(2, pingpongFBO);
-    glGenTextures(2, pingpongColorbuffers);
-    for (unsigned int i = 0; i < 2; i++)
-    {
-        glBindFramebuffer(GL_FRAMEBUFFER, pingpongFBO[i]);
-        glBindTexture(GL_TEXTURE_2D, pingpongColorbuffers[i]);
-        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA16F, SCR_WIDTH, SCR_HEIGHT, 0, GL_RGBA, GL_FLOAT, NULL);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE); // we clamp to the edge as the blur filter would otherwise sample repeated texture values!
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, pingpongColorbuffers[i], 0);
-        // also check if framebuffers are complete (no need for depth buffer)
-        if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
-            std::cout << "Framebuffer not complete!" << std::endl;
-    }
+    Shader gBufferShader("resources/shaders/model_lighting.vs", "resources/shaders/gbuffer.fs");
+
+    Shader deferredShader("resources/shaders/bloom_final.vs", "resources/shaders/deferred_lighting.fs");
+
+    Shader depthShader("resources/shaders/depth_prepass.vs", "resources/shaders/depth_prepass.fs");
+
+    // uniform blokovi zajednicki za sve sejdere
+    BindUniformBlocks(ourShader);
+    BindUniformBlocks(shader);
+    BindUniformBlocks(skyboxShader);
+    BindUniformBlocks(shaderLight);
+    BindUniformBlocks(gBufferShader);
+    BindUniformBlocks(deferredShader);
+    BindUniformBlocks(depthShader);
+    UniformBlock<FrameUniforms> frameBlock(FRAME_BLOCK_BINDING);
+    UniformBlock<LightsUniforms> lightsBlock(LIGHTS_BLOCK_BINDING);
+    ObjectUniformBuffer objectBuffer;
+    RenderQueue renderQueue;
+    // vidljive kutije svih modela, iz jednog odsecanja po frejmu
+    vector<unsigned int> visibleBoxes;
+    // mala svetla (NLO, stala, zrak) se dele po klasterima vidnog polja
+    LightClusters lightClusters;
+    vector<ClusteredLight> sceneLights;
+    ourShader.use();
+    SetClusterSamplers(ourShader);
+    deferredShader.use();
+    SetClusterSamplers(deferredShader);
+    deferredShader.setInt("gAlbedoSpecular", 0);
+    deferredShader.setInt("gNormalShininess", 1);
+    deferredShader.setInt("gDepth", 2);
+
+
+    // prolazi frejma sa teksturama koje citaju i pisu; mete prolaza su iz zajednickog skupa tekstura
+    RenderGraph renderGraph;
+
+    // bloom preko lanca sve manjih tekstura
+    BloomRenderer bloomRenderer;
+    // razmera rezolucije scene prema GPU vremenu frejma
+    DynamicResolution dynamicResolution;
+    // ekspozicija prema osvetljenosti scene, procitanoj sa GPU-a frejm ili dva kasnije
+    AutoExposure autoExposure;
+    // tonsko mapiranje i korekcija boja u jednoj 3D teksturi, ponovo se racuna samo kad se podesavanja promene
+    ColorLut colorLut;
+    // GPU vreme frejma i svakog prolaza grafa
+    GpuProfiler gpuProfiler;
+    renderGraph.SetProfiler(&gpuProfiler);
 
 
     float skyboxVertices[] = {
@@ -284,7 +323,7 @@ int main() {
             };
 
 
-    unsigned int cubemapTexture = loadCubemap(faces);
+    TextureHandle cubemapTexture = loadCubemap(threadPool, faces);
 
     skyboxShader.use();
     skyboxShader.setInt("skybox", 0);
@@ -298,45 +337,45 @@ int main() {
             1.0f, -0.5f,  0.0f,  1.0f,  1.0f,
             1.0f,  0.5f,  0.0f,  1.0f,  0.0f
     };
-    vector<glm::vec3> vegetation;
+    // kukuruz se crta instancirano, jednim pozivom za sve stabljike
+    vector<VegetationInstance> vegetation;
     for(int i=0;i<8;i++){
         for(int j=0;j<5;j++){
-            vegetation.push_back(glm::vec3(32.0f-i*7,15.0f,84.5f+10*j));
+            vegetation.push_back(VegetationInstance{glm::vec3(32.0f-i*7,15.0f,84.5f+10*j), 12.0f, glm::radians(90.0f)});
 
         }
     }
-    unsigned int transparentVAO, transparentVBO;
-    glGenVertexArrays(1, &transparentVAO);
-    glGenBuffers(1, &transparentVBO);
-    glBindVertexArray(transparentVAO);
-    glBindBuffer(GL_ARRAY_BUFFER, transparentVBO);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(transparentVertices), transparentVertices, GL_STATIC_DRAW);
-    glEnableVertexAttribArray(0);
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void*)0);
-    glEnableVertexAttribArray(1);
-    glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void*)(3 * sizeof(float)));
-    glBindVertexArray(0);
+    VegetationRenderer vegetationRenderer(transparentVertices, 6);
+    vegetationRenderer.SetInstances(vegetation);
 
-    unsigned int transparentTexture = loadTexture(FileSystem::getPath("resources/textures/kukuruz.png").c_str());
+    TextureHandle transparentTexture = loadTexture(FileSystem::getPath("resources/textures/kukuruz.png").c_str());
     shader.use();
     shader.setInt("texture1", 0);
 
     // UCITAVANJE MODELA
     // -----------
-    Model platforma("resources/objects/10438_Circular_Grass_Patch_v1_L3.123c72c0e679-bb4b-4162-b0f0-a70f7575d7d8/10438_Circular_Grass_Patch_v1_iterations-2.obj");
-    platforma.SetShaderTextureNamePrefix("material.");
+    // modeli se ucitavaju u pozadini, a iscrtavaju se cim stignu
+    ModelLoader modelLoader(threadPool);
+
+    AsyncModel platforma = modelLoader.Load("resources/objects/10438_Circular_Grass_Patch_v1_L3.123c72c0e679-bb4b-4162-b0f0-a70f7575d7d8/10438_Circular_Grass_Patch_v1_iterations-2.obj");
+    platforma->SetShaderTextureNamePrefix("material.");
+    platforma->SetVertexFormat(VERTEX_PACKED);
 
-    Model ufo ("resources/objects/UFO_Saucer_v1_L2.123c50bd261a-1751-44c1-b973-f0dd9e11cecd/13884_UFO_Saucer_v1_l2.obj");
-    ufo.SetShaderTextureNamePrefix("material.");
+    AsyncModel ufo = modelLoader.Load("resources/objects/UFO_Saucer_v1_L2.123c50bd261a-1751-44c1-b973-f0dd9e11cecd/13884_UFO_Saucer_v1_l2.obj");
+    ufo->SetShaderTextureNamePrefix("material.");
+    ufo->SetVertexFormat(VERTEX_PACKED);
 
-    Model krava ("resources/objects/cow/cowTM08New00RTime02.obj");
-    krava.SetShaderTextureNamePrefix("material.");
+    AsyncModel krava = modelLoader.Load("resources/objects/cow/cowTM08New00RTime02.obj");
+    krava->SetShaderTextureNamePrefix("material.");
+    krava->SetVertexFormat(VERTEX_PACKED);
 
-    Model barn ("resources/objects/Rbarn15_TexturesAB/textures/Rbarn15.obj");
-    barn.SetShaderTextureNamePrefix("material.");
+    AsyncModel barn = modelLoader.Load("resources/objects/Rbarn15_TexturesAB/textures/Rbarn15.obj");
+    barn->SetShaderTextureNamePrefix("material.");
+    barn->SetVertexFormat(VERTEX_PACKED);
 
-    Model mesec ("resources/objects/moon/moon.obj");
-    mesec.SetShaderTextureNamePrefix("material.");
+    AsyncModel mesec = modelLoader.Load("resources/objects/moon/moon.obj");
+    mesec->SetShaderTextureNamePrefix("material.");
+    mesec->SetVertexFormat(VERTEX_PACKED);
 
     //point svetlo
 
@@ -352,85 +391,90 @@ int main() {
 
 
 
-    shaderBlur.use();
-    shaderBlur.setInt("image", 0);
     shaderBloomFinal.use();
     shaderBloomFinal.setInt("scene", 0);
     shaderBloomFinal.setInt("bloomBlur", 1);
+    shaderBloomFinal.setInt("colorLut", 2);
+    shaderBloomFinal.setVec3("lutShaper", ColorLut::ShaperParameters());
+    shaderBloomFinal.setFloat("lutSize", (float) COLOR_LUT_SIZE);
     while (!glfwWindowShouldClose(window)) {
         // per-frame time logic
         // --------------------
         float currentFrame = glfwGetTime();
         deltaTime = currentFrame - lastFrame;
         lastFrame = currentFrame;
+        programState->frameTime = programState->frameTime * 0.95f + deltaTime * 1000.0f * 0.05f;
 
         // input
         // -----
         processInput(window);
 
-        // render
-        // ------
-        glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
-        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-
+        // modeli koji su ucitani u pozadini dobijaju GL objekte, jedan po frejmu
+        modelLoader.ProcessCompleted(1);
 
+        autoExposure.Update(deltaTime, programState->exposureSettings);
+        exposure = autoExposure.Exposure();
+        colorLut.Update(programState->gradingSettings, threadPool);
+        programState->sceneLuminance = autoExposure.AverageLuminance();
 
-        glBindFramebuffer(GL_FRAMEBUFFER, hdrFBO);
-        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-
-        ourShader.use();
-
-        // POINT SVETLA
+        // render
+        // ------
 
-        pointLight.position = glm::vec3(4.0 * cos(currentFrame), 4.0f, 4.0 * sin(currentFrame));
-        ourShader.setVec3("pointLight[0].position", pointLight.position);
-        ourShader.setVec3("pointLight[0].ambient", glm::vec3(0.0f));
-        ourShader.setVec3("pointLight[0].diffuse", glm::vec3(0.0f));
-        ourShader.setVec3("pointLight[0].specular", glm::vec3(0.0f));
-        ourShader.setFloat("pointLight[0].constant", pointLight.constant);
-        ourShader.setFloat("pointLight[0].linear", pointLight.linear);
-        ourShader.setFloat("pointLight[0].quadratic", pointLight.quadratic);
-        ourShader.setVec3("viewPosition", programState->camera.Position);
-        ourShader.setFloat("material.shininess", 32.0f);
+        // scena se crta u deo tekstura velicine prozora, prema GPU vremenu prethodnih frejmova
+        dynamicResolution.Enabled = programState->dynamicResolution;
+        dynamicResolution.TargetMs = programState->targetFrameMs;
+        float renderScale = dynamicResolution.Scale();
+        unsigned int renderWidth = std::max((unsigned int) std::ceil(Width * renderScale), 1u);
+        unsigned int renderHeight = std::max((unsigned int) std::ceil(Height * renderScale), 1u);
 
+        // view/projection transformations
+        glm::mat4 projection = glm::perspective(glm::radians(programState->camera.Zoom),
+                                                (float) Width / (float) Height, NEAR_PLANE, FAR_PLANE);
+        glm::mat4 view = programState->camera.GetViewMatrix();
+        // za izbor nivoa detalja modela i odsecanje
+        LodView lodView = MakeLodView(programState->camera.Position, projection, (float) renderHeight);
+        FrustumCuller &culler = programState->culler;
+        culler.SetFrustum(programState->camera.GetFrustum(projection));
+        culler.ResetStats();
+
+        // podaci frejma i svetla idu u uniform bafere jednom po frejmu, vide ih svi sejderi
+        FrameUniforms frame;
+        frame.view = view;
+        frame.projection = projection;
+        frame.viewPosition = programState->camera.Position;
+        frame.time = currentFrame;
+
+        LightsUniforms lights;
         //MESEC
-        ourShader.setVec3("pointLight[1].position", glm::vec3(-50.0f, 150.0f, -200.0f));
-        ourShader.setVec3("pointLight[1].ambient", glm::vec3(70.0f));
-        ourShader.setVec3("pointLight[1].diffuse", pointLight.diffuse);
-        ourShader.setVec3("pointLight[1].specular", pointLight.specular);
-        ourShader.setFloat("pointLight[1].constant", pointLight.constant);
-        ourShader.setFloat("pointLight[1].linear", pointLight.linear);
-        ourShader.setFloat("pointLight[1].quadratic", pointLight.quadratic);
+        lights.moonLight.position = glm::vec3(-50.0f, 150.0f, -200.0f);
+        lights.moonLight.ambient = glm::vec3(70.0f);
+        lights.moonLight.diffuse = pointLight.diffuse;
+        lights.moonLight.specular = pointLight.specular;
+        lights.moonLight.constant = pointLight.constant;
+        lights.moonLight.linear = pointLight.linear;
+        lights.moonLight.quadratic = pointLight.quadratic;
 
 
 
         // SPOT LAJT IZ LETELICE
-        ourShader.setVec3("spotLight.position", glm::vec3(0.0f,61.781075f, 0.0f));
-        ourShader.setVec3("spotLight.direction", glm::vec3(0.0f,-1.0f, 0.0f));
-        ourShader.setVec3("spotLight.ambient", 0.0f, 10.0f, 0.0f);
-        ourShader.setVec3("spotLight.diffuse", 0.0f, 50.0f, 0.0f);
-        ourShader.setVec3("spotLight.specular", 0.0f, 10.0f, 0.0f);
-        ourShader.setFloat("spotLight.constant", 1.0f);
-        ourShader.setFloat("spotLight.linear", 0.09);
-        ourShader.setFloat("spotLight.quadratic", 0.032);
-        ourShader.setFloat("spotLight.cutOff", glm::cos(glm::radians(20.5f)));
-        ourShader.setFloat("spotLight.outerCutOff", glm::cos(glm::radians(30.0f)));
+        lights.spotLight.position = glm::vec3(0.0f,61.781075f, 0.0f);
+        lights.spotLight.direction = glm::vec3(0.0f,-1.0f, 0.0f);
+        lights.spotLight.ambient = glm::vec3(0.0f, 10.0f, 0.0f);
+        lights.spotLight.diffuse = glm::vec3(0.0f, 50.0f, 0.0f);
+        lights.spotLight.specular = glm::vec3(0.0f, 10.0f, 0.0f);
+        lights.spotLight.constant = 1.0f;
+        lights.spotLight.linear = 0.09;
+        lights.spotLight.quadratic = 0.032;
+        lights.spotLight.cutOff = glm::cos(glm::radians(20.5f));
+        lights.spotLight.outerCutOff = glm::cos(glm::radians(30.0f));
 
         //dir lajt
 
-        ourShader.setVec3("dirLight.direction", -0.2f, -1.0f, -0.3f);
-        ourShader.setVec3("dirLight.ambient", 0.02f, 0.02f, 0.02f);
-        ourShader.setVec3("dirLight.diffuse", 0.04f, 0.04f, 0.04f);
-        ourShader.setVec3("dirLight.specular", 0.5f, 0.5f, 0.5f);
-
-
-
-        // view/projection transformations
-        glm::mat4 projection = glm::perspective(glm::radians(programState->camera.Zoom),
-                                                (float) Width / (float) Height, 0.1f, 1000.0f);
-        glm::mat4 view = programState->camera.GetViewMatrix();
-        ourShader.setMat4("projection", projection);
-        ourShader.setMat4("view", view);
+        lights.dirLight.direction = glm::vec3(-0.2f, -1.0f, -0.3f);
+        lights.dirLight.ambient = glm::vec3(0.02f, 0.02f, 0.02f);
+        lights.dirLight.diffuse = glm::vec3(0.04f, 0.04f, 0.04f);
+        lights.dirLight.specular = glm::vec3(0.5f, 0.5f, 0.5f);
+        lightsBlock.Update(lights);
 
 
         // PLATFORMA
@@ -442,9 +486,6 @@ int main() {
         modelplatforma=glm::rotate(modelplatforma,glm::radians(270.0f),glm::vec3(1,0,0));
         modelplatforma = glm::translate(modelplatforma,glm::vec3(0.0f));
 
-        ourShader.setMat4("model", modelplatforma);
-        platforma.Draw(ourShader);
-
         //NLO
 
         glm::mat4 modelufo = glm::mat4(1.0f);
@@ -457,9 +498,6 @@ int main() {
         //  modelufo = glm::translate(modelufo,glm::vec3(0.0f,0.0f, 600.0f+50*(sin(glfwGetTime()))));
         modelufo = glm::translate(modelufo,glm::vec3(0.0f,0.0f, 600.0f));
 
-        ourShader.setMat4("model", modelufo);
-        ufo.Draw(ourShader);
-
         //krava
 
         glm::mat4 modelkrava = glm::mat4(1.0f);
@@ -471,10 +509,6 @@ int main() {
         modelkrava=glm::rotate(modelkrava,(float)glfwGetTime(),glm::vec3(0,0,1));
         modelkrava=glm::rotate(modelkrava,(float)glfwGetTime(),glm::vec3(1,0,0));
 
-
-        ourShader.setMat4("model", modelkrava);
-        krava.Draw(ourShader);
-
         //barn
 
         glm::mat4 modelbarn = glm::mat4(1.0f);
@@ -483,10 +517,6 @@ int main() {
         modelbarn = glm::scale(modelbarn, glm::vec3(0.04f));
         modelbarn=glm::rotate(modelbarn,glm::radians(90.0f),glm::vec3(0,1,0));
 
-
-        ourShader.setMat4("model", modelbarn);
-        barn.Draw(ourShader);
-
         //mesec
 
         glm::mat4 modelmesec = glm::mat4(1.0f);
@@ -494,89 +524,171 @@ int main() {
         modelmesec = glm::translate(modelmesec,glm::vec3(-50.0f, 150.0f, -200.0f));
         modelmesec = glm::scale(modelmesec, glm::vec3(25.0f));
 
-        ourShader.setMat4("model", modelmesec);
-        mesec.Draw(ourShader);
-
-
-
-        glDisable(GL_CULL_FACE);
-
-        //BILJE
-        shader.use();
-        glm::mat4 projection1 = glm::perspective(glm::radians(programState->camera.Zoom), (float)Width / (float)Height, 0.1f, 100.0f);
-        glm::mat4 view1 = programState->camera.GetViewMatrix();
-        glm::mat4 model = glm::mat4(1.0f);
-        shader.setMat4("projection", projection);
-        shader.setMat4("view", view);
-
-        glBindVertexArray(transparentVAO);
-        glBindTexture(GL_TEXTURE_2D, transparentTexture);
-        glm::mat4 modeltrava = glm::mat4(1.0f);
-
-        for (unsigned int i = 0; i < vegetation.size(); i++)
-        {
-            modeltrava = glm::mat4(1.0f);
-            modeltrava= glm::translate(modeltrava, vegetation[i]);
-            modeltrava=glm::scale(modeltrava,glm::vec3 (12.0f));
-            modeltrava=glm::rotate(modeltrava,glm::radians(90.0f),glm::vec3(0,1,0));
-            ourShader.setMat4("model", modeltrava);
-            glDrawArrays(GL_TRIANGLES, 0, 6);
+        // svetla se razvrstavaju po klasterima na radnim nitima, sejder gleda samo svetla svog klastera
+        sceneLights.clear();
+        addSceneLights(sceneLights, currentFrame, ufo.Get(), modelufo);
+        lightClusters.Update(sceneLights, view, projection, NEAR_PLANE, FAR_PLANE, renderWidth, renderHeight, threadPool);
+        programState->lightStats = lightClusters.Stats();
+        frame.clusterParameters = lightClusters.ShaderParameters();
+        frameBlock.Update(frame);
+
+        // matrice svih objekata idu u jedan bafer, pred crtanje se vezuje samo opseg objekta
+        objectBuffer.Clear();
+        unsigned int objplatforma = objectBuffer.Push(ObjectUniforms{modelplatforma});
+        unsigned int objufo = objectBuffer.Push(ObjectUniforms{modelufo});
+        unsigned int objkrava = objectBuffer.Push(ObjectUniforms{modelkrava});
+        unsigned int objbarn = objectBuffer.Push(ObjectUniforms{modelbarn});
+        unsigned int objmesec = objectBuffer.Push(ObjectUniforms{modelmesec});
+        objectBuffer.Upload();
+
+        // modeli se u deferred nacinu crtaju u G-bafer, a osvetljavaju jednim prolazom preko ekrana
+        bool deferred = programState->deferred;
+        Shader &modelShader = deferred ? gBufferShader : ourShader;
+
+        // sve ide u red za iscrtavanje, koji ih sortira po stanju i daljini pre crtanja.
+        // sa prepass-om red prvo crta dubinu modela, pa boju samo tamo gde je dubina jednaka
+        renderQueue.SetDepthPrepass(programState->depthPrepass ? &depthShader : nullptr);
+        // kutije mesh-eva svih modela se odsecaju zajedno, pa svaki model uzima svoj deo vidljivih
+        culler.Clear();
+        platforma->AddBounds(culler, modelplatforma);
+        ufo->AddBounds(culler, modelufo);
+        krava->AddBounds(culler, modelkrava);
+        barn->AddBounds(culler, modelbarn);
+        mesec->AddBounds(culler, modelmesec);
+        culler.Cull(visibleBoxes);
+        platforma->Enqueue(renderQueue, RENDER_PASS_OPAQUE, modelShader, objplatforma, modelplatforma, lodView, visibleBoxes);
+        ufo->Enqueue(renderQueue, RENDER_PASS_OPAQUE, modelShader, objufo, modelufo, lodView, visibleBoxes);
+        krava->Enqueue(renderQueue, RENDER_PASS_OPAQUE, modelShader, objkrava, modelkrava, lodView, visibleBoxes);
+        barn->Enqueue(renderQueue, RENDER_PASS_OPAQUE, modelShader, objbarn, modelbarn, lodView, visibleBoxes);
+        mesec->Enqueue(renderQueue, RENDER_PASS_OPAQUE, modelShader, objmesec, modelmesec, lodView, visibleBoxes);
+
+        // graf frejma: scena u HDR teksturu, bloom, pa tonemapiranje na ekran. prolazi se izvrsavaju tek u Execute
+        renderGraph.Begin(Width, Height, renderScale);
+        RenderTextureDesc hdrDesc;
+        RenderTextureDesc depthDesc;
+        depthDesc.format = GL_DEPTH_COMPONENT24;
+        RenderResource hdrColor = renderGraph.CreateTexture("HDR color", hdrDesc);
+        RenderResource depth = renderGraph.CreateTexture("depth", depthDesc);
+        RenderResource backbuffer = renderGraph.ImportBackbuffer();
+        RenderQueueStats queueStats;
+
+        if (deferred) {
+            // albedo + specular intensity, octahedral normal + shininess, and the depth the lighting reads
+            RenderTextureDesc albedoDesc;
+            albedoDesc.format = GL_RGBA8;
+            albedoDesc.filter = GL_NEAREST;
+            RenderTextureDesc normalDesc;
+            normalDesc.filter = GL_NEAREST;
+            RenderResource gAlbedoSpecular = renderGraph.CreateTexture("G-buffer albedo", albedoDesc);
+            RenderResource gNormalShininess = renderGraph.CreateTexture("G-buffer normal", normalDesc);
+            renderGraph.AddPass("G-buffer", [&](RenderGraph &) {
+                renderQueue.Submit(objectBuffer);
+                queueStats += renderQueue.Stats();
+            }).Write(gAlbedoSpecular).Write(gNormalShininess).Write(depth);
+
+            renderGraph.AddPass("Deferred lighting", [&, gAlbedoSpecular, gNormalShininess](RenderGraph &graph) {
+                glDisable(GL_DEPTH_TEST);
+                deferredShader.use();
+                deferredShader.setMat4("inverseViewProjection", glm::inverse(projection * view));
+                glm::vec4 region = graph.Region(depth);
+                deferredShader.setVec2("gBufferScale", region.x, region.y);
+                const RenderResource gBuffer[3] = { gAlbedoSpecular, gNormalShininess, depth };
+                for (unsigned int i = 0; i < 3; i++) {
+                    glActiveTexture(GL_TEXTURE0 + i);
+                    glBindTexture(GL_TEXTURE_2D, graph.Texture(gBuffer[i]));
+                }
+                renderQuad();
+                glActiveTexture(GL_TEXTURE0);
+                glEnable(GL_DEPTH_TEST);
+            }).Read(gAlbedoSpecular).Read(gNormalShininess).Read(depth).Write(hdrColor);
+        } else {
+            renderGraph.AddPass("Forward", [&](RenderGraph &) {
+                renderQueue.Submit(objectBuffer);
+                queueStats += renderQueue.Stats();
+            }).Write(hdrColor).Write(depth);
         }
 
-        glEnable(GL_CULL_FACE);
-
-        //SKAJBOX
-
-        glDepthFunc(GL_LEQUAL);
-        skyboxShader.use();
-        view = glm::mat4(glm::mat3(programState->camera.GetViewMatrix()));
-        skyboxShader.setMat4("view", view);
-        skyboxShader.setMat4("projection", projection);
-
-        // skybox cube
-        glBindVertexArray(skyboxVAO);
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_CUBE_MAP, cubemapTexture);
-        glDrawArrays(GL_TRIANGLES, 0, 36);
-        glBindVertexArray(0);
-        glDepthFunc(GL_LESS);
-
-
-
-
-        glBindFramebuffer(GL_FRAMEBUFFER, 0);
-
-
-        bool horizontal = true, first_iteration = true;
-        unsigned int amount = 10;
-        shaderBlur.use();
-        for (unsigned int i = 0; i < amount; i++)
-        {
-            glBindFramebuffer(GL_FRAMEBUFFER, pingpongFBO[horizontal]);
-            shaderBlur.setInt("horizontal", horizontal);
-            glBindTexture(GL_TEXTURE_2D, first_iteration ? colorBuffers[1] : pingpongColorbuffers[!horizontal]);
+        // bilje i nebo se crtaju preko osvetljene scene, sa dubinom modela
+        renderGraph.AddPass("Vegetation and sky", [&](RenderGraph &) {
+            //BILJE
+            renderQueue.PushCustom(RENDER_PASS_CUTOUT, shader, 0.0f, [&]() {
+                GpuProfileScope scope(gpuProfiler, "Vegetation");
+                glDisable(GL_CULL_FACE);
+                glActiveTexture(GL_TEXTURE0);
+                glBindTexture(GL_TEXTURE_2D, transparentTexture.ID());
+                vegetationRenderer.Draw(culler.GetFrustum());
+                glEnable(GL_CULL_FACE);
+            });
+
+            //SKAJBOX
+            renderQueue.PushCustom(RENDER_PASS_SKY, skyboxShader, 0.0f, [&]() {
+                GpuProfileScope scope(gpuProfiler, "Skybox");
+                glDepthFunc(GL_LEQUAL);
+                // skybox cube
+                glBindVertexArray(skyboxVAO);
+                glActiveTexture(GL_TEXTURE0);
+                glBindTexture(GL_TEXTURE_CUBE_MAP, cubemapTexture.ID());
+                glDrawArrays(GL_TRIANGLES, 0, 36);
+                glBindVertexArray(0);
+                glDepthFunc(GL_LESS);
+            });
+
+            renderQueue.Submit(objectBuffer);
+            queueStats += renderQueue.Stats();
+        }).Write(hdrColor).Write(depth);
+
+        // bez bloom-a niko ne cita njegovu teksturu, pa graf odbacuje sve njegove prolaze
+        RenderResource bloomTexture = bloomRenderer.AddPasses(renderGraph, hdrColor, programState->bloomSettings);
+        autoExposure.AddPasses(renderGraph, hdrColor);
+        RenderPassBuilder tonemap = renderGraph.AddPass("Tonemap", [&](RenderGraph &graph) {
+            shaderBloomFinal.use();
+            glActiveTexture(GL_TEXTURE0);
+            glBindTexture(GL_TEXTURE_2D, graph.Texture(hdrColor));
+            glActiveTexture(GL_TEXTURE1);
+            glBindTexture(GL_TEXTURE_2D, bloom ? graph.Texture(bloomTexture) : 0);
+            glActiveTexture(GL_TEXTURE2);
+            glBindTexture(GL_TEXTURE_3D, colorLut.Texture());
+            glActiveTexture(GL_TEXTURE0);
+            shaderBloomFinal.setInt("bloom", bloom);
+            shaderBloomFinal.setFloat("bloomIntensity", programState->bloomSettings.intensity);
+            shaderBloomFinal.setFloat("exposure", exposure);
+            // manja scena se razvlaci na ceo ekran i izostrava, sve jace sto je manja
+            shaderBloomFinal.setVec4("sceneRegion", graph.Region(hdrColor));
+            shaderBloomFinal.setVec4("bloomRegion", graph.Region(bloomTexture));
+            shaderBloomFinal.setVec2("sceneTexelSize", 1.0f / graph.Width(hdrColor), 1.0f / graph.Height(hdrColor));
+            shaderBloomFinal.setFloat("sharpness", programState->sharpness * glm::clamp((1.0f - renderScale) * 4.0f, 0.0f, 1.0f));
             renderQuad();
-            horizontal = !horizontal;
-            if (first_iteration)
-                first_iteration = false;
-        }
-        glBindFramebuffer(GL_FRAMEBUFFER, 0);
-
-        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-        shaderBloomFinal.use();
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, colorBuffers[0]);
-        glActiveTexture(GL_TEXTURE1);
-        glBindTexture(GL_TEXTURE_2D, pingpongColorbuffers[!horizontal]);
-        shaderBloomFinal.setInt("bloom", bloom);
-        shaderBloomFinal.setFloat("exposure", exposure);
-        renderQuad();
+        });
+        tonemap.Read(hdrColor).Write(backbuffer);
+        if (bloom)
+            tonemap.Read(bloomTexture);
+
+        lightClusters.Bind();
+        dynamicResolution.BeginFrame();
+        gpuProfiler.BeginFrame();
+        renderGraph.Execute();
+        dynamicResolution.EndFrame();
+        programState->renderScale = renderScale;
+        programState->gpuFrameTime = dynamicResolution.GpuMs();
+        programState->queueStats = queueStats;
+        programState->graphStats = renderGraph.Stats();
+        programState->visibleVegetation = vegetationRenderer.VisibleInstances();
+        programState->totalVegetation = vegetationRenderer.InstanceCount();
 
         std::cout << "bloom: " << (bloom ? "on" : "off") << "| exposure: " << exposure << std::endl;
 
 
-        if (programState->ImGuiEnabled)
+        if (programState->ImGuiEnabled) {
+            GpuProfileScope scope(gpuProfiler, "ImGui");
             DrawImGui(programState);
+        }
+        gpuProfiler.EndFrame();
+        programState->gpuTimings = gpuProfiler.Timings();
+        if (programState->exportGpuTrace) {
+            programState->exportGpuTrace = false;
+            if (gpuProfiler.WriteChromeTrace("gpu_trace.json"))
+                std::cout << "GPU trace: gpu_trace.json" << std::endl;
+        }
 
         glfwSwapBuffers(window);
         glfwPollEvents();
@@ -588,8 +700,17 @@ int main() {
     ImGui::DestroyContext();
     glDeleteVertexArrays(1, &skyboxVAO);
     glDeleteBuffers(1, &skyboxVBO);
-    glDeleteVertexArrays(1, &transparentVAO);
-    glDeleteBuffers(1, &transparentVBO);
+    vegetationRenderer.Release();
+    frameBlock.Release();
+    lightsBlock.Release();
+    objectBuffer.Release();
+    lightClusters.Release();
+    bloomRenderer.Release();
+    renderGraph.Release();
+    dynamicResolution.Release();
+    autoExposure.Release();
+    colorLut.Release();
+    gpuProfiler.Release();
 
     // glfw: terminate, clearing all previously allocated GLFW resources.
     // ------------------------------------------------------------------
@@ -613,16 +734,14 @@ void processInput(GLFWwindow *window) {
         programState->camera.ProcessKeyboard(RIGHT, deltaTime);
 
 
+    float &compensation = programState->exposureSettings.compensation;
     if (glfwGetKey(window, GLFW_KEY_Q) == GLFW_PRESS)
     {
-        if (exposure > 0.0f)
-            exposure -= 0.001f;
-        else
-            exposure = 0.0f;
+        compensation = std::max(compensation - deltaTime, -5.0f);
     }
     else if (glfwGetKey(window, GLFW_KEY_E) == GLFW_PRESS)
     {
-        exposure += 0.001f;
+        compensation = std::min(compensation + deltaTime, 5.0f);
     }
 
     if (glfwGetKey(window, GLFW_KEY_B) == GLFW_PRESS && !bloomKeyPressed)
@@ -643,21 +762,7 @@ void framebuffer_size_callback(GLFWwindow *window, int width, int height) {
     // height will be significantly larger than specified on retina displays.
     Width=width;
     Height=height;
-    for(int i=0;i<2;i++){
-
-        glBindTexture(GL_TEXTURE_2D, colorBuffers[i]);
-        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA16F, Width, Height, 0, GL_RGBA, GL_FLOAT, NULL);
-    }
-
-    glBindRenderbuffer(GL_RENDERBUFFER, rboDepth);
-    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT, Width, Height);
-
-    for(int i=0;i<2;i++){
-
-        glBindTexture(GL_TEXTURE_2D, pingpongColorbuffers[i]);
-        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA16F, Width, Height, 0, GL_RGBA, GL_FLOAT, NULL);
-    }
-
+    // mete prolaza graf sam pravi u novoj velicini, a stare brise
     glViewport(0, 0, width, height);
 }
 
@@ -699,11 +804,62 @@ void DrawImGui(ProgramState *programState) {
     ImGui::Checkbox("Camera mouse update", &programState->CameraMouseMovementUpdateEnabled);
     ImGui::End();
 
+    ImGui::Begin("GPU profiler");
+    for (const GpuTiming &timing : programState->gpuTimings)
+        ImGui::Text("%*s%-*s %7.3f ms", (int) timing.depth * 2, "", 24 - (int) timing.depth * 2, timing.name.c_str(), timing.averageMs);
+    if (ImGui::Button("Export Chrome trace"))
+        programState->exportGpuTrace = true;
+    ImGui::End();
+
+    ImGui::Begin("Rendering");
+    ImGui::Text("Frame: %.2f ms", programState->frameTime);
+    ImGui::Checkbox("Deferred shading (G)", &programState->deferred);
+    ImGui::Checkbox("Depth prepass (P)", &programState->depthPrepass);
+    ImGui::Checkbox("Dynamic resolution (R)", &programState->dynamicResolution);
+    ImGui::SliderFloat("Target GPU time (ms)", &programState->targetFrameMs, 8.0f, 33.0f);
+    ImGui::SliderFloat("Upscale sharpness", &programState->sharpness, 0.0f, 1.0f);
+    ImGui::Text("Render scale: %.2f, GPU: %.2f ms", programState->renderScale, programState->gpuFrameTime);
+    ImGui::Checkbox("Auto exposure", &programState->exposureSettings.enabled);
+    ImGui::SliderFloat("Exposure compensation (Q/E)", &programState->exposureSettings.compensation, -5.0f, 5.0f);
+    ImGui::Text("Exposure: %.3f, scene luminance: %.4f", exposure, programState->sceneLuminance);
+    BloomSettings &bloomSettings = programState->bloomSettings;
+    ImGui::SliderInt("Bloom levels", &bloomSettings.levels, 1, BLOOM_MAX_LEVELS);
+    ImGui::SliderFloat("Bloom radius", &bloomSettings.radius, 0.5f, 3.0f);
+    ImGui::SliderFloat("Bloom threshold", &bloomSettings.threshold, 0.0f, 4.0f);
+    ImGui::SliderFloat("Bloom knee", &bloomSettings.knee, 0.0f, 1.0f);
+    ImGui::SliderFloat("Bloom intensity", &bloomSettings.intensity, 0.0f, 1.0f);
+    ColorGradingSettings &grading = programState->gradingSettings;
+    ImGui::SliderFloat("Temperature", &grading.temperature, -1.0f, 1.0f);
+    ImGui::SliderFloat("Tint", &grading.tint, -1.0f, 1.0f);
+    ImGui::SliderFloat("Contrast", &grading.contrast, 0.5f, 2.0f);
+    ImGui::SliderFloat("Saturation", &grading.saturation, 0.0f, 2.0f);
+    ImGui::SliderFloat3("Lift", &grading.lift.x, -0.2f, 0.2f);
+    ImGui::SliderFloat3("Gamma", &grading.gamma.x, 0.5f, 2.0f);
+    ImGui::SliderFloat3("Gain", &grading.gain.x, 0.5f, 2.0f);
+    const RenderGraphStats &graph = programState->graphStats;
+    ImGui::Text("Passes: %u, %u culled", graph.passes - graph.culledPasses, graph.culledPasses);
+    ImGui::Text("Targets: %u in %u textures (%.1f MB)", graph.textures, graph.pooledTextures, graph.pooledBytes / (1024.0f * 1024.0f));
+    ImGui::Text("Meshes: %u visible, %u culled", programState->culler.Visible(), programState->culler.Culled());
+    ImGui::Text("Vegetation: %u / %u instances", programState->visibleVegetation, programState->totalVegetation);
+    const RenderQueueStats &queue = programState->queueStats;
+    ImGui::Text("Draw items: %u", queue.items);
+    ImGui::Text("Changes: %u programs, %u materials, %u VAOs", queue.programChanges, queue.materialChanges, queue.geometryChanges);
+    const LightClusterStats &lights = programState->lightStats;
+    ImGui::Text("Lights: %u, %u in clusters, %u / %u clusters lit", lights.lights, lights.indices, lights.occupiedClusters, CLUSTER_COUNT);
+    ImGui::Text("Most lights in a cluster: %u (%u clusters over %u)", lights.maxPerCluster, lights.overflows, CLUSTER_MAX_LIGHTS);
+    ImGui::End();
+
     ImGui::Render();
     ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
 }
 
 void key_callback(GLFWwindow *window, int key, int scancode, int action, int mods) {
+    if (key == GLFW_KEY_G && action == GLFW_PRESS)
+        programState->deferred = !programState->deferred;
+    if (key == GLFW_KEY_P && action == GLFW_PRESS)
+        programState->depthPrepass = !programState->depthPrepass;
+    if (key == GLFW_KEY_R && action == GLFW_PRESS)
+        programState->dynamicResolution = !programState->dynamicResolution;
     if (key == GLFW_KEY_F1 && action == GLFW_PRESS) {
         programState->ImGuiEnabled = !programState->ImGuiEnabled;
         if (programState->ImGuiEnabled) {
@@ -715,71 +871,17 @@ void key_callback(GLFWwindow *window, int key, int scancode, int action, int mod
     }
 }
 
-unsigned int loadTexture(char const * path)
+// teksture idu kroz globalni registar, pa se iste slike ne ucitavaju dva puta
+TextureHandle loadTexture(char const * path)
 {
-    unsigned int textureID;
-    glGenTextures(1, &textureID);
-
-    int width, height, nrComponents;
-    unsigned char *data = stbi_load(path, &width, &height, &nrComponents, 0);
-    if (data)
-    {
-        GLenum format;
-        if (nrComponents == 1)
-            format = GL_RED;
-        else if (nrComponents == 3)
-            format = GL_RGB;
-        else if (nrComponents == 4)
-            format = GL_RGBA;
-
-        glBindTexture(GL_TEXTURE_2D, textureID);
-        glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
-        glGenerateMipmap(GL_TEXTURE_2D);
-
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, format == GL_RGBA ? GL_CLAMP_TO_EDGE : GL_REPEAT); // for this tutorial: use GL_CLAMP_TO_EDGE to prevent semi-transparent borders. Due to interpolation it takes texels from next repeat
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, format == GL_RGBA ? GL_CLAMP_TO_EDGE : GL_REPEAT);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-        stbi_image_free(data);
-    }
-    else
-    {
-        std::cout << "Texture failed to load at path: " << path << std::endl;
-        stbi_image_free(data);
-    }
-
-    return textureID;
+    // for this tutorial: use GL_CLAMP_TO_EDGE to prevent semi-transparent borders. Due to interpolation it takes texels from next repeat
+    return TextureRegistry::Instance().Get2D(path, nullptr, TEXTURE_2D_CLAMP_TRANSPARENT);
 }
 
-unsigned int loadCubemap(vector<std::string> faces)
+// sve strane se dekodiraju paralelno
+TextureHandle loadCubemap(ThreadPool &pool, vector<std::string> faces)
 {
-    unsigned int textureID;
-    glGenTextures(1, &textureID);
-    glBindTexture(GL_TEXTURE_CUBE_MAP, textureID);
-
-    int width, height, nrChannels;
-    for (unsigned int i = 0; i < faces.size(); i++)
-    {
-        unsigned char *data = stbi_load(faces[i].c_str(), &width, &height, &nrChannels, 0);
-        if (data)
-        {
-            glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, GL_RGB, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, data);
-            stbi_image_free(data);
-        }
-        else
-        {
-            std::cout << "Cubemap texture failed to load at path: " << faces[i] << std::endl;
-            stbi_image_free(data);
-        }
-    }
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
-
-    return textureID;
+    return TextureRegistry::Instance().GetCubemap(pool, faces);
 }
 unsigned int quadVAO = 0;
 unsigned int quadVBO;
@@ -808,4 +910,51 @@ void renderQuad()
     glBindVertexArray(quadVAO);
     glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
     glBindVertexArray(0);
-}
\ No newline at end of file
+}
+
+// svetla za klastere: svetla oko oboda letelice, lampe oko stale i svetla koja se penju kroz zrak
+void addSceneLights(vector<ClusteredLight> &lights, float time, const Model &ufo, const glm::mat4 &modelufo)
+{
+    const unsigned int UFO_LIGHTS = 256;
+    const unsigned int LAMP_ROWS = 32;
+    const unsigned int BEAM_SPIRALS = 4;
+    const unsigned int BEAM_LIGHTS_PER_SPIRAL = 150;
+
+    // obod letelice iz granica njenih mesheva, svetla se okrecu zajedno sa njom
+    if (!ufo.meshes.empty()) {
+        glm::vec3 low(1e30f), high(-1e30f);
+        for (const Mesh &mesh : ufo.meshes) {
+            low = glm::min(low, mesh.boundsMin);
+            high = glm::max(high, mesh.boundsMax);
+        }
+        float rim = 0.5f * max(high.x - low.x, high.y - low.y);
+        glm::vec3 center = (low + high) * 0.5f;
+        for (unsigned int i = 0; i < UFO_LIGHTS; i++) {
+            float angle = glm::radians(360.0f) * i / UFO_LIGHTS;
+            glm::vec3 position = glm::vec3(modelufo * glm::vec4(center.x + rim * cos(angle), center.y + rim * sin(angle), center.z, 1.0f));
+            float chase = 0.5f + 0.5f * sin(angle * 8.0f - time * 6.0f);
+            glm::vec3 color = i % 2 ? glm::vec3(3.0f, 0.3f, 0.2f) : glm::vec3(2.0f, 2.0f, 2.5f);
+            lights.push_back(MakePointLight(position, 8.0f, color * chase));
+        }
+    }
+
+    // lampe oko stale, blago trepere
+    for (unsigned int i = 0; i < LAMP_ROWS; i++) {
+        for (unsigned int j = 0; j < LAMP_ROWS; j++) {
+            glm::vec3 position(-62.0f + i * 4.0f, 10.5f, -12.0f + j * 4.0f);
+            float flicker = 0.85f + 0.15f * sin(time * 7.0f + i * 3.1f + j * 1.7f);
+            lights.push_back(MakePointLight(position, 5.0f, glm::vec3(2.0f, 1.2f, 0.5f) * flicker));
+        }
+    }
+
+    // zrak ispod letelice, svetla se spiralno penju od zemlje ka letelici i sire se ka dnu
+    for (unsigned int s = 0; s < BEAM_SPIRALS; s++) {
+        for (unsigned int i = 0; i < BEAM_LIGHTS_PER_SPIRAL; i++) {
+            float height = fmod(i * 50.0f / BEAM_LIGHTS_PER_SPIRAL + time * 8.0f, 50.0f);
+            float radius = 2.0f + (50.0f - height) * 0.3f;
+            float angle = glm::radians(360.0f) * s / BEAM_SPIRALS + height * 0.3f;
+            glm::vec3 position(radius * cos(angle), 10.0f + height, radius * sin(angle));
+            lights.push_back(MakePointLight(position, 6.0f, glm::vec3(0.3f, 2.0f, 0.4f)));
+        }
+    }
+}
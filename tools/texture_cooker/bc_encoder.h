@@ -0,0 +1,344 @@
+#ifndef BC_ENCODER_H
+#define BC_ENCODER_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+// Block compression encoders for 4x4 texel blocks of 8 bit RGBA.
+// Quality over speed is not the goal here: endpoints come from the principal axis of the block
+// colors (refined once by least squares for BC1), indices are picked by exhaustive search.
+
+typedef uint8_t BlockTexels[16][4];
+
+// principal axis of n-dimensional points via power iteration, also returns their mean
+template<int N>
+void principalAxis(const float (&points)[16][N], float (&mean)[N], float (&axis)[N])
+{
+    for (int c = 0; c < N; c++)
+    {
+        mean[c] = 0.0f;
+        for (int i = 0; i < 16; i++)
+            mean[c] += points[i][c];
+        mean[c] /= 16.0f;
+    }
+
+    float covariance[N][N] = {};
+    for (int i = 0; i < 16; i++)
+        for (int a = 0; a < N; a++)
+            for (int b = 0; b < N; b++)
+                covariance[a][b] += (points[i][a] - mean[a]) * (points[i][b] - mean[b]);
+
+    for (int c = 0; c < N; c++)
+        axis[c] = 1.0f;
+    for (int iteration = 0; iteration < 8; iteration++)
+    {
+        float next[N] = {};
+        float length = 0.0f;
+        for (int a = 0; a < N; a++)
+        {
+            for (int b = 0; b < N; b++)
+                next[a] += covariance[a][b] * axis[b];
+            length += next[a] * next[a];
+        }
+        if (length < 1e-12f)
+            break;
+        length = std::sqrt(length);
+        for (int a = 0; a < N; a++)
+            axis[a] = next[a] / length;
+    }
+}
+
+// extremes of the points projected on the axis
+template<int N>
+void axisExtremes(const float (&points)[16][N], const float (&mean)[N], const float (&axis)[N], float (&low)[N], float (&high)[N])
+{
+    float minT = 0.0f, maxT = 0.0f;
+    for (int i = 0; i < 16; i++)
+    {
+        float t = 0.0f;
+        for (int c = 0; c < N; c++)
+            t += (points[i][c] - mean[c]) * axis[c];
+        minT = std::min(minT, t);
+        maxT = std::max(maxT, t);
+    }
+    for (int c = 0; c < N; c++)
+    {
+        low[c] = std::min(255.0f, std::max(0.0f, mean[c] + axis[c] * minT));
+        high[c] = std::min(255.0f, std::max(0.0f, mean[c] + axis[c] * maxT));
+    }
+}
+
+inline uint16_t packRGB565(const float (&color)[3])
+{
+    int r = (int) std::lround(color[0] * 31.0f / 255.0f);
+    int g = (int) std::lround(color[1] * 63.0f / 255.0f);
+    int b = (int) std::lround(color[2] * 31.0f / 255.0f);
+    return (uint16_t) ((r << 11) | (g << 5) | b);
+}
+
+inline void unpackRGB565(uint16_t packed, float (&color)[3])
+{
+    int r = (packed >> 11) & 31, g = (packed >> 5) & 63, b = packed & 31;
+    color[0] = (float) ((r << 3) | (r >> 2));
+    color[1] = (float) ((g << 2) | (g >> 4));
+    color[2] = (float) ((b << 3) | (b >> 2));
+}
+
+// picks the 2 bit indices for a four color BC1 palette, returns the squared error
+inline float bc1Indices(const float (&points)[16][3], uint16_t color0, uint16_t color1, uint32_t &indices)
+{
+    float palette[4][3];
+    unpackRGB565(color0, palette[0]);
+    unpackRGB565(color1, palette[1]);
+    for (int c = 0; c < 3; c++)
+    {
+        palette[2][c] = (2.0f * palette[0][c] + palette[1][c]) / 3.0f;
+        palette[3][c] = (palette[0][c] + 2.0f * palette[1][c]) / 3.0f;
+    }
+
+    float error = 0.0f;
+    indices = 0;
+    for (int i = 0; i < 16; i++)
+    {
+        int best = 0;
+        float bestDistance = 1e30f;
+        for (int p = 0; p < 4; p++)
+        {
+            float distance = 0.0f;
+            for (int c = 0; c < 3; c++)
+                distance += (points[i][c] - palette[p][c]) * (points[i][c] - palette[p][c]);
+            if (distance < bestDistance)
+            {
+                bestDistance = distance;
+                best = p;
+            }
+        }
+        indices |= (uint32_t) best << (2 * i);
+        error += bestDistance;
+    }
+    return error;
+}
+
+inline void writeBC1(uint16_t color0, uint16_t color1, uint32_t indices, uint8_t *out)
+{
+    memcpy(out, &color0, 2);
+    memcpy(out + 2, &color1, 2);
+    memcpy(out + 4, &indices, 4);
+}
+
+// opaque RGB, 8 bytes per block
+inline void EncodeBC1(const BlockTexels &texels, uint8_t *out)
+{
+    float points[16][3];
+    for (int i = 0; i < 16; i++)
+        for (int c = 0; c < 3; c++)
+            points[i][c] = texels[i][c];
+
+    float mean[3], axis[3], low[3], high[3];
+    principalAxis(points, mean, axis);
+    axisExtremes(points, mean, axis, low, high);
+
+    uint16_t color0 = packRGB565(high), color1 = packRGB565(low);
+    if (color0 == color1)
+    {
+        // flat block, every index picks color0
+        writeBC1(color0, color1, 0, out);
+        return;
+    }
+    if (color0 < color1)
+        std::swap(color0, color1);
+    uint32_t indices;
+    float error = bc1Indices(points, color0, color1, indices);
+
+    // least squares refit of the endpoints to the chosen indices
+    const float weights[4] = {1.0f, 0.0f, 2.0f / 3.0f, 1.0f / 3.0f};
+    float aa = 0.0f, bb = 0.0f, ab = 0.0f, ax[3] = {}, bx[3] = {};
+    for (int i = 0; i < 16; i++)
+    {
+        float a = weights[(indices >> (2 * i)) & 3], b = 1.0f - a;
+        aa += a * a;
+        bb += b * b;
+        ab += a * b;
+        for (int c = 0; c < 3; c++)
+        {
+            ax[c] += a * points[i][c];
+            bx[c] += b * points[i][c];
+        }
+    }
+    float determinant = aa * bb - ab * ab;
+    if (std::fabs(determinant) > 1e-6f)
+    {
+        float refit0[3], refit1[3];
+        for (int c = 0; c < 3; c++)
+        {
+            refit0[c] = std::min(255.0f, std::max(0.0f, (ax[c] * bb - bx[c] * ab) / determinant));
+            refit1[c] = std::min(255.0f, std::max(0.0f, (bx[c] * aa - ax[c] * ab) / determinant));
+        }
+        uint16_t refitColor0 = packRGB565(refit0), refitColor1 = packRGB565(refit1);
+        if (refitColor0 < refitColor1)
+            std::swap(refitColor0, refitColor1);
+        uint32_t refitIndices;
+        if (refitColor0 != refitColor1 && bc1Indices(points, refitColor0, refitColor1, refitIndices) < error)
+        {
+            color0 = refitColor0;
+            color1 = refitColor1;
+            indices = refitIndices;
+        }
+    }
+    writeBC1(color0, color1, indices, out);
+}
+
+// one channel, 8 bytes per block; BC5 is two of these (red then green)
+inline void EncodeBC4(const BlockTexels &texels, int channel, uint8_t *out)
+{
+    int low = 255, high = 0;
+    for (int i = 0; i < 16; i++)
+    {
+        low = std::min(low, (int) texels[i][channel]);
+        high = std::max(high, (int) texels[i][channel]);
+    }
+
+    // high > low selects the eight value palette
+    int palette[8] = {high, low};
+    for (int p = 2; p < 8; p++)
+        palette[p] = ((8 - p) * high + (p - 1) * low) / 7;
+
+    uint64_t indices = 0;
+    if (high != low)
+    {
+        for (int i = 0; i < 16; i++)
+        {
+            int best = 0;
+            for (int p = 1; p < 8; p++)
+            {
+                if (std::abs(palette[p] - texels[i][channel]) < std::abs(palette[best] - texels[i][channel]))
+                    best = p;
+            }
+            indices |= (uint64_t) best << (3 * i);
+        }
+    }
+    out[0] = (uint8_t) high;
+    out[1] = (uint8_t) low;
+    for (int b = 0; b < 6; b++)
+        out[2 + b] = (uint8_t) (indices >> (8 * b));
+}
+
+// two channel (normal map XY), 16 bytes per block
+inline void EncodeBC5(const BlockTexels &texels, uint8_t *out)
+{
+    EncodeBC4(texels, 0, out);
+    EncodeBC4(texels, 1, out + 8);
+}
+
+// appends count low bits of value to a 128 bit block, least significant bit first
+struct BlockWriter {
+    uint8_t *bytes;
+    int position = 0;
+
+    explicit BlockWriter(uint8_t *bytes) : bytes(bytes)
+    {
+        memset(bytes, 0, 16);
+    }
+
+    void Write(uint32_t value, int count)
+    {
+        for (int i = 0; i < count; i++, position++)
+            bytes[position >> 3] |= (uint8_t) (((value >> i) & 1) << (position & 7));
+    }
+};
+
+// quantizes an 8 bit endpoint to 7 bits per channel plus a shared p-bit, picking the p-bit with the smaller error
+inline void bc7QuantizeEndpoint(const float (&endpoint)[4], int (&quantized)[4], int &pBit)
+{
+    float bestError = 1e30f;
+    for (int p = 0; p < 2; p++)
+    {
+        int candidate[4];
+        float error = 0.0f;
+        for (int c = 0; c < 4; c++)
+        {
+            candidate[c] = std::min(127, std::max(0, (int) std::lround((endpoint[c] - p) / 2.0f)));
+            float value = (float) ((candidate[c] << 1) | p);
+            error += (value - endpoint[c]) * (value - endpoint[c]);
+        }
+        if (error < bestError)
+        {
+            bestError = error;
+            pBit = p;
+            std::copy(candidate, candidate + 4, quantized);
+        }
+    }
+}
+
+// RGBA with alpha, 16 bytes per block. uses mode 6 only: one subset, 7.7.7.7 + p-bit endpoints, 4 bit indices.
+inline void EncodeBC7(const BlockTexels &texels, uint8_t *out)
+{
+    static const int weights[16] = {0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64};
+
+    float points[16][4];
+    for (int i = 0; i < 16; i++)
+        for (int c = 0; c < 4; c++)
+            points[i][c] = texels[i][c];
+
+    float mean[4], axis[4], low[4], high[4];
+    principalAxis(points, mean, axis);
+    axisExtremes(points, mean, axis, low, high);
+
+    int endpoints[2][4], pBits[2] = {0, 0};
+    bc7QuantizeEndpoint(low, endpoints[0], pBits[0]);
+    bc7QuantizeEndpoint(high, endpoints[1], pBits[1]);
+
+    int palette[16][4];
+    for (int p = 0; p < 16; p++)
+    {
+        for (int c = 0; c < 4; c++)
+        {
+            int e0 = (endpoints[0][c] << 1) | pBits[0], e1 = (endpoints[1][c] << 1) | pBits[1];
+            palette[p][c] = ((64 - weights[p]) * e0 + weights[p] * e1 + 32) >> 6;
+        }
+    }
+
+    int indices[16];
+    for (int i = 0; i < 16; i++)
+    {
+        int bestDistance = 1 << 30;
+        for (int p = 0; p < 16; p++)
+        {
+            int distance = 0;
+            for (int c = 0; c < 4; c++)
+                distance += (palette[p][c] - texels[i][c]) * (palette[p][c] - texels[i][c]);
+            if (distance < bestDistance)
+            {
+                bestDistance = distance;
+                indices[i] = p;
+            }
+        }
+    }
+
+    // the anchor (first) index is stored with an implicit zero top bit
+    if (indices[0] >= 8)
+    {
+        for (int c = 0; c < 4; c++)
+            std::swap(endpoints[0][c], endpoints[1][c]);
+        std::swap(pBits[0], pBits[1]);
+        for (int i = 0; i < 16; i++)
+            indices[i] = 15 - indices[i];
+    }
+
+    BlockWriter writer(out);
+    writer.Write(1 << 6, 7);
+    for (int c = 0; c < 4; c++)
+    {
+        writer.Write((uint32_t) endpoints[0][c], 7);
+        writer.Write((uint32_t) endpoints[1][c], 7);
+    }
+    writer.Write((uint32_t) pBits[0], 1);
+    writer.Write((uint32_t) pBits[1], 1);
+    writer.Write((uint32_t) indices[0], 3);
+    for (int i = 1; i < 16; i++)
+        writer.Write((uint32_t) indices[i], 4);
+}
+
+#endif
@@ -0,0 +1,331 @@
+// Offline texture cooker: converts the images under resources/objects and resources/textures into
+// block compressed KTX files (image.png -> image.png.ktx) with their whole mip chain prebuilt, which
+// the runtime uploads with glCompressedTexImage2D instead of decoding and mipmapping the source.
+//
+// usage: texture_cooker [--force] [directory...]
+//   images whose cooked file was made from the same source content are skipped unless --force is given
+
+#include <glad/glad.h>
+#include <stb_image.h>
+
+#include <learnopengl/filesystem.h>
+#include <learnopengl/hash.h>
+#include <learnopengl/ktx.h>
+#include <learnopengl/thread_pool.h>
+
+#include "bc_encoder.h"
+
+#include <dirent.h>
+#include <sys/stat.h>
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstdio>
+#include <future>
+#include <iostream>
+#include <string>
+#include <vector>
+using namespace std;
+
+enum Cook_Format {
+    COOK_BC1,
+    COOK_BC4,
+    COOK_BC4_GRAY,
+    COOK_BC5_NORMAL,
+    COOK_BC7
+};
+
+const char *const COOK_FORMAT_NAMES[] = {"BC1", "BC4", "BC4 (gray)", "BC5 (normal)", "BC7"};
+
+// RGBA mip level in floats; color channels are linear light for color images
+struct MipLevel {
+    int width;
+    int height;
+    vector<float> texels;
+};
+
+static bool isImage(const string &path)
+{
+    string extension = path.substr(path.find_last_of('.') + 1);
+    transform(extension.begin(), extension.end(), extension.begin(), ::tolower);
+    return extension == "png" || extension == "jpg" || extension == "jpeg" || extension == "tga" || extension == "bmp";
+}
+
+static void collectImages(const string &directory, vector<string> &images)
+{
+    DIR *dir = opendir(directory.c_str());
+    if (!dir)
+    {
+        cout << "ERROR::TEXTURE_COOKER:: cannot open directory " << directory << endl;
+        return;
+    }
+    while (dirent *entry = readdir(dir))
+    {
+        string name = entry->d_name;
+        if (name == "." || name == "..")
+            continue;
+        string path = directory + '/' + name;
+        struct stat info;
+        if (stat(path.c_str(), &info) != 0)
+            continue;
+        if (S_ISDIR(info.st_mode))
+            collectImages(path, images);
+        else if (isImage(path))
+            images.push_back(path);
+    }
+    closedir(dir);
+}
+
+static float srgbToLinear(float value)
+{
+    return value <= 0.04045f ? value / 12.92f : pow((value + 0.055f) / 1.055f, 2.4f);
+}
+
+static float linearToSrgb(float value)
+{
+    return value <= 0.0031308f ? value * 12.92f : 1.055f * pow(value, 1.0f / 2.4f) - 0.055f;
+}
+
+static Cook_Format chooseFormat(const string &path, int components, const unsigned char *pixels, size_t texelCount)
+{
+    if (components == 1)
+        return COOK_BC4;
+
+    string name = path.substr(path.find_last_of('/') + 1);
+    transform(name.begin(), name.end(), name.begin(), ::tolower);
+    if (name.find("norm") != string::npos)
+        return COOK_BC5_NORMAL;
+
+    bool gray = true, opaque = true;
+    for (size_t i = 0; i < texelCount; i++)
+    {
+        const unsigned char *texel = pixels + i * 4;
+        gray = gray && texel[0] == texel[1] && texel[1] == texel[2];
+        opaque = opaque && texel[3] == 255;
+    }
+    if (!opaque)
+        return COOK_BC7;
+    return gray ? COOK_BC4_GRAY : COOK_BC1;
+}
+
+// 2x2 box filter, alpha weighted so fully transparent texels don't bleed their color into cutout edges
+static MipLevel downsample(const MipLevel &source, bool normalMap)
+{
+    MipLevel level;
+    level.width = max(1, source.width / 2);
+    level.height = max(1, source.height / 2);
+    level.texels.resize((size_t) level.width * level.height * 4);
+
+    for (int y = 0; y < level.height; y++)
+    {
+        for (int x = 0; x < level.width; x++)
+        {
+            float sum[4] = {}, plain[3] = {};
+            for (int dy = 0; dy < 2; dy++)
+            {
+                for (int dx = 0; dx < 2; dx++)
+                {
+                    int sx = min(source.width - 1, x * 2 + dx), sy = min(source.height - 1, y * 2 + dy);
+                    const float *texel = &source.texels[((size_t) sy * source.width + sx) * 4];
+                    for (int c = 0; c < 3; c++)
+                    {
+                        sum[c] += texel[c] * texel[3];
+                        plain[c] += texel[c];
+                    }
+                    sum[3] += texel[3];
+                }
+            }
+
+            float *texel = &level.texels[((size_t) y * level.width + x) * 4];
+            for (int c = 0; c < 3; c++)
+                texel[c] = sum[3] > 0.0f && !normalMap ? sum[c] / sum[3] : plain[c] / 4.0f;
+            texel[3] = sum[3] / 4.0f;
+
+            if (normalMap)
+            {
+                // averaged normals get shorter, put them back on the unit sphere
+                float length = sqrt(texel[0] * texel[0] + texel[1] * texel[1] + texel[2] * texel[2]);
+                if (length > 0.0f)
+                    for (int c = 0; c < 3; c++)
+                        texel[c] /= length;
+            }
+        }
+    }
+    return level;
+}
+
+// converts a level back to 8 bit texels in the encoding the GL samples
+static vector<unsigned char> quantize(const MipLevel &level, bool color, bool normalMap)
+{
+    vector<unsigned char> pixels(level.texels.size());
+    for (size_t i = 0; i < level.texels.size(); i++)
+    {
+        float value = level.texels[i];
+        if (normalMap)
+            value = value * 0.5f + 0.5f;
+        else if (color && i % 4 != 3)
+            value = linearToSrgb(value);
+        pixels[i] = (unsigned char) lround(min(1.0f, max(0.0f, value)) * 255.0f);
+    }
+    return pixels;
+}
+
+static vector<unsigned char> encodeLevel(const vector<unsigned char> &pixels, int width, int height, Cook_Format format)
+{
+    size_t blockBytes = format == COOK_BC1 || format == COOK_BC4 || format == COOK_BC4_GRAY ? 8 : 16;
+    int blocksWide = (width + 3) / 4, blocksHigh = (height + 3) / 4;
+    vector<unsigned char> blocks((size_t) blocksWide * blocksHigh * blockBytes);
+
+    for (int by = 0; by < blocksHigh; by++)
+    {
+        for (int bx = 0; bx < blocksWide; bx++)
+        {
+            // edge blocks of odd sized levels repeat their last row and column
+            BlockTexels texels;
+            for (int i = 0; i < 16; i++)
+            {
+                int x = min(width - 1, bx * 4 + i % 4), y = min(height - 1, by * 4 + i / 4);
+                memcpy(texels[i], &pixels[((size_t) y * width + x) * 4], 4);
+            }
+
+            uint8_t *out = &blocks[((size_t) by * blocksWide + bx) * blockBytes];
+            switch (format)
+            {
+                case COOK_BC1: EncodeBC1(texels, out); break;
+                case COOK_BC4:
+                case COOK_BC4_GRAY: EncodeBC4(texels, 0, out); break;
+                case COOK_BC5_NORMAL: EncodeBC5(texels, out); break;
+                case COOK_BC7: EncodeBC7(texels, out); break;
+            }
+        }
+    }
+    return blocks;
+}
+
+// cooks one image, returns the line to report for it
+static string cook(const string &path, bool force)
+{
+    uint64_t sourceHash;
+    if (!HashFile(path, sourceHash))
+        return "ERROR::TEXTURE_COOKER:: cannot read " + path;
+
+    char hashText[17];
+    snprintf(hashText, sizeof(hashText), "%016llx", (unsigned long long) sourceHash);
+    string cookedPath = CookedTexturePath(path);
+    KtxFile existing;
+    if (!force && ReadKtx(cookedPath, existing) && existing.metadata[KTX_KEY_SOURCE_HASH] == hashText)
+        return "up to date  " + path;
+
+    int width, height, components;
+    unsigned char *data = stbi_load(path.c_str(), &width, &height, &components, 4);
+    if (!data)
+        return "ERROR::TEXTURE_COOKER:: cannot decode " + path;
+
+    Cook_Format format = chooseFormat(path, components, data, (size_t) width * height);
+    bool normalMap = format == COOK_BC5_NORMAL;
+    // single channel data (AO, reflectivity) and normals are filtered as stored, everything else in linear light
+    bool color = format != COOK_BC4 && !normalMap;
+
+    MipLevel level;
+    level.width = width;
+    level.height = height;
+    level.texels.resize((size_t) width * height * 4);
+    for (size_t i = 0; i < level.texels.size(); i++)
+    {
+        float value = data[i] / 255.0f;
+        if (normalMap)
+            value = value * 2.0f - 1.0f;
+        else if (color && i % 4 != 3)
+            value = srgbToLinear(value);
+        level.texels[i] = value;
+    }
+    stbi_image_free(data);
+
+    KtxFile ktx;
+    ktx.width = (uint32_t) width;
+    ktx.height = (uint32_t) height;
+    ktx.metadata[KTX_KEY_SOURCE_HASH] = hashText;
+    switch (format)
+    {
+        case COOK_BC1:
+            ktx.internalFormat = GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+            ktx.baseFormat = GL_RGB;
+            break;
+        case COOK_BC4:
+            ktx.internalFormat = GL_COMPRESSED_RED_RGTC1;
+            ktx.baseFormat = GL_RED;
+            break;
+        case COOK_BC4_GRAY:
+            ktx.internalFormat = GL_COMPRESSED_RED_RGTC1;
+            ktx.baseFormat = GL_RED;
+            ktx.metadata[KTX_KEY_SWIZZLE] = "rrr1";
+            break;
+        case COOK_BC5_NORMAL:
+            ktx.internalFormat = GL_COMPRESSED_RG_RGTC2;
+            ktx.baseFormat = GL_RG;
+            break;
+        case COOK_BC7:
+            ktx.internalFormat = GL_COMPRESSED_RGBA_BPTC_UNORM;
+            ktx.baseFormat = GL_RGBA;
+            break;
+    }
+
+    while (true)
+    {
+        ktx.levels.push_back(encodeLevel(quantize(level, color, normalMap), level.width, level.height, format));
+        if (level.width == 1 && level.height == 1)
+            break;
+        level = downsample(level, normalMap);
+    }
+
+    // written next to the final name first, so the runtime never sees a half written file
+    string temporaryPath = cookedPath + ".tmp";
+    if (!WriteKtx(temporaryPath, ktx) || rename(temporaryPath.c_str(), cookedPath.c_str()) != 0)
+    {
+        remove(temporaryPath.c_str());
+        return "ERROR::TEXTURE_COOKER:: cannot write " + cookedPath;
+    }
+
+    size_t sourceBytes = (size_t) width * height * (components == 1 ? 1 : 4) * 4 / 3;
+    return "cooked      " + path + " -> " + COOK_FORMAT_NAMES[format] + ", " + to_string(ktx.levels.size()) + " levels, "
+           + to_string(sourceBytes / 1024) + " KB -> " + to_string(ktx.Size() / 1024) + " KB";
+}
+
+int main(int argc, char *argv[])
+{
+    bool force = false;
+    vector<string> directories;
+    for (int i = 1; i < argc; i++)
+    {
+        string argument = argv[i];
+        if (argument == "--force")
+            force = true;
+        else
+            directories.push_back(argument);
+    }
+    if (directories.empty())
+    {
+        directories.push_back(FileSystem::getPath("resources/objects"));
+        directories.push_back(FileSystem::getPath("resources/textures"));
+    }
+
+    vector<string> images;
+    for (const string &directory : directories)
+        collectImages(directory, images);
+    sort(images.begin(), images.end());
+
+    ThreadPool pool;
+    vector<future<string>> results;
+    for (const string &image : images)
+        results.push_back(pool.Submit([image, force]() { return cook(image, force); }));
+
+    int failed = 0;
+    for (future<string> &result : results)
+    {
+        string line = result.get();
+        failed += line.compare(0, 5, "ERROR") == 0;
+        cout << line << endl;
+    }
+    cout << images.size() << " images, " << failed << " failed" << endl;
+    return failed == 0 ? 0 : 1;
+}